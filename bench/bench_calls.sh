@@ -0,0 +1,16 @@
+#!/bin/sh
+# Cost of a function call, and what inlining saves: runs bench/calls.oba, a loop
+# making 3,000,000 calls to a one-line function, first with the function
+# inlined, then with every call left out of line (--no-inline).
+cd "$(dirname "$0")/.." || exit 1
+. bench/common.sh
+
+calls=3000000 # The loop bound in calls.oba
+inlined=$(best_execute_ms bench/calls.oba)
+outline=$(best_execute_ms --no-inline bench/calls.oba)
+
+echo "calls: $calls calls to add3(i, 1, 2), best of $RUNS"
+printf '  %-22s %10s ms\n' "inlined" "$inlined"
+printf '  %-22s %10s ms\n' "out of line" "$outline"
+printf '  %-22s %10s ns\n' "cost of one call" "$(awk -v a="$outline" -v b="$inlined" -v n="$calls" 'BEGIN { printf "%.1f", (a - b) * 1e6 / n }')"
+printf '  %-22s %10sx\n' "inlining speedup" "$(ratio "$outline" "$inlined")"
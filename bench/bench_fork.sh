@@ -0,0 +1,8 @@
+#!/bin/sh
+# What-if variants with copy-on-write forks: bench/fork.oba builds a 1 MB table
+# and runs a 1,000,000-iteration reduction as its shared prefix. fork_bench runs
+# variants of it by re-executing the whole script and by forking a frozen base
+# (see bench/fork_bench.c).
+cd "$(dirname "$0")/.." || exit 1
+
+bench/fork_bench bench/fork.oba
@@ -0,0 +1,30 @@
+#!/bin/sh
+# Input throughput: bench/input.oba reads 10,000,000 integers with read_all(),
+# from a file (--input, which is mapped) and from a pipe (read in blocks), for
+# 5-digit and 10-digit numbers.
+cd "$(dirname "$0")/.." || exit 1
+. bench/common.sh
+
+count=10000000 # The array size in input.oba
+data=$(mktemp -d) || exit 1
+trap 'rm -rf "$data"' EXIT
+
+awk -v n=$count 'BEGIN { srand(1); for (i = 0; i < n; i++) print int(rand() * 100000) }' > "$data/5"
+awk -v n=$count 'BEGIN { srand(2); for (i = 0; i < n; i++) printf "%d\n", 1000000000 + int(rand() * 1000000000) }' > "$data/10"
+
+pipe_execute_ms() {
+    cat "$1" | execute_ms bench/input.oba
+}
+
+# Millions of integers per second for a time in ms
+rate() {
+    awk -v n=$count -v ms="$1" 'BEGIN { printf "%.0f", n / ms / 1000 }'
+}
+
+echo "input: $count integers through read_all(), best of $RUNS"
+for digits in 5 10; do
+    file=$(best_execute_ms --input="$data/$digits" bench/input.oba)
+    pipe=$(best_of pipe_execute_ms "$data/$digits")
+    printf '  %-22s %10s ms %6s M ints/s\n' "$digits digits, file" "$file" "$(rate "$file")"
+    printf '  %-22s %10s ms %6s M ints/s\n' "$digits digits, pipe" "$pipe" "$(rate "$pipe")"
+done
@@ -0,0 +1,38 @@
+#!/bin/sh
+# Parallel scaling, each thread count compared with a run without --threads
+# (which must print exactly the same). Speedups need as many free cores as threads.
+#  - bench/wide.oba makes 16 independent fib(27) assignments, which --threads
+#    runs at the same time.
+#  - bench/loop.oba is a 1,000,000-iteration parallel for with sum and max
+#    reductions. Without --threads it is an ordinary serial loop. Its body only
+#    assigns reduction variables, which oba_c does not trace, so the times are
+#    not dominated by writing a [TRACE] line per iteration.
+cd "$(dirname "$0")/.." || exit 1
+. bench/common.sh
+
+# Prints what a run prints, without the [PARALLEL] decision line
+program_output() {
+    "$OBA_C" "$@" 2>&1 | grep -v '^\[PARALLEL\]'
+}
+
+# Times 'script' without --threads, then with each thread count in $THREADS
+scaling() {
+    script=$1
+    serial=$(best_execute_ms "$script")
+    expected=$(program_output "$script")
+    printf '  %-22s %10s ms\n' "without --threads" "$serial"
+    for threads in ${THREADS:-1 2 4 8}; do
+        if [ "$(program_output --threads="$threads" "$script")" != "$expected" ]; then
+            echo "error: '$script' printed something different with --threads=$threads" >&2
+            exit 1
+        fi
+        ms=$(best_execute_ms --threads="$threads" "$script")
+        printf '  %-22s %10s ms %8sx\n' "--threads=$threads" "$ms" "$(ratio "$serial" "$ms")"
+    done
+}
+
+echo "parallel: 16 independent statements (bench/wide.oba), best of $RUNS, $(getconf _NPROCESSORS_ONLN) CPUs"
+scaling bench/wide.oba
+
+echo "parallel: 1000000-iteration parallel for (bench/loop.oba), best of $RUNS"
+scaling bench/loop.oba
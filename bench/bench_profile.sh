@@ -0,0 +1,33 @@
+#!/bin/sh
+# Profile-guided compilation: each script is run once with --record-profile,
+# then timed without and with --use-profile.
+#  - A file of 20,000 rules (from bench/rules.awk) of which 6 fire: the
+#    profile leaves the bodies that never ran unparsed, which shortens the
+#    parse and semantic phases.
+#  - bench/switch.oba calls a 64-case sparse switch 3,000,000 times, 90% of
+#    them with one value: the profile makes the switch test that value first.
+#    That saves a few compares per call, which is less than the run-to-run
+#    noise of the call itself, so expect a ratio near 1.
+cd "$(dirname "$0")/.." || exit 1
+. bench/common.sh
+
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+
+awk -f bench/rules.awk > "$work/rules.oba"
+"$OBA_C" --record-profile="$work/rules.prof" "$work/rules.oba" >/dev/null || exit 1
+"$OBA_C" --record-profile="$work/switch.prof" bench/switch.oba >/dev/null || exit 1
+
+echo "profile: 20000 rules of which 6 fire, best of $RUNS"
+for phase in parse semantic; do
+    plain=$(best_of phase_ms $phase "$work/rules.oba")
+    guided=$(best_of phase_ms $phase --use-profile="$work/rules.prof" "$work/rules.oba")
+    printf '  %-22s %10s ms\n' "$phase" "$plain"
+    printf '  %-22s %10s ms %8sx\n' "$phase, with profile" "$guided" "$(ratio "$plain" "$guided")"
+done
+
+echo "profile: 64-case switch, 3000000 calls (bench/switch.oba), best of $RUNS"
+plain=$(best_execute_ms bench/switch.oba)
+guided=$(best_execute_ms --use-profile="$work/switch.prof" bench/switch.oba)
+printf '  %-22s %10s ms\n' "execute" "$plain"
+printf '  %-22s %10s ms %8sx\n' "execute, with profile" "$guided" "$(ratio "$plain" "$guided")"
@@ -0,0 +1,42 @@
+# Helpers shared by the bench_*.sh drivers. Source it from the repository root.
+
+OBA_C=${OBA_C:-./oba_c}
+RUNS=${RUNS:-5} # Each measurement is the best of this many runs
+
+# Prints one phase's wall time in ms (from --stats) for: oba_c "$@"
+phase_ms() {
+    phase=$1
+    shift
+    "$OBA_C" --stats "$@" 2>&1 >/dev/null | awk -v phase="$phase" '$1 == phase { print $2 }'
+}
+
+# Prints the execute phase's wall time in ms for: oba_c "$@"
+execute_ms() {
+    phase_ms execute "$@"
+}
+
+# Runs a command that prints a time $RUNS times and prints the smallest
+best_of() {
+    best=
+    run=0
+    while [ $run -lt "$RUNS" ]; do
+        ms=$("$@")
+        if [ -z "$ms" ]; then
+            echo "error: '$*' failed" >&2
+            exit 1
+        fi
+        best=$(awk -v a="$best" -v b="$ms" 'BEGIN { print (a == "" || b + 0 < a + 0) ? b : a }')
+        run=$((run + 1))
+    done
+    echo "$best"
+}
+
+# Prints the best of $RUNS execute_ms measurements
+best_execute_ms() {
+    best_of execute_ms "$@"
+}
+
+# Prints a / b to 'digits' decimal places
+ratio() {
+    awk -v a="$1" -v b="$2" -v d="${3:-2}" 'BEGIN { printf "%.*f\n", d, a / b }'
+}
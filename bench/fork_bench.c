@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "oba.h"
+
+// fork_bench: compares two ways of running many what-if variants of one script,
+// using liboba. Each variant runs the script's shared prefix (its first
+// --prefix top-level statements), sets 'rate' and 'key' to its own values, runs
+// the rest and reads back 'result'.
+//  - Re-execution: a new context per variant runs the whole script.
+//  - Forking: one context runs the prefix, oba_base_create freezes it, and each
+//    variant is an oba_context_fork of that base.
+// Both must compute the same results. Memory is the growth in anonymous memory
+// (Linux smaps_rollup) while many variants are kept alive at once.
+
+typedef struct {
+    const ObaProgram *program;
+    int prefix;      // Top-level statements shared by every variant
+    int table_size;  // Keys are spread over table[0..table_size)
+} Bench;
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// Anonymous memory of this process in KB, or -1 where /proc does not report it
+static long anonymous_kb(void) {
+    FILE *f = fopen("/proc/self/smaps_rollup", "r");
+    if (!f) return -1;
+    char line[256];
+    long kb = -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "Anonymous:", 10) == 0) kb = atol(line + 10);
+    }
+    fclose(f);
+    return kb;
+}
+
+static char* read_file(const char *path) {
+    FILE *f = fopen(path, "rb");
+    char *source = NULL;
+    long length = -1;
+    if (f && fseek(f, 0, SEEK_END) == 0 && (length = ftell(f)) >= 0 && fseek(f, 0, SEEK_SET) == 0) {
+        source = (char*)malloc(length + 1);
+        if (source && fread(source, 1, length, f) != (size_t)length) {
+            free(source);
+            source = NULL;
+        }
+    }
+    if (f) fclose(f);
+    if (source) source[length] = '\0';
+    return source;
+}
+
+// --- Variants ---
+
+static void check(int status, const ObaContext *ctx) {
+    if (status != 0) {
+        fprintf(stderr, "Error: %s\n", ctx ? oba_context_error(ctx) : "out of memory");
+        exit(1);
+    }
+}
+
+// Runs variant 'v' on a context that has run the prefix. Returns its result.
+static int finish_variant(const Bench *b, ObaContext *ctx, int v) {
+    check(oba_set(ctx, "rate", v % 17) != 0 || oba_set(ctx, "key", (int)((v * 7919LL) % b->table_size)) != 0, NULL);
+    check(oba_resume(b->program, ctx), ctx);
+    int result;
+    check(oba_get(ctx, "result", &result), NULL);
+    return result;
+}
+
+static ObaContext* rerun_variant(const Bench *b, int v, int *result) {
+    ObaContext *ctx = oba_context_create(b->program);
+    check(ctx ? 0 : -1, NULL);
+    check(oba_run_prefix(b->program, ctx, b->prefix), ctx);
+    *result = finish_variant(b, ctx, v);
+    return ctx;
+}
+
+static ObaContext* fork_variant(const Bench *b, const ObaBase *base, int v, int *result) {
+    ObaContext *ctx = oba_context_fork(base);
+    check(ctx ? 0 : -1, NULL);
+    *result = finish_variant(b, ctx, v);
+    return ctx;
+}
+
+static void print_usage(const char *program_name) {
+    fprintf(stderr,
+            "Usage: %s [options] script.oba\n"
+            "  --prefix=N      Top-level statements shared by all variants (default: 10)\n"
+            "  --table=N       Size of the script's 'table' array (default: 262144)\n"
+            "  --variants=N    Forked variants to time (default: 10000)\n"
+            "  --reruns=N      Re-executed variants to time (default: 20)\n",
+            program_name);
+}
+
+int main(int argc, char **argv) {
+    Bench b;
+    memset(&b, 0, sizeof(b));
+    b.prefix = 10;
+    b.table_size = 262144;
+    int variants = 10000, reruns = 20;
+    const char *script_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--prefix=", 9) == 0 && atoi(arg + 9) > 0) {
+            b.prefix = atoi(arg + 9);
+        } else if (strncmp(arg, "--table=", 8) == 0 && atoi(arg + 8) > 0) {
+            b.table_size = atoi(arg + 8);
+        } else if (strncmp(arg, "--variants=", 11) == 0 && atoi(arg + 11) > 0) {
+            variants = atoi(arg + 11);
+        } else if (strncmp(arg, "--reruns=", 9) == 0 && atoi(arg + 9) > 0) {
+            reruns = atoi(arg + 9);
+        } else if (arg[0] != '-' && !script_path) {
+            script_path = arg;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!script_path) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (reruns > variants) reruns = variants;
+
+    char *source = read_file(script_path);
+    if (!source) {
+        fprintf(stderr, "Error: Could not read '%s'.\n", script_path);
+        return 1;
+    }
+    char error[128];
+    ObaProgram *program = oba_compile(source, error, sizeof(error));
+    free(source);
+    if (!program) {
+        fprintf(stderr, "Error: %s\n", error);
+        return 1;
+    }
+    b.program = program;
+
+    // Re-execution, one whole run per variant
+    long long rerun_check = 0;
+    double start = now();
+    for (int v = 0; v < reruns; v++) {
+        int result;
+        oba_context_free(rerun_variant(&b, v, &result));
+        rerun_check += result;
+    }
+    double rerun_ms = (now() - start) * 1000 / reruns;
+
+    // Forking: the prefix once, then a fork per variant
+    start = now();
+    ObaContext *base_ctx = oba_context_create(program);
+    check(base_ctx ? 0 : -1, NULL);
+    check(oba_run_prefix(program, base_ctx, b.prefix), base_ctx);
+    double prefix_ms = (now() - start) * 1000;
+    start = now();
+    ObaBase *base = oba_base_create(base_ctx);
+    check(base ? 0 : -1, NULL);
+    double freeze_ms = (now() - start) * 1000;
+
+    long long fork_check = 0;
+    start = now();
+    for (int v = 0; v < variants; v++) {
+        int result;
+        oba_context_free(fork_variant(&b, base, v, &result));
+        if (v < reruns) fork_check += result;
+    }
+    double fork_ms = (now() - start) * 1000 / variants;
+    if (fork_check != rerun_check) {
+        fprintf(stderr, "Error: forked variants computed different results from re-executed ones.\n");
+        return 1;
+    }
+
+    // Memory per variant while many are alive at once
+    int fork_alive = variants < 2000 ? variants : 2000;
+    int rerun_alive = reruns;
+    ObaContext **alive = (ObaContext**)malloc(fork_alive * sizeof(ObaContext*));
+    check(alive ? 0 : -1, NULL);
+    long before = anonymous_kb();
+    for (int v = 0; v < fork_alive; v++) {
+        int result;
+        alive[v] = fork_variant(&b, base, v, &result);
+    }
+    long fork_kb = anonymous_kb() - before;
+    for (int v = 0; v < fork_alive; v++) oba_context_free(alive[v]);
+
+    before = anonymous_kb();
+    for (int v = 0; v < rerun_alive; v++) {
+        int result;
+        alive[v] = rerun_variant(&b, v, &result);
+    }
+    long rerun_kb = anonymous_kb() - before;
+    for (int v = 0; v < rerun_alive; v++) oba_context_free(alive[v]);
+
+    printf("fork: %d-statement prefix run once in %.3f ms, frozen in %.3f ms\n", b.prefix, prefix_ms, freeze_ms);
+    printf("  %-22s %10.4f ms per variant", "re-execute", rerun_ms);
+    if (before >= 0) printf(" %9.1f KB each alive", (double)rerun_kb / rerun_alive);
+    printf("\n  %-22s %10.4f ms per variant", "fork", fork_ms);
+    if (before >= 0) printf(" %9.1f KB each alive", (double)fork_kb / fork_alive);
+    printf("\n  %-22s %10.0fx\n", "fork speedup", rerun_ms / fork_ms);
+
+    free(alive);
+    oba_base_free(base);
+    oba_context_free(base_ctx);
+    oba_program_free(program);
+    return 0;
+}
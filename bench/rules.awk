@@ -0,0 +1,19 @@
+# Prints a file of 20,000 top-level rules, of which 6 fire, for bench_profile.sh.
+# Deterministic, so every run (and every machine) gets the same file.
+BEGIN {
+    print "int x; int y; int z; int hits; int a[16];"
+    print "int bump(int v) { hits = hits + v; return hits; }"
+    print "x = 7; y = 3;"
+    for (i = 0; i < 20000; i++) {
+        k = (i * 7919 + 13) % 5000
+        kind = (i * 31) % 10
+        if (i % 4000 == 1999) { k = 7; kind = 0 } # Five rules that fire on x = 7
+        if (kind < 5)
+            printf "if (x == %d) { y = y + %d; z = (y * 3) + a[%d]; if (y > 10) { print(bump(y)); } }\n", k, i % 9, i % 16
+        else if (kind < 8)
+            printf "if (y > %d) { a[%d] = a[%d] + ((x * y) - %d); print(a[%d]); }\n", k + 10, i % 16, i % 16, k, i % 16
+        else
+            printf "if (z == %d) switch (x) { case 1: print(1); case 7: { z = z + 1; print(z); } default: hits = hits + 1; }\n", k
+    }
+    print "print(hits); print(y); print(z); print(sum(a));"
+}
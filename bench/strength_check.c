@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "oba.h"
+
+// strength_check: brute-force check of the semantic pass's strength reduction,
+// using liboba. For each constant divisor d it compiles
+//     q[i] = x[i] / d;  p[i] = x[i] * d;
+// inside a parallel for, which the pass rewrites to BINARY_DIV_MAGIC,
+// BINARY_DIV_POW2 or BINARY_SHIFT_LEFT (or leaves alone, for 0, -1 and INT_MIN),
+// runs it over edge-case and random dividends and compares every element with
+// C's '/' and '*'. Multiplication wraps as the VM's does; INT_MIN / -1 is INT_MIN.
+
+#define DIVIDENDS 8192
+
+static unsigned long long rng_state = 0x9E3779B97F4A7C15ull;
+
+// xorshift64*: reproducible across runs and platforms, unlike rand()
+static unsigned random_u32(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (unsigned)((rng_state * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+static int expected_quotient(int x, int d) {
+    if (d == -1) return (int)(0u - (unsigned)x);
+    return x / d;
+}
+
+static int expected_product(int x, int d) {
+    return (int)((unsigned)x * (unsigned)d);
+}
+
+// --- Cases ---
+
+// The dividends for 'd': the extremes, values around zero, around multiples of
+// d (where a wrong magic number first rounds the wrong way), then random ones
+static int fill_dividends(int *x, int d) {
+    static const int fixed[] = { INT_MIN, INT_MIN + 1, INT_MAX, INT_MAX - 1, 0, 1, -1, 2, -2, 3, -3 };
+    int n = 0;
+    for (size_t i = 0; i < sizeof(fixed) / sizeof(fixed[0]); i++) x[n++] = fixed[i];
+
+    long long step = d == INT_MIN ? 1 : llabs((long long)d);
+    for (long long k = -64; k <= 64; k++) {
+        for (int offset = -1; offset <= 1; offset++) {
+            long long value = k * step + offset;
+            if (value >= INT_MIN && value <= INT_MAX) x[n++] = (int)value;
+        }
+    }
+
+    // The multiples nearest INT_MIN and INT_MAX
+    long long top = (INT_MAX / step) * step;
+    for (int offset = -1; offset <= 1; offset++) {
+        if (top + offset <= INT_MAX) x[n++] = (int)(top + offset);
+        if (-top + offset - 1 >= INT_MIN) x[n++] = (int)(-top + offset - 1);
+    }
+
+    while (n < DIVIDENDS) x[n++] = (int)random_u32();
+    return n;
+}
+
+// Writes 'd' as Oba source; negative literals are spelled as a subtraction,
+// which the pass folds back into one constant before reducing
+static void format_divisor(char *out, size_t size, int d) {
+    if (d == INT_MIN) snprintf(out, size, "(0 - %d - 1)", INT_MAX);
+    else if (d < 0) snprintf(out, size, "(0 - %u)", 0u - (unsigned)d);
+    else snprintf(out, size, "%d", d);
+}
+
+// Returns the number of mismatched elements for divisor 'd', or -1 on an error
+static int check_divisor(int d) {
+    static int x[DIVIDENDS], q[DIVIDENDS], p[DIVIDENDS];
+    char literal[64], source[512], error[256];
+
+    format_divisor(literal, sizeof(literal), d);
+    snprintf(source, sizeof(source),
+             "int x[%d];\nint q[%d];\nint p[%d];\n"
+             "parallel for (i = 0; i < %d) {\n"
+             "    q[i] = x[i] / %s;\n"
+             "    p[i] = x[i] * %s;\n"
+             "}\n",
+             DIVIDENDS, DIVIDENDS, DIVIDENDS, DIVIDENDS, literal, literal);
+
+    ObaProgram *program = oba_compile(source, error, sizeof(error));
+    if (!program) {
+        fprintf(stderr, "Error: divisor %d does not compile: %s\n", d, error);
+        return -1;
+    }
+    ObaContext *ctx = oba_context_create(program);
+    int count = fill_dividends(x, d);
+    int status = ctx ? oba_set_array(ctx, "x", x, count) : -1;
+    if (status == 0) status = oba_run(program, ctx);
+    if (status == 0) status = oba_get_array(ctx, "q", q, count) | oba_get_array(ctx, "p", p, count);
+    if (status != 0) {
+        fprintf(stderr, "Error: divisor %d: %s\n", d, ctx ? oba_context_error(ctx) : "out of memory");
+        oba_context_free(ctx);
+        oba_program_free(program);
+        return -1;
+    }
+
+    int mismatches = 0;
+    for (int i = 0; i < count; i++) {
+        int want_q = expected_quotient(x[i], d), want_p = expected_product(x[i], d);
+        if (q[i] != want_q || p[i] != want_p) {
+            if (mismatches < 5) {
+                fprintf(stderr, "  %d / %d = %d (expected %d), %d * %d = %d (expected %d)\n",
+                        x[i], d, q[i], want_q, x[i], d, p[i], want_p);
+            }
+            mismatches++;
+        }
+    }
+    oba_context_free(ctx);
+    oba_program_free(program);
+    return mismatches;
+}
+
+// --- Driver ---
+
+int main(int argc, char **argv) {
+    int random_divisors = 200;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--random=", 9) == 0) {
+            random_divisors = atoi(argv[i] + 9);
+        } else {
+            fprintf(stderr, "Usage: %s [--random=N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // Divisors: +-1, every +-2^k, INT_MIN and INT_MAX, small and awkward odd
+    // values (7 and 641 need the add-back step), then random ones
+    int divisors[256 + 1024];
+    int count = 0;
+    static const int fixed[] = {
+        1, -1, INT_MIN, INT_MAX, INT_MIN + 1, 3, -3, 5, -5, 6, -6, 7, -7, 10, -10, 11, -11,
+        12, 25, 100, -100, 125, 641, -641, 1000, 6700417, -6700417, 65537, 0x7FFF, 1000000007,
+    };
+    for (size_t i = 0; i < sizeof(fixed) / sizeof(fixed[0]); i++) divisors[count++] = fixed[i];
+    for (int k = 1; k <= 30; k++) {
+        divisors[count++] = 1 << k;
+        divisors[count++] = -(1 << k);
+    }
+    if (random_divisors > 1024) random_divisors = 1024;
+    for (int i = 0; i < random_divisors; i++) {
+        int d = (int)random_u32();
+        if (i % 2) d >>= random_u32() & 31; // Half of them small
+        if (d != 0) divisors[count++] = d;
+    }
+
+    int failed = 0;
+    for (int i = 0; i < count; i++) {
+        int mismatches = check_divisor(divisors[i]);
+        if (mismatches != 0) {
+            if (mismatches > 0) fprintf(stderr, "divisor %d: %d mismatches\n", divisors[i], mismatches);
+            failed++;
+        }
+    }
+
+    printf("strength reduction: %d divisors x %d dividends, %d failed\n", count, DIVIDENDS, failed);
+    return failed ? 1 : 0;
+}
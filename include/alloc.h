@@ -0,0 +1,22 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The allocator as used everywhere outside the server: the standard calls, plus a
+// process-wide count of the bytes requested so --stats can report how much each
+// phase allocated, not only how much it left allocated. realloc counts the whole
+// new size, since the block may move. Safe to call from any thread.
+void* counted_malloc(size_t size);
+void* counted_calloc(size_t count, size_t size);
+void* counted_realloc(void *ptr, size_t size);
+char* counted_strdup(const char *s);
+
+// Adds an allocation made by some other route (posix_memalign) to the count
+void allocation_count_add(size_t size);
+
+// Bytes requested since the process started
+uint64_t allocated_bytes_total(void);
+
+#endif // ALLOC_H
@@ -0,0 +1,23 @@
+#ifndef ARRAY_H
+#define ARRAY_H
+
+#include <stddef.h>
+
+// Byte alignment of VM memory, so every array starts on a cache line
+#define ARRAY_ALIGNMENT 64
+
+// --- Storage ---
+// Allocates 'count' zeroed ints aligned to ARRAY_ALIGNMENT. Returns NULL on failure.
+int* array_alloc(size_t count);
+void array_free(int *data);
+
+// --- Bulk Kernels ---
+// These do no bounds checking: callers validate the extents once, up front.
+// Arithmetic wraps around on overflow, like the VM's '+', '-' and '*'.
+int array_sum(const int *data, int count);
+int array_min(const int *data, int count); // count must be > 0
+int array_max(const int *data, int count); // count must be > 0
+void array_add(int *dst, const int *src, int count);   // dst[i] += src[i]
+void array_scale(int *data, int factor, int count);     // data[i] *= factor
+
+#endif // ARRAY_H
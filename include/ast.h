@@ -12,34 +12,131 @@ typedef enum {
     STMT_ASSIGN,
     STMT_PRINT,
     STMT_IF,
+    STMT_EXPR,       // An expression evaluated for its effect, e.g. add(a, b);
+    STMT_BLOCK,      // '{' Statement* '}'
+    STMT_FUNC_DECL,  // int f(int a, int b) { ... }
+    STMT_RETURN,
+    STMT_SWITCH,     // switch (x) { case 1: ... default: ... }
+    STMT_LAZY,       // An 'if' body not parsed yet; replaced by the real statement when first run
+    STMT_PARALLEL_FOR, // parallel for (i = a; i < b) sum(t) { ... }
     
     // Expressions
     EXPR_BINARY,
     EXPR_LITERAL,
     EXPR_IDENTIFIER,
+    EXPR_INDEX,      // Array element read, e.g. a[i]
+    EXPR_CALL,       // Built-in or user function call, e.g. sum(a), f(1, 2)
     
     // Conditions (can reuse EXPR_BINARY for ==, <, >)
 
 } ASTNodeType;
 
+// Built-in functions an EXPR_CALL can resolve to
+typedef enum {
+    BUILTIN_NONE, // A user-defined function (or not resolved yet)
+    BUILTIN_SUM,
+    BUILTIN_MIN,
+    BUILTIN_MAX,
+    BUILTIN_ADD,
+    BUILTIN_SCALE,
+    BUILTIN_READ,     // read(): the next integer of input
+    BUILTIN_READ_ALL, // read_all(a): fills 'a' from input, returns how many were read
+} BuiltinType;
+
+// What an EXPR_BINARY computes. The parser picks the operator's own kind; the
+// semantic pass may swap in a cheaper one that gives the same result when the
+// right operand is a constant.
+typedef enum {
+    BINARY_ADD,
+    BINARY_SUB,
+    BINARY_MUL,
+    BINARY_DIV,
+    BINARY_EQUAL,
+    BINARY_LESS,
+    BINARY_GREATER,
+    BINARY_SHIFT_LEFT, // x * 2^shift
+    BINARY_DIV_POW2,   // x / 2^shift, rounding toward zero
+    BINARY_DIV_MAGIC,  // x / d for a constant d: multiply-high by 'magic', then shift
+} BinaryKind;
+
+// A reduction clause of a STMT_PARALLEL_FOR, e.g. the sum(total) in
+// 'parallel for (i = 0; i < n) sum(total) ...'
+typedef struct {
+    BuiltinType kind; // BUILTIN_SUM, BUILTIN_MIN or BUILTIN_MAX
+    char *name;       // The global scalar the iterations combine into
+    int slot;         // ...and its global slot, set by the semantic pass
+} LoopReduction;
+
+// One 'case' label of a STMT_SWITCH
+typedef struct {
+    int value;
+    int target; // Index in the switch's 'statements' of the body it runs
+} SwitchCase;
+
+// The labels of a STMT_SWITCH and how the VM dispatches on them. The semantic
+// pass sorts 'cases' by value, so a lookup can binary search them, and adds a
+// jump table when the values are dense enough.
+typedef struct {
+    SwitchCase *cases;
+    int count;
+    int default_target; // Body for 'default', or -1 if there is none
+
+    int *jump_table;    // NULL, or the target for each value in [jump_min, jump_min + jump_size)
+    int jump_min;
+    int jump_size;
+
+    // Set from a profile (see semantic_apply_profile): a binary-searched switch
+    // tests the value it mostly sees before searching
+    int has_hot;
+    int hot_value;
+    int hot_target;     // Its body, or default_target
+} SwitchTable;
+
 // The core AST Node structure
 typedef struct ASTNode {
     ASTNodeType type;
+    int line; // Statements: the source line they start on (0 for nodes made by the passes)
     
-    // For NODE_PROGRAM
+    // For NODE_PROGRAM, STMT_BLOCK, and the case bodies of STMT_SWITCH
     struct ASTNode **statements; // A dynamic array of statement nodes
     int statement_count;
 
-    // For STMT_VAR_DECL, STMT_ASSIGN, EXPR_IDENTIFIER
+    // For STMT_VAR_DECL, STMT_ASSIGN, EXPR_IDENTIFIER, STMT_FUNC_DECL
     char *name; // e.g., the variable name 'x'
+
+    // Filled in by the semantic pass for STMT_ASSIGN, EXPR_IDENTIFIER, EXPR_INDEX
+    int slot;     // Global symbol index, or position in the current call frame
+    int is_local; // 1 if 'slot' is in the call frame (parameter or local)
+    int untraced; // STMT_ASSIGN to a parallel for's reduction copy: its partial
+                  // values depend on how the iterations were split, so no [TRACE]
     
-    // For STMT_ASSIGN
+    // For STMT_VAR_DECL of an array (0 for a scalar)
+    int array_size; // e.g., the 10 in 'int a[10];'
+
+    // For STMT_ASSIGN, STMT_EXPR, STMT_RETURN
     struct ASTNode *expression; // The right-hand side of '='
+
+    // For EXPR_INDEX, and STMT_ASSIGN to an array element
+    struct ASTNode *index; // The i in 'a[i]' (NULL for a plain variable)
+
+    // For EXPR_CALL
+    struct ASTNode **args; // A dynamic array of argument expressions
+    int arg_count;
+    BuiltinType builtin;     // Set by the semantic pass
+    struct ASTNode *callee;  // The STMT_FUNC_DECL for a user function, set by the semantic pass
+
+    // For STMT_FUNC_DECL (the body is a STMT_BLOCK in 'body')
+    char **params;   // Parameter names, in order
+    int param_count;
+    int frame_size;  // Slots per call (parameters then locals), set by the semantic pass
     
     // For STMT_PRINT
     struct ASTNode *print_expr;
 
-    // For STMT_IF
+    // For STMT_SWITCH (its value is in 'condition')
+    SwitchTable *switch_table;
+
+    // For STMT_IF, STMT_SWITCH, STMT_FUNC_DECL
     struct ASTNode *condition; // The (x == 10) part
     struct ASTNode *body;      // The statement to execute
     
@@ -47,15 +144,51 @@ typedef struct ASTNode {
     struct ASTNode *left;
     struct ASTNode *right;
     Token *op; // The operator token (+, -, *, /, ==, <, >)
+    BinaryKind binary;
+    int shift;     // BINARY_SHIFT_LEFT, BINARY_DIV_POW2, BINARY_DIV_MAGIC
+    int magic;     // BINARY_DIV_MAGIC: the multiplier...
+    int magic_add; // ...and how many times x to add to the high half (-1, 0 or 1)
 
     // For EXPR_LITERAL
     int value; // The integer value
 
+    // For STMT_PARALLEL_FOR: the index variable is 'name', its bounds are 'left'
+    // (first value) and 'right' (one past the last), and the statement is 'body'.
+    // The iterations share a frame layout: the index in slot 0, a private copy
+    // of each reduction's variable in slots 1..reduction_count, then the body's
+    // locals, frame_size slots in all.
+    LoopReduction *reductions;
+    int reduction_count;
+
+    // For STMT_LAZY: the body's tokens (inside the program's token array) and
+    // the program, whose functions the body may call
+    Token **lazy_tokens;
+    int lazy_token_count;
+    struct ASTNode *lazy_program;
+
 } ASTNode; // <-- This typedef creates the 'ASTNode' type
 
+// A growable stack of nodes, for walking trees of any depth without recursion
+typedef struct {
+    ASTNode **items;
+    int count;
+    int capacity;
+} ASTNodeStack;
+
 // --- AST Utility Functions ---
 ASTNode* ast_node_create(ASTNodeType type);
 void ast_node_free(ASTNode *node);
 void ast_program_add_statement(ASTNode *program, ASTNode *statement);
+void ast_call_add_argument(ASTNode *call, ASTNode *argument);
+void ast_function_add_param(ASTNode *function, const char *name);
+void ast_switch_add_case(ASTNode *node, int value, int target);
+void ast_loop_add_reduction(ASTNode *loop, BuiltinType kind, const char *name);
+ASTNode* ast_node_clone(const ASTNode *node); // Deep copy of an expression tree
+int ast_node_count(const ASTNode *node);      // Number of nodes in a (sub)tree
+
+void ast_stack_push(ASTNodeStack *stack, ASTNode *node); // Ignores NULL
+ASTNode* ast_stack_pop(ASTNodeStack *stack);              // NULL once empty
+void ast_stack_push_children(ASTNodeStack *stack, ASTNode *node);
+void ast_stack_free(ASTNodeStack *stack);
 
 #endif // AST_H
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef DEPGRAPH_H
+#define DEPGRAPH_H
+
+#include <stdint.h>
+#include "ast.h"
+#include "symtab.h"
+
+// Resources a statement can touch: each global symbol (a scalar, or a whole
+// array) by its index, plus the input stream read() and read_all() consume
+#define DEP_RESOURCE_INPUT MAX_SYMBOLS
+#define DEP_RESOURCES (MAX_SYMBOLS + 1)
+#define DEP_WORDS ((DEP_RESOURCES + 63) / 64)
+
+// Estimated work of one call to a user function. Its real cost is unknown
+// (it may recurse), so any statement that calls one counts as heavy.
+#define DEP_CALL_COST 100000
+
+// What one statement (or a whole function body) may read and write
+typedef struct {
+    uint64_t reads[DEP_WORDS];
+    uint64_t writes[DEP_WORDS];
+    long long cost; // Rough work estimate: AST nodes, elements for array built-ins
+} DepEffects;
+
+// A read/write dependency DAG over the top-level statements
+// program->statements[first..first + count). Statement i must run after every
+// statement listed in preds (edges always point forward, so source order is a
+// valid schedule). Output order is not a dependency: the runner keeps print()s
+// in order itself.
+typedef struct {
+    int first;
+    int count;
+    int *pred_count;   // Number of statements each one waits for
+    int *succ_start;   // Successors of i are succ[succ_start[i]..succ_start[i + 1])
+    int *succ;
+    long long *cost;   // Estimated work per statement
+    long long total_cost;
+    long long critical_cost; // Work on the most expensive dependency chain
+} DepGraph;
+
+// Returns 1 if 'resource' is in the set 'bits' (a reads or writes field)
+int depgraph_has_resource(const uint64_t *bits, int resource);
+
+// Returns what each of the program's statements from 'first' on may read and
+// write (an array of statement_count - first entries, to free()), or NULL if
+// out of memory. The program must have passed semantic analysis.
+DepEffects* depgraph_effects(ASTNode *program, SymbolTable *st, int first);
+
+// Builds the graph for the program's statements from 'first' on. The program
+// must have passed semantic analysis. Returns NULL if out of memory.
+DepGraph* depgraph_build(ASTNode *program, SymbolTable *st, int first);
+void depgraph_free(DepGraph *graph);
+
+#endif // DEPGRAPH_H
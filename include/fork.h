@@ -0,0 +1,29 @@
+#ifndef FORK_H
+#define FORK_H
+
+#include "vm.h"
+
+// Copy-on-write forks of a VM. An image freezes a VM's variables, and where it
+// stopped, in an unlinked file (on tmpfs when /dev/shm exists). Each fork maps
+// that file privately as its memory, so forking copies nothing: all forks share
+// the image's pages until one writes to a page, which then gets its own copy of
+// that page alone. A fork pays for the pages it changes, not for the whole state.
+
+typedef struct {
+    int fd;          // The image file, already unlinked
+    int memory_size; // In ints
+    int pc;          // Next top-level statement to run
+} VMImage;
+
+// Freezes 'vm' between top-level statements. Later changes to 'vm' do not
+// reach the image. Returns NULL after reporting an error to stderr.
+VMImage* vm_image_create(const VirtualMachine *vm);
+
+// Forks keep working after the image is freed
+void vm_image_free(VMImage *image);
+
+// A VM for 'st' (the symbol table the image's VM used) whose variables and
+// position start as the image's. Returns NULL if the memory could not be mapped.
+VirtualMachine* vm_fork(const VMImage *image, SymbolTable *st);
+
+#endif // FORK_H
@@ -0,0 +1,57 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stddef.h>
+
+// Bytes read from a pipe or terminal per block
+#define INPUT_BLOCK_SIZE (1 << 20)
+
+// A stream of decimal integers for read() and read_all(). Regular files are
+// mapped whole; pipes and terminals are read a block at a time. Anything that
+// is not a digit or a '-' directly before one separates numbers.
+typedef struct {
+    const char *data; // Unconsumed input is data[pos..len)
+    size_t pos;
+    size_t len;
+    size_t origin;    // 'pos' when the reader was opened
+    size_t dropped;   // Consumed bytes that refills have moved out of 'data'
+    int at_eof;       // 1 once nothing more will arrive after data[len - 1]
+
+    int fd;           // Source of further blocks (-1 for none)
+    int owns_fd;      // 1 if input_close should close 'fd'
+    char *buffer;     // Block buffer (NULL when 'data' is mapped or caller-owned)
+    size_t capacity;
+    size_t mapped_size; // Bytes to munmap, or 0 if 'data' is not mapped
+} InputReader;
+
+// Reads from an open descriptor (e.g. 0 for stdin), which is left open on close.
+// Nothing is read until the first number is asked for.
+InputReader* input_open_fd(int fd);
+
+// Opens a file. Returns NULL if it cannot be opened.
+InputReader* input_open_file(const char *path);
+
+// Reads from memory the caller keeps alive until input_close
+InputReader* input_open_memory(const char *data, size_t len);
+
+void input_close(InputReader *in);
+
+// Stores the next integer in *value. Returns 1, or 0 once the input is used up.
+int input_next(InputReader *in, int *value);
+
+// Fills values[0..count) from the input. Returns how many were stored, which
+// is less than 'count' only if the input ran out.
+int input_read_array(InputReader *in, int *values, int count);
+
+// Bytes of input consumed since the reader was opened
+size_t input_consumed(const InputReader *in);
+
+// Consumes 'bytes' bytes without parsing them, e.g. to resume where an earlier
+// run over the same input stopped. Returns 0, or -1 if the input ends first.
+int input_skip(InputReader *in, size_t bytes);
+
+// Parses the decimal integer at s[0..end): an optional '-' then at least one digit.
+// Returns a pointer just past it. Values outside int range wrap around, like the VM's arithmetic.
+const char* input_parse_int(const char *s, const char *end, int *value);
+
+#endif // INPUT_H
@@ -16,4 +16,8 @@ Lexer* lexer_create(const char *source_code);
 void lexer_destroy(Lexer *l);
 Token* lexer_next_token(Lexer *l);
 
+// Lexes the rest of the source into an array ending with the EOF token.
+// Stores the number of tokens (including EOF) in '*count'. Returns NULL on allocation failure.
+Token** lexer_tokenize(Lexer *l, int *count);
+
 #endif // LEXER_H
\ No newline at end of file
@@ -0,0 +1,175 @@
+#ifndef OBA_H
+#define OBA_H
+
+#include <stddef.h>
+
+// --- liboba: embedding Oba-C ---
+//
+// Compile a script once into an ObaProgram, then run it any number of times.
+// A program is never modified after oba_compile returns, so any number of
+// threads may run it at once, each with its own ObaContext, without locking.
+// A context holds only one run's variables (and, once a function is called,
+// its call stack). It must not be shared between threads that run at the same time.
+
+typedef struct ObaProgram ObaProgram;
+typedef struct ObaContext ObaContext;
+
+// Receives each value passed to print(). 'user_data' is the pointer given to oba_context_set_output.
+typedef void (*ObaOutputFn)(void *user_data, int value);
+
+// Compiles 'source'. Returns NULL on failure and, if 'error' is non-NULL, writes a
+// message into it (details of syntax and semantic errors also go to stderr).
+ObaProgram* oba_compile(const char *source, char *error, size_t error_size);
+void oba_program_free(ObaProgram *program);
+
+// Creates an execution context with all variables zeroed. Returns NULL if out of memory.
+ObaContext* oba_context_create(const ObaProgram *program);
+void oba_context_free(ObaContext *ctx);
+
+// Zeroes all variables and drops collected output, so the context can serve a new request
+void oba_context_reset(ObaContext *ctx);
+
+// Sends print() output to 'fn'. With no callback (the default), values are
+// collected in the context and read back with oba_context_output.
+void oba_context_set_output(ObaContext *ctx, ObaOutputFn fn, void *user_data);
+
+// Values printed by the last oba_run when no output callback is set
+const int* oba_context_output(const ObaContext *ctx, int *count);
+
+// --- Inputs and Results ---
+// These return 0 on success, or -1 if the variable does not exist or has the wrong kind.
+
+int oba_set(ObaContext *ctx, const char *name, int value);
+int oba_get(const ObaContext *ctx, const char *name, int *value);
+
+// Copies up to 'count' elements in or out of a global array; the rest are left alone
+int oba_set_array(ObaContext *ctx, const char *name, const int *values, int count);
+int oba_get_array(const ObaContext *ctx, const char *name, int *values, int count);
+
+// --- Input for read() and read_all() ---
+// Numbers are consumed as the script reads them and the position carries over
+// between runs; set the input again to start over. A context with no input
+// behaves as if it were empty. These return 0 on success, -1 on error.
+
+// Reads from 'data', which is not copied and must stay alive while the context uses it
+int oba_context_set_input(ObaContext *ctx, const char *data, size_t size);
+
+// Reads from the file at 'path' (mapped, not copied)
+int oba_context_set_input_file(ObaContext *ctx, const char *path);
+
+// --- Execution ---
+
+// Runs the whole program in 'ctx', starting from the variables' current values.
+// Returns 0 on success, or -1 on a runtime error (see oba_context_error).
+int oba_run(const ObaProgram *program, ObaContext *ctx);
+
+// Message for the last runtime error in 'ctx', or "" if the last run succeeded
+const char* oba_context_error(const ObaContext *ctx);
+
+// Runs only the first 'count' top-level statements, like oba_run otherwise.
+// The context is left after them, ready for oba_resume or oba_base_create.
+int oba_run_prefix(const ObaProgram *program, ObaContext *ctx, int count);
+
+// Runs the rest of the program from where 'ctx' stopped (after oba_run_prefix,
+// or in a fork), keeping the variables as they are. Returns like oba_run.
+int oba_resume(const ObaProgram *program, ObaContext *ctx);
+
+// Returns how many more statements a metered run may execute, or 0 to stop it
+typedef long long (*ObaFuelFn)(void *user_data);
+
+// Meters runs in 'ctx' by the statements they execute. A run may execute
+// 'first' statements; each time its allowance is used up, 'fn' grants the next
+// one or stops the run with an "Out of fuel." runtime error. Whatever is left
+// carries over to the next run, so set it again before each. A NULL 'fn' (the
+// default) leaves runs unmetered. oba_scheduler_run meters tasks itself.
+void oba_context_set_fuel(ObaContext *ctx, long long first, ObaFuelFn fn, void *user_data);
+
+// --- Forking ---
+// For evaluating many variants of a run that share a long prefix: run the
+// prefix once with oba_run_prefix, freeze the context in an ObaBase, then fork
+// a context per variant, change a few variables with oba_set, and oba_resume.
+// A fork starts with the base's variables and position but copies none of
+// them: the forks share the base's memory, copy-on-write in pages, so each one
+// only pays (in time and memory) for the pages its own writes touch. Forks have
+// no input and a fresh output; otherwise they are ordinary contexts.
+
+typedef struct ObaBase ObaBase;
+
+// Freezes the variables and position of 'ctx', which is not changed. Later runs
+// in 'ctx' do not affect the base. Returns NULL on failure.
+ObaBase* oba_base_create(const ObaContext *ctx);
+
+// Frees the base; forks already made keep working
+void oba_base_free(ObaBase *base);
+
+// A context that continues from 'base'. Returns NULL on failure.
+ObaContext* oba_context_fork(const ObaBase *base);
+
+// --- Reactive Mode ---
+// For a context that is run again and again while its inputs change a little
+// at a time. oba_reactive_run runs the whole program once, like oba_run, and
+// records what each top-level statement may read and write and what it
+// printed. oba_reactive_set then changes one input and re-runs only the
+// statements the change reaches: the variables, and everything the program
+// prints, end up as a full run with the new inputs would leave them, at a
+// cost that follows the size of that slice rather than of the program.
+//
+// While in reactive mode print() values go to oba_reactive_output, not to the
+// context's output. oba_run, oba_set, oba_set_array and oba_context_reset end
+// reactive mode, as does a runtime error (which leaves the variables wherever
+// the failing statement stopped). Programs that call read() or read_all() are
+// not supported. These return 0 on success, or -1 with oba_context_error set.
+
+int oba_reactive_run(const ObaProgram *program, ObaContext *ctx);
+
+// Gives an input a new value and brings the program's results up to date
+int oba_reactive_set(ObaContext *ctx, const char *name, int value);
+int oba_reactive_set_array(ObaContext *ctx, const char *name, const int *values, int count);
+
+// All values a full run with the current inputs would print, in order. Valid
+// until the next call on the context; NULL with *count 0 outside reactive mode.
+const int* oba_reactive_output(ObaContext *ctx, int *count);
+
+// Top-level statements the last oba_reactive_set* re-ran
+int oba_reactive_recomputed(const ObaContext *ctx);
+
+// --- Scheduling Many Contexts ---
+// A scheduler runs many contexts to completion on a few OS threads. Every
+// statement a context executes costs one unit of fuel. Once it has spent its
+// quantum, the context is suspended where it stands (mid-expression or deep in
+// a call) and goes to the back of the queue, so one long script cannot hold a
+// thread while short ones wait. Each context keeps its own variables and call
+// stack, and may resume on a different thread than the one it left.
+
+typedef struct ObaScheduler ObaScheduler;
+
+typedef enum {
+    OBA_SCHEDULE_ROUND_ROBIN, // Every context gets a turn in order
+    OBA_SCHEDULE_PRIORITY     // Higher priorities run first; equal ones take turns
+} ObaSchedulePolicy;
+
+// Statements a context runs per turn unless its options say otherwise
+#define OBA_DEFAULT_QUANTUM 10000
+
+typedef struct {
+    int priority;      // Used by OBA_SCHEDULE_PRIORITY
+    long long quantum; // Statements per turn (0 for OBA_DEFAULT_QUANTUM)
+    long long budget;  // Statements for the whole run, after which it fails (0 for no limit)
+} ObaTaskOptions;
+
+// Creates a scheduler with 'threads' worker threads. Returns NULL on failure.
+ObaScheduler* oba_scheduler_create(int threads, ObaSchedulePolicy policy);
+void oba_scheduler_free(ObaScheduler *scheduler);
+
+// Queues a run of 'program' in 'ctx', as oba_run would do it. 'options' may be
+// NULL for the defaults. A context may only be queued once per oba_scheduler_run.
+// Returns 0, or -1 if out of memory or the context belongs to another program.
+int oba_scheduler_add(ObaScheduler *scheduler, const ObaProgram *program, ObaContext *ctx,
+                      const ObaTaskOptions *options);
+
+// Runs every queued context to completion, then empties the queue. Output
+// callbacks are called from the worker threads. Returns how many runs failed;
+// each context's error is in oba_context_error.
+int oba_scheduler_run(ObaScheduler *scheduler);
+
+#endif // OBA_H
@@ -0,0 +1,42 @@
+#ifndef OBA_INTERNAL_H
+#define OBA_INTERNAL_H
+
+// Layout of liboba's opaque types, shared by the library's own source files.
+// Embedders only ever see the declarations in oba.h.
+
+#include "oba.h"
+#include "token.h"
+#include "ast.h"
+#include "symtab.h"
+#include "vm.h"
+#include "reactive.h"
+#include "fork.h"
+
+// A compiled script. Everything here is read-only once oba_compile returns.
+struct ObaProgram {
+    Token **tokens; // Owned here because AST operator nodes point into them
+    int token_count;
+    ASTNode *ast;
+    SymbolTable *symtab;
+};
+
+// One run's state: the VM's variables plus any print() output collected for the caller
+struct ObaContext {
+    const ObaProgram *program;
+    VirtualMachine *vm;
+    int *output;
+    int output_count;
+    int output_capacity;
+    Reactive *reactive;  // Set while in reactive mode (see oba_reactive_run)
+    int recomputed;      // Statements re-run by the last oba_reactive_set*
+    ObaFuelFn fuel_fn;   // Set by oba_context_set_fuel
+    void *fuel_data;
+};
+
+// A frozen context that others are forked from
+struct ObaBase {
+    const ObaProgram *program;
+    VMImage *image;
+};
+
+#endif // OBA_INTERNAL_H
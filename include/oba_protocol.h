@@ -0,0 +1,79 @@
+#ifndef OBA_PROTOCOL_H
+#define OBA_PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+// Wire format between oba_server and its clients, over a Unix domain stream
+// socket. Every message is an ObaMessageHeader followed by 'length' bytes of
+// payload, in the host's byte order (both ends are on the same machine).
+//
+// A connection carries any number of requests, one at a time:
+//   client: OBA_MSG_RUN
+//   server: OBA_MSG_OUTPUT*  (print() values, as the script produces them)
+//           OBA_MSG_DONE     (or OBA_MSG_UNKNOWN, for a hash the server has not cached)
+
+#define OBA_DEFAULT_SOCKET "/tmp/oba-c.sock"
+
+// Requests larger than this are refused and the connection is closed
+#define OBA_MAX_MESSAGE (64 * 1024 * 1024)
+
+// print() values are sent in batches of up to this many
+#define OBA_OUTPUT_BATCH 1024
+
+typedef enum {
+    OBA_MSG_RUN = 1, // ObaRunRequest, then the source, then the input
+    OBA_MSG_OUTPUT,  // int32_t values
+    OBA_MSG_DONE,    // ObaRunResult, then the error message (if any)
+    OBA_MSG_UNKNOWN  // No payload: send the source
+} ObaMessageType;
+
+typedef struct {
+    uint32_t type;
+    uint32_t length;
+} ObaMessageHeader;
+
+// With source_length 0 the script is named by 'hash' alone (see
+// snapshot_hash_program); otherwise the hash is computed from the source
+typedef struct {
+    uint64_t hash;
+    uint32_t source_length;
+    uint32_t input_length;  // Numbers for read() and read_all()
+} ObaRunRequest;
+
+// The script's program was already compiled and cached
+#define OBA_RESULT_CACHED 1
+
+typedef struct {
+    int32_t status;  // 0, or -1 if the script failed to compile or run
+    uint32_t flags;
+} ObaRunResult;
+
+// These return 0, or -1 if the connection failed or was closed.
+int protocol_read(int fd, void *data, size_t size);
+
+// Sends one message made of 'parts' (which may be empty)
+int protocol_send(int fd, uint32_t type, const struct iovec *parts, int part_count);
+
+// Reads one message header, refusing payloads over 'max_length'
+int protocol_read_header(int fd, ObaMessageHeader *header, uint32_t max_length);
+
+// --- Client Side ---
+
+// Connects to the server listening at 'path'. Returns the socket, or -1.
+int protocol_connect(const char *path);
+
+// Receives a batch of print() values
+typedef void (*ProtocolOutputFn)(void *user_data, const int32_t *values, int count);
+
+// Runs a script whose source hashes to 'hash': by the hash alone first, then
+// with the source if the server has not cached it. 'output' (which may be NULL)
+// gets the printed values as they arrive. Returns 0 once the server has
+// answered, with its result in *result and any error message in 'error', or
+// -1 if the connection failed.
+int protocol_run(int fd, uint64_t hash, const char *source, size_t source_length,
+                 const char *input, size_t input_length, ProtocolOutputFn output, void *user_data,
+                 ObaRunResult *result, char *error, size_t error_size);
+
+#endif // OBA_PROTOCOL_H
@@ -0,0 +1,53 @@
+#ifndef OBA_SERVER_H
+#define OBA_SERVER_H
+
+// A long-lived compile-and-run server on a Unix domain socket (see
+// oba_protocol.h for the wire format). Scripts are compiled once and kept in
+// a ProgramCache; runs are handed to a pool of worker threads. A connection
+// waits in the server's poll set between requests, so a worker is only busy
+// while a request is being read, run or answered.
+
+// Programs cached unless the options say otherwise
+#define OBA_SERVER_DEFAULT_CACHE 64
+
+// A worker gives up on a client that stalls mid-request for this many seconds
+#define OBA_SERVER_READ_TIMEOUT 10
+
+// A run checks whether the server is stopping or its client has gone after
+// this many statements
+#define OBA_SERVER_FUEL_SLICE 100000
+
+typedef struct {
+    const char *socket_path; // NULL for OBA_DEFAULT_SOCKET
+    int workers;             // Threads running scripts (0 for one per CPU)
+    int cache_size;          // Programs kept compiled (0 for OBA_SERVER_DEFAULT_CACHE)
+    long long max_statements; // Statements one request may execute (0 for no limit)
+} ObaServerOptions;
+
+typedef struct ObaServer ObaServer;
+
+// Binds and listens on the socket. Returns NULL after reporting an error to stderr.
+ObaServer* oba_server_create(const ObaServerOptions *options);
+
+// Serves requests until oba_server_stop is called, then ends the runs in
+// progress with an error to their clients. Returns 0, or -1 if the workers
+// could not be started.
+int oba_server_run(ObaServer *server);
+
+// Asks oba_server_run to return. Safe to call from a signal handler.
+void oba_server_stop(ObaServer *server);
+
+// Closes the socket (removing its file) and frees the cache
+void oba_server_free(ObaServer *server);
+
+// Totals since the server was created
+typedef struct {
+    long long requests;
+    long long cache_hits;
+    long long cache_misses;
+    long long evictions;
+} ObaServerStats;
+
+void oba_server_stats(ObaServer *server, ObaServerStats *stats);
+
+#endif // OBA_SERVER_H
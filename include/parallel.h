@@ -0,0 +1,44 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "vm.h"
+#include "ast.h"
+
+// Programs estimated at less work than this (see depgraph.h) are not worth
+// the threads and locking, and run sequentially
+#define PARALLEL_MIN_WORK 200000
+
+// ...as do programs whose longest dependency chain leaves less than this
+// speedup (in percent) on the table, however many threads there are
+#define PARALLEL_MIN_SPEEDUP_PERCENT 150
+
+// C stack for each extra thread, enough for the deepest recursion the VM allows
+#define PARALLEL_THREAD_STACK (16 * 1024 * 1024)
+
+// A parallel for is cut into this many grains (runs of consecutive iterations)
+// per thread: enough that threads which finish early can steal work from the
+// rest, few enough that taking a grain stays cheap next to running it
+#define PARALLEL_FOR_GRAINS_PER_THREAD 16
+
+// Loops estimated at less work than this (iterations times body nodes) run on one thread
+#define PARALLEL_FOR_MIN_WORK 20000
+
+// Runs the rest of the program from vm->pc, like vm_execute_program, but on up
+// to 'threads' threads. Top-level statements run as soon as every earlier
+// statement that writes what they read, or touches what they write, has
+// finished (see depgraph.h). Output still appears in program order, and a
+// runtime error is reported for the first failing statement in program order.
+// 'verbose' prints the decision as a [PARALLEL] line.
+void vm_execute_parallel(VirtualMachine *vm, ASTNode *program, int threads, int verbose);
+
+// Runs iterations [from, to) of a parallel for (see ast.h) on up to vm->threads
+// threads. Each thread starts with its reduction copies at the identity (0,
+// INT_MAX or INT_MIN) and takes grains from its own queue, stealing half of
+// another thread's remaining grains when it runs out; the copies are merged
+// into the globals at the end. print() output and [TRACE] lines come out in
+// iteration order, and a runtime error is reported for the first failing
+// iteration, as if the loop had run sequentially. After an error the
+// reductions are left as they were before the loop.
+void vm_execute_parallel_for(VirtualMachine *vm, ASTNode *loop, int from, int to);
+
+#endif // PARALLEL_H
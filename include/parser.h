@@ -3,23 +3,70 @@
 
 #include "lexer.h" // <-- Defines Lexer and Token
 #include "ast.h"   // <-- Defines ASTNode
+#include "profile.h"
+
+// A pending part of an expression on parse_expression's stack
+typedef enum {
+    FRAME_OPERATOR, // A binary operator waiting for its right-hand operand
+    FRAME_GROUP,    // An open '('
+    FRAME_INDEX,    // An 'a[' waiting for its index
+    FRAME_CALL,     // An 'f(' waiting for its next argument
+} ExprFrameKind;
+
+typedef struct {
+    ExprFrameKind kind;
+    Token *op;      // FRAME_OPERATOR: the operator token
+    int precedence; // FRAME_OPERATOR: its binding strength
+    ASTNode *node;  // FRAME_INDEX, FRAME_CALL: the node being completed
+} ExprFrame;
 
 // The Parser structure holds the state of our parsing
 typedef struct {
     Lexer *lexer;
     Token *current_token;
     Token *peek_token; // Lookahead token
+
+    // Pre-lexed input (see parser_create_from_tokens); NULL when reading from 'lexer'
+    Token **tokens;
+    int token_count;
+    int token_position;
+    int current_position; // Index of current_token in 'tokens'
+
+    // Lazy mode: the bodies of top-level 'if' statements are skipped over and
+    // left as STMT_LAZY placeholders (pre-lexed input only)
+    int lazy;
+    int in_function;  // Function bodies are always parsed in full
+    ASTNode *program; // The program being parsed, for placeholders to refer to
+
+    // With a profile of an earlier run, a top-level 'if' body that never ran is
+    // left as a placeholder too (pre-lexed input only)
+    const Profile *profile;
+    int cold_bodies; // Bodies skipped because of the profile
+
+    int error_count; // Syntax errors reported so far (bad statements are skipped)
+
+    // Scratch stacks for parse_expression, reused from one expression to the next
+    ASTNodeStack operands;
+    ExprFrame *frames;
+    int frame_count;
+    int frame_capacity;
     
 } Parser; // <-- THIS IS THE DEFINITION
 
 // --- Parser Core Functions ---
 
 Parser* parser_create(Lexer *l);
+// Parses an EOF-terminated token array (from lexer_tokenize), so lexing can run as its own phase
+Parser* parser_create_from_tokens(Token **tokens, int count);
 void parser_destroy(Parser *p);
 
 // The main function to start parsing
 ASTNode* parse_program(Parser *p);
 
+// Parses the statement a STMT_LAZY placeholder stands for. Nested 'if' bodies
+// are left lazy in turn. Returns NULL after reporting syntax errors to stderr.
+ASTNode* parse_lazy_statement(const ASTNode *lazy);
+
 // Helper function to advance tokens
 void parser_next_token(Parser *p);
 
@@ -0,0 +1,73 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+// An execution profile: how often each source line's statements ran, which
+// way its 'if' conditions went, and which values its 'switch' statements saw.
+// A run with --record-profile collects one; a later compilation given the
+// profile with --use-profile lays the program out for how it behaved.
+//
+// On disk a profile is text, one record per line:
+//   oba-profile 1 <program hash>
+//   stmt <line> <count>
+//   if <line> <taken> <not taken>
+//   case <line> <value> <count>
+
+#define PROFILE_MAGIC "oba-profile"
+#define PROFILE_VERSION 1
+
+// A switch checks its most frequent value before its binary search once that
+// value accounts for at least this share (in percent) of the switch's runs
+#define PROFILE_HOT_CASE_PERCENT 50
+
+// Times one switch (by line) saw one value
+typedef struct {
+    int line; // 0 for an empty slot
+    int value;
+    long long count;
+} ProfileCase;
+
+typedef struct {
+    uint64_t program_hash; // The program (see snapshot_hash_program) the counts belong to
+    int line_count;        // Counts cover lines 1..line_count
+
+    // Per line
+    long long *executed;  // Statements started
+    long long *taken;     // 'if' conditions that were true...
+    long long *not_taken; // ...and false
+
+    // Per switch line and value: an open-addressing hash table
+    ProfileCase *cases;
+    int case_count;
+    int case_capacity;    // A power of two
+} Profile;
+
+// An empty profile for a program of 'line_count' lines. Returns NULL if out of memory.
+Profile* profile_create(uint64_t program_hash, int line_count);
+void profile_free(Profile *profile);
+
+// Counting, called by the VM as it runs. Lines outside the profile are ignored.
+void profile_statement(Profile *profile, int line);
+void profile_branch(Profile *profile, int line, int taken);
+void profile_switch(Profile *profile, int line, int value);
+
+// Adds the counts saved in 'path' (if it exists and belongs to the same program)
+// to 'profile', so repeated recording runs accumulate. Returns 1 if counts were
+// added, 0 if there was nothing usable to add, or -1 if the file is malformed.
+int profile_load(Profile *profile, const char *path);
+
+// Writes 'profile' to 'path'. Returns 0 on success, -1 on error.
+int profile_save(const Profile *profile, const char *path);
+
+// 1 if the body of the 'if' on 'if_line', which starts on 'body_line', never
+// ran. An 'if' that was merged into a switch records no branches of its own;
+// then the body's own statement count decides.
+int profile_if_cold(const Profile *profile, int if_line, int body_line);
+
+// The value the switch on 'line' saw most often, if it accounts for at least
+// PROFILE_HOT_CASE_PERCENT of that switch's runs. Returns 1 and stores it in
+// *value, or returns 0.
+int profile_hot_value(const Profile *profile, int line, int *value);
+
+#endif // PROFILE_H
@@ -0,0 +1,72 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "oba.h"
+
+// Compiled programs kept by oba_server, keyed by the hash of their source
+// (see snapshot_hash_program) and evicted least recently used first. Each
+// entry also keeps the contexts its finished runs left behind, so a repeated
+// script needs neither a compile nor a fresh context. All functions are
+// thread-safe.
+
+// Idle contexts kept per program
+#define PROGRAM_CACHE_CONTEXTS 8
+
+typedef struct CachedProgram {
+    uint64_t hash;
+    ObaProgram *program;
+    char *source;          // Compared on lookup, in case two sources share a hash
+    size_t source_length;
+
+    int users;             // Runs holding the entry (see program_cache_release)
+    int evicted;           // Out of the cache; freed when the last user releases it
+    ObaContext *contexts[PROGRAM_CACHE_CONTEXTS];
+    int context_count;
+
+    struct CachedProgram *newer;  // Recency list, most recent at the head
+    struct CachedProgram *older;
+    struct CachedProgram *bucket_next;
+} CachedProgram;
+
+typedef struct {
+    pthread_mutex_t lock;
+    CachedProgram **buckets;
+    int bucket_count;      // A power of two
+    CachedProgram *newest;
+    CachedProgram *oldest;
+    int count;
+    int capacity;
+
+    long long hits;
+    long long misses;
+    long long evictions;
+} ProgramCache;
+
+// A cache of up to 'capacity' programs. Returns NULL if out of memory.
+ProgramCache* program_cache_create(int capacity);
+void program_cache_free(ProgramCache *cache);
+
+// Finds the program for 'hash' and makes it the most recent. With a 'source',
+// the cached source must match it too. Returns NULL on a miss; otherwise the
+// caller holds the entry until program_cache_release. Only misses with a
+// 'source' are counted, since the client follows a hash-only miss with one.
+CachedProgram* program_cache_get(ProgramCache *cache, uint64_t hash, const char *source, size_t source_length);
+
+// Adds a freshly compiled 'program', which the cache then owns, evicting the
+// least recently used entries beyond the capacity. If another thread cached the
+// same source meanwhile, 'program' is freed and that entry is returned instead.
+// Returns NULL if out of memory (and frees 'program'). The caller holds the entry.
+CachedProgram* program_cache_insert(ProgramCache *cache, uint64_t hash, ObaProgram *program,
+                                    const char *source, size_t source_length);
+
+// A context for running the entry's program: an idle one, reset, or a new one.
+// Returns NULL if out of memory.
+ObaContext* program_cache_context(ProgramCache *cache, CachedProgram *entry);
+
+// Gives back an entry, with the context used for it (or NULL), which must have been reset
+void program_cache_release(ProgramCache *cache, CachedProgram *entry, ObaContext *ctx);
+
+#endif // PROGRAM_CACHE_H
@@ -0,0 +1,39 @@
+#ifndef REACTIVE_H
+#define REACTIVE_H
+
+#include "vm.h"
+#include "ast.h"
+
+// Reactive recomputation: after one full recorded run, a change to one global
+// re-runs only the top-level statements it can reach, in program order.
+//
+// The record keeps the program's inputs (every global before the run) and,
+// for each statement, the values it left in the globals it may write and the
+// values it printed. To re-run statement i, every global it may touch is first
+// set to its value just before i in a full run: the version saved by the last
+// statement before i that may write it, or the input. A statement whose saved
+// versions come out unchanged stops the change from spreading any further.
+// The cost of an update therefore follows the statements it reaches, not the
+// size of the program.
+
+typedef struct Reactive Reactive;
+
+// Prepares to run 'program' reactively on 'vm'. Returns NULL and sets *error
+// if the program cannot be run this way (or memory runs out).
+Reactive* reactive_create(VirtualMachine *vm, ASTNode *program, const char **error);
+void reactive_free(Reactive *reactive);
+
+// Runs the whole program, taking the current globals as its inputs, and
+// records it. print() values are kept per statement (see reactive_output);
+// vm->output is left pointing at the recorder, so the caller restores it.
+// Runtime errors are raised through vm_runtime_error as usual.
+void reactive_run(Reactive *reactive);
+
+// Global 'symbol' has been given a new input value in VM memory: re-runs what
+// it affects. Returns how many statements ran. Output and errors are as for reactive_run.
+int reactive_update(Reactive *reactive, int symbol);
+
+// Everything a full run with the current inputs would have printed, in order
+const int* reactive_output(Reactive *reactive, int *count);
+
+#endif // REACTIVE_H
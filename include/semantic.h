@@ -0,0 +1,49 @@
+#ifndef SEMANTIC_H
+#define SEMANTIC_H
+
+#include "ast.h"
+#include "symtab.h"
+#include "profile.h"
+
+// Max number of user-defined functions in one program
+#define MAX_FUNCTIONS 100
+
+// Small functions ('return <expr>;' bodies up to this many nodes) are inlined at their call sites
+#define INLINE_MAX_NODES 16
+
+// At least this many consecutive 'if (x == K)' statements are merged into a switch
+#define SWITCH_MIN_CHAIN 3
+
+// A switch gets a jump table when it has this many labels and they span at most
+// SWITCH_JUMP_MAX_SPREAD values per label. Sparser ones are binary searched.
+#define SWITCH_JUMP_MIN_CASES 4
+#define SWITCH_JUMP_MAX_SPREAD 4
+
+// Flags for semantic_analyze
+#define SEMANTIC_VERBOSE   1 // Print each registration and inlining decision to stdout
+#define SEMANTIC_NO_INLINE 2 // Leave every call out of line (to measure what inlining saves)
+
+// Runs the semantic pass over a parsed program:
+//  1. Registers global variables, arrays and functions in 'st'.
+//  2. Resolves every name to a global slot or a call-frame slot (function scopes
+//     are child tables of 'st'), and every call to a built-in or a function.
+//  3. Rejects parallel for loops whose iterations could race on shared data.
+//  4. Inlines calls to small non-recursive functions, unless SEMANTIC_NO_INLINE.
+//  5. Folds constants, drops identities such as x * 1, and turns multiplication
+//     and division by constants into shifts and multiply-high sequences.
+//  6. Merges 'if (x == K)' chains into switches and gives dense switches a jump table.
+// 'flags' is a combination of the SEMANTIC_* flags above.
+// Returns 0 on success, or -1 after reporting semantic errors to stderr.
+int semantic_analyze(ASTNode *program, SymbolTable *st, int flags);
+
+// Parses and analyses the statement a STMT_LAZY placeholder (see parser.h)
+// stands for, and replaces the placeholder with it in place. Returns 0, or -1
+// after reporting syntax or semantic errors to stderr (the placeholder is then left as it was).
+int semantic_expand_lazy(ASTNode *lazy, SymbolTable *st);
+
+// Lays an analysed program out for the run 'profile' recorded: each binary-searched
+// switch that mostly saw one value tests that value first. 'verbose' prints each
+// decision. Cold 'if' bodies are handled earlier, by the parser (see parser.h).
+void semantic_apply_profile(ASTNode *program, const Profile *profile, int verbose);
+
+#endif // SEMANTIC_H
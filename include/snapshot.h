@@ -0,0 +1,30 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include "vm.h"
+
+// A snapshot file holds a header, the global symbol table and a raw copy of VM
+// memory. Memory starts on a page boundary so a restore can map it straight
+// from the file instead of reading it. The header also records how many bytes of
+// read() input the prefix consumed; a restore skips that much of its own input,
+// which must be the same input, so the tail reads on where the prefix stopped.
+#define SNAPSHOT_MAGIC "OBASNAP1"
+#define SNAPSHOT_VERSION 2
+
+// Hashes program source text (64-bit FNV-1a). Snapshots only restore into the program they came from.
+uint64_t snapshot_hash_program(const char *source);
+
+// Writes the VM's globals, its top-level position (vm->pc) and how far it has read
+// its input to 'path'. Returns 0 on success, -1 on error.
+int snapshot_save(const char *path, VirtualMachine *vm, uint64_t program_hash);
+
+// Maps the snapshot at 'path' copy-on-write as the VM's memory and sets vm->pc to
+// resume after the checkpoint. The file must come from the same program and
+// symbol layout, and its position must lie in 0..statement_count (the program's
+// top-level statements). Skips the input the prefix consumed; if the VM's input
+// is shorter than that, the restore fails. Returns 0 on success, -1 on error
+// (the VM's variables and position are left unchanged).
+int snapshot_restore(const char *path, VirtualMachine *vm, uint64_t program_hash, int statement_count);
+
+#endif // SNAPSHOT_H
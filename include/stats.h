@@ -0,0 +1,65 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// The phases of main() that are measured separately
+typedef enum {
+    PHASE_LEX,
+    PHASE_PARSE,
+    PHASE_SEMANTIC,
+    PHASE_EXECUTE,
+    PHASE_COUNT
+} StatsPhase;
+
+// Hardware counters read through Linux perf events, when the kernel allows it
+typedef enum {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_CACHE_MISSES,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_COUNT
+} StatsCounter;
+
+typedef struct {
+    double wall_ms;
+    double cpu_ms;
+    long long net_heap_bytes; // Bytes in use at the end minus at the start: what a phase
+                              // leaves allocated, not how much it allocated (may be negative)
+    uint64_t allocated_bytes; // Gross bytes requested through the counted allocator (alloc.h),
+                              // freed or not; C library internals such as memstreams are not seen
+    uint64_t counters[COUNTER_COUNT];
+} PhaseStats;
+
+typedef struct {
+    PhaseStats phases[PHASE_COUNT];
+    int token_count;
+    int node_count;
+    long peak_rss_kb;
+    int heap_available; // 0 where the C library cannot report heap use
+
+    // Counter file descriptors, -1 for counters that could not be opened
+    int perf_fds[COUNTER_COUNT];
+
+    // Readings taken by stats_begin for the phase in progress
+    double start_wall_ms;
+    double start_cpu_ms;
+    long long start_heap_bytes;
+    uint64_t start_allocated_bytes;
+    uint64_t start_counters[COUNTER_COUNT];
+} Stats;
+
+// Opens whichever hardware counters are available; the rest are reported as missing.
+// Call it before starting any threads, so the counters include them.
+void stats_init(Stats *stats);
+void stats_close(Stats *stats);
+
+// Brackets one phase; calling them again for the same phase adds to its totals
+void stats_begin(Stats *stats);
+void stats_end(Stats *stats, StatsPhase phase);
+
+// Writes the collected numbers as a table, or as one JSON object when 'json' is set
+void stats_report(Stats *stats, FILE *out, int json);
+
+#endif // STATS_H
@@ -7,26 +7,45 @@
 // Max number of variables we can support
 #define MAX_SYMBOLS 100
 
+// Array storage starts on a multiple of this many ints (64 bytes, one cache line)
+#define SYMTAB_ARRAY_ALIGN 16
+
+// Largest number of elements a single array may hold
+#define MAX_ARRAY_SIZE (1 << 26)
+
 // Structure to hold a symbol (variable name and its location)
 typedef struct {
     char *name;      // The variable identifier (e.g., "my_var")
     int stack_index; // Where the variable is stored in the VM's memory/stack
+    int size;        // Number of elements for an array, 0 for a scalar
+    int offset;      // For arrays: first element's position in the VM's memory
 } Symbol;
 
-// The Symbol Table structure
-typedef struct {
+// The Symbol Table structure. The global table owns VM memory; a function scope
+// is a child table whose stack_index values are positions in the call frame.
+typedef struct SymbolTable {
     Symbol symbols[MAX_SYMBOLS];
     int count; // Current number of defined symbols
+    int memory_size; // Total ints of VM memory needed (scalars followed by arrays)
+    struct SymbolTable *parent; // Enclosing scope, NULL for the global table
 } SymbolTable;
 
 // Function Prototypes
 SymbolTable* symtab_create();
+SymbolTable* symtab_create_scope(SymbolTable *parent);
 void symtab_destroy(SymbolTable *st);
 
 // Inserts a new symbol and returns its index. Returns -1 if table is full.
 int symtab_insert(SymbolTable *st, const char *name);
 
+// Inserts a new array symbol of 'size' elements and returns its index. Returns -1 on error.
+int symtab_insert_array(SymbolTable *st, const char *name, int size);
+
 // Looks up a symbol and returns its index. Returns -1 if not found.
 int symtab_lookup(SymbolTable *st, const char *name);
 
+// Looks up a symbol in 'st' and then its enclosing scopes. On success returns the
+// index and stores the table that holds it in '*owner'. Returns -1 if not found.
+int symtab_lookup_scoped(SymbolTable *st, const char *name, SymbolTable **owner);
+
 #endif // SYMTAB_H
@@ -7,6 +7,12 @@ typedef enum {
     TOKEN_INT,
     TOKEN_IF,
     TOKEN_PRINT,
+    TOKEN_RETURN,
+    TOKEN_SWITCH,
+    TOKEN_CASE,
+    TOKEN_DEFAULT,
+    TOKEN_PARALLEL,
+    TOKEN_FOR,
 
     // Operators and Delimiters
     TOKEN_ASSIGN,       // =
@@ -17,6 +23,12 @@ typedef enum {
     TOKEN_SEMICOLON,    // ;
     TOKEN_LPAREN,       // (
     TOKEN_RPAREN,       // )
+    TOKEN_LBRACKET,     // [
+    TOKEN_RBRACKET,     // ]
+    TOKEN_COMMA,        // ,
+    TOKEN_LBRACE,       // {
+    TOKEN_RBRACE,       // }
+    TOKEN_COLON,        // :
     TOKEN_EQUAL,        // ==
     TOKEN_LT,           // <
     TOKEN_GT,           // >
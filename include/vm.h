@@ -1,20 +1,124 @@
 #ifndef VM_H
 #define VM_H
 
+#include <setjmp.h>
+#include <limits.h>
+#include <stdio.h>
 #include "ast.h"
 #include "symtab.h"
+#include "input.h"
+#include "profile.h"
+
+// Size (in ints) of the call stack shared by all function frames
+#define VM_STACK_SIZE (64 * 1024)
+
+// Deepest chain of nested function calls before a stack overflow error
+#define VM_MAX_CALL_DEPTH 10000
+
+// Fuel a VM starts with: enough that a standalone run never runs out
+#define VM_FUEL_UNLIMITED LLONG_MAX
+
+// Receives each value passed to print()
+typedef void (*VMOutputFn)(void *user_data, int value);
+
+// Called when the VM's fuel runs out. Returns 0 to carry on, after refilling
+// vm->fuel, or -1 to stop the run with an "Out of fuel" runtime error.
+typedef int (*VMFuelFn)(void *user_data);
 
 // The Virtual Machine/Execution Environment
 typedef struct {
     SymbolTable *symtab;
-    int memory[MAX_SYMBOLS]; // Simple array to hold variable values
+    // One aligned block holding every variable: scalars at their stack_index,
+    // followed by each array's elements at its symbol's offset.
+    int *memory;
+    int memory_size; // Number of ints in 'memory'
+    int memory_is_mapped; // 1 if 'memory' is an mmap'd region (e.g. a restored snapshot)
+    int memory_is_shared; // 1 for a worker VM: 'memory' belongs to the VM it was created from
+
+    int pc; // Index of the next top-level program statement to run
+
+    // Call stack: frames are carved out of one block allocated on the first
+    // call, so calling a function never allocates.
+    int *stack;
+    int stack_top;    // First free slot in 'stack'
+    int *frame;       // Parameters and locals of the running function (NULL at top level)
+    int call_depth;
+    int return_value; // Set by STMT_RETURN
+
+    // Work stacks for expressions nested too deeply to evaluate by recursion.
+    // Calls made during such an evaluation stack their own work on top.
+    struct VMEvalFrame *eval_frames;
+    int eval_count;
+    int eval_capacity;
+    int *eval_values;
+    int value_count;
+    int value_capacity;
+
+    // Where print() output goes; NULL prints "Oba-C Output: <value>" to 'console'
+    VMOutputFn output;
+    void *output_data;
+    int trace; // 1 to print a [TRACE] line for every assignment (the default)
+    FILE *console; // Where [TRACE] lines and default print() output are written (stdout)
+
+    // Fuel-based preemption: every statement executed burns one unit. When 'fuel'
+    // drops below zero, 'out_of_fuel' is called, which may suspend the whole run
+    // (see the scheduler in liboba). Without a callback the tank is simply refilled.
+    long long fuel;
+    VMFuelFn out_of_fuel;
+    void *fuel_data;
+
+    // Threads a parallel for may spread its iterations over (1 runs them all on this VM)
+    int threads;
+
+    // When set, every statement, 'if' outcome and switch value is counted in it
+    // (see --record-profile). Owned by whoever set it; worker VMs never record.
+    Profile *profile;
+
+    // Where read() and read_all() take numbers from; NULL behaves like empty input.
+    // Owned by whoever set it.
+    InputReader *input;
+
+    // Runtime errors longjmp to 'error_jump' while 'error_jump_set' is 1, with the
+    // message in 'error_message'. Otherwise they are printed and the process exits.
+    jmp_buf error_jump;
+    int error_jump_set;
+    char error_message[256];
 } VirtualMachine;
 
 // Function Prototypes
 VirtualMachine* vm_create(SymbolTable *st);
 void vm_destroy(VirtualMachine *vm);
 
-// Main execution function
+// Like vm_create, but the VM takes over 'memory' (st->memory_size ints, see
+// vm_adopt_memory) instead of allocating zeroed memory of its own
+VirtualMachine* vm_create_on(SymbolTable *st, int *memory, int is_mapped);
+
+// Creates a VM that works on 'parent's variables and input but has its own call
+// and evaluation stacks, so statements that touch disjoint variables can run on
+// both at once (see parallel.h). Destroying it leaves the memory alone.
+VirtualMachine* vm_create_worker(VirtualMachine *parent);
+
+// Zeroes every variable and rewinds to the first statement, ready for another run
+void vm_reset(VirtualMachine *vm);
+
+// Empties the call and evaluation stacks (e.g. after a runtime error), keeping the variables
+void vm_unwind(VirtualMachine *vm);
+
+// Replaces the VM's memory with 'memory' (memory_size ints), which the VM then owns.
+// 'is_mapped' says whether to release it with munmap rather than free.
+void vm_adopt_memory(VirtualMachine *vm, int *memory, int is_mapped);
+
+// Runs top-level statements from vm->pc up to (not including) 'end', advancing vm->pc
+void vm_execute_until(VirtualMachine *vm, ASTNode *program, int end);
+
+// Main execution function: runs the rest of the program from vm->pc
 void vm_execute_program(VirtualMachine *vm, ASTNode *program);
 
-#endif // VM_H
\ No newline at end of file
+// Executes one statement. Returns 1 if it ran a 'return' (the value is in
+// vm->return_value), 0 otherwise.
+int vm_execute_statement(VirtualMachine *vm, ASTNode *stmt);
+
+// Stops the run with a runtime error (see error_jump above). Does not return.
+void vm_runtime_error(VirtualMachine *vm, const char *format, ...);
+
+#endif // VM_H
@@ -0,0 +1,287 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "depgraph.h"
+#include "semantic.h"
+#include "alloc.h"
+
+// --- Effects ---
+
+static void add_resource(uint64_t *bits, int resource) {
+    bits[resource / 64] |= 1ULL << (resource % 64);
+}
+
+int depgraph_has_resource(const uint64_t *bits, int resource) {
+    return (bits[resource / 64] >> (resource % 64)) & 1;
+}
+
+// What each user function may do when called, including through its own calls
+typedef struct {
+    ASTNode *functions[MAX_FUNCTIONS];
+    DepEffects summaries[MAX_FUNCTIONS];
+    int count;
+} FunctionSummaries;
+
+static const DepEffects* function_summary(const FunctionSummaries *f, const ASTNode *callee) {
+    for (int i = 0; i < f->count; i++) {
+        if (f->functions[i] == callee) return &f->summaries[i];
+    }
+    return NULL;
+}
+
+// Adds what running 'root' may read and write, and its estimated cost, to 'effects'.
+// Locals and parameters live in the caller's own frame, so only globals count.
+static void collect_effects(ASTNode *root, SymbolTable *st, const FunctionSummaries *f,
+                            DepEffects *effects, ASTNodeStack *pending) {
+    ast_stack_push(pending, root);
+
+    ASTNode *node;
+    while ((node = ast_stack_pop(pending)) != NULL) {
+        effects->cost++;
+        ast_stack_push_children(pending, node);
+
+        switch (node->type) {
+            case EXPR_IDENTIFIER:
+            case EXPR_INDEX:
+                if (!node->is_local) add_resource(effects->reads, node->slot);
+                break;
+            case STMT_ASSIGN:
+                if (!node->is_local) add_resource(effects->writes, node->slot);
+                break;
+            case EXPR_CALL: {
+                if (node->callee) {
+                    const DepEffects *summary = function_summary(f, node->callee);
+                    for (int w = 0; summary && w < DEP_WORDS; w++) {
+                        effects->reads[w] |= summary->reads[w];
+                        effects->writes[w] |= summary->writes[w];
+                    }
+                    effects->cost += DEP_CALL_COST;
+                    break;
+                }
+                if (node->builtin == BUILTIN_READ || node->builtin == BUILTIN_READ_ALL) {
+                    add_resource(effects->reads, DEP_RESOURCE_INPUT);
+                    add_resource(effects->writes, DEP_RESOURCE_INPUT);
+                }
+                if (node->builtin == BUILTIN_READ) break;
+
+                // The array built-ins: the first argument is modified by all but the reductions
+                int array = node->args[0]->slot;
+                effects->cost += st->symbols[array].size;
+                if (node->builtin == BUILTIN_ADD || node->builtin == BUILTIN_SCALE ||
+                    node->builtin == BUILTIN_READ_ALL) {
+                    add_resource(effects->writes, array);
+                }
+                break;
+            }
+            case STMT_PARALLEL_FOR:
+                // Its reductions combine into globals. The trip count is only known
+                // when it runs, so like a call it counts as heavy.
+                for (int r = 0; r < node->reduction_count; r++) {
+                    add_resource(effects->reads, node->reductions[r].slot);
+                    add_resource(effects->writes, node->reductions[r].slot);
+                }
+                effects->cost += DEP_CALL_COST;
+                break;
+            case STMT_LAZY:
+                // Not parsed yet, so it could touch anything
+                for (int r = 0; r < st->count; r++) {
+                    add_resource(effects->reads, r);
+                    add_resource(effects->writes, r);
+                }
+                add_resource(effects->reads, DEP_RESOURCE_INPUT);
+                add_resource(effects->writes, DEP_RESOURCE_INPUT);
+                effects->cost += node->lazy_token_count;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Summarises every function. A summary depends on those of the functions it
+// calls, so they are recomputed until none changes (recursion converges because
+// the sets only ever grow).
+static void summarise_functions(ASTNode *program, SymbolTable *st, FunctionSummaries *f,
+                                ASTNodeStack *pending) {
+    memset(f, 0, sizeof(*f));
+    for (int i = 0; i < program->statement_count; i++) {
+        ASTNode *stmt = program->statements[i];
+        if (stmt->type == STMT_FUNC_DECL && f->count < MAX_FUNCTIONS) {
+            f->functions[f->count++] = stmt;
+        }
+    }
+
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = 0; i < f->count; i++) {
+            DepEffects effects = {{0}, {0}, 0};
+            collect_effects(f->functions[i]->body, st, f, &effects, pending);
+            if (memcmp(effects.reads, f->summaries[i].reads, sizeof(effects.reads)) != 0 ||
+                memcmp(effects.writes, f->summaries[i].writes, sizeof(effects.writes)) != 0) {
+                f->summaries[i] = effects;
+                changed = 1;
+            }
+        }
+    }
+}
+
+// --- Graph Construction ---
+
+typedef struct {
+    int *items;
+    int count;
+    int capacity;
+} IntList;
+
+static int int_list_push(IntList *list, int value) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 16;
+        int *grown = (int*)counted_realloc(list->items, capacity * sizeof(int));
+        if (!grown) return -1;
+        list->items = grown;
+        list->capacity = capacity;
+    }
+    list->items[list->count++] = value;
+    return 0;
+}
+
+// Edges are gathered as (from, to) pairs, then packed into the graph's successor lists
+typedef struct {
+    IntList from;
+    IntList to;
+    int *last_source; // Last 'from' recorded for each 'to', to skip most repeats
+                      // (any left over are harmless: both ends count them)
+    long long *finish; // Cost of the most expensive chain ending at each statement
+    long long start;   // ...and where the current statement can start on it
+    int failed;
+} EdgeBuilder;
+
+static void add_edge(EdgeBuilder *b, int from, int to) {
+    if (from < 0 || from == to || b->last_source[to] == from) return;
+    b->last_source[to] = from;
+    if (int_list_push(&b->from, from) != 0 || int_list_push(&b->to, to) != 0) b->failed = 1;
+    if (b->finish[from] > b->start) b->start = b->finish[from];
+}
+
+void depgraph_free(DepGraph *graph) {
+    if (!graph) return;
+    free(graph->pred_count);
+    free(graph->succ_start);
+    free(graph->succ);
+    free(graph->cost);
+    free(graph);
+}
+
+DepEffects* depgraph_effects(ASTNode *program, SymbolTable *st, int first) {
+    int n = program->statement_count - first;
+    if (n < 0) n = 0;
+
+    DepEffects *effects = (DepEffects*)counted_calloc(n + 1, sizeof(DepEffects));
+    FunctionSummaries *functions = (FunctionSummaries*)counted_malloc(sizeof(FunctionSummaries));
+    if (!effects || !functions) {
+        free(effects);
+        free(functions);
+        return NULL;
+    }
+
+    ASTNodeStack pending = {0};
+    summarise_functions(program, st, functions, &pending);
+    for (int i = 0; i < n; i++) {
+        ASTNode *stmt = program->statements[first + i];
+        if (stmt->type != STMT_VAR_DECL && stmt->type != STMT_FUNC_DECL) {
+            collect_effects(stmt, st, functions, &effects[i], &pending);
+        }
+    }
+    free(functions);
+    ast_stack_free(&pending);
+    return effects;
+}
+
+DepGraph* depgraph_build(ASTNode *program, SymbolTable *st, int first) {
+    DepGraph *graph = (DepGraph*)counted_calloc(1, sizeof(DepGraph));
+    if (!graph) return NULL;
+    int n = program->statement_count - first;
+    if (n < 0) n = 0;
+    graph->first = first;
+    graph->count = n;
+
+    graph->pred_count = (int*)counted_calloc(n + 1, sizeof(int));
+    graph->succ_start = (int*)counted_calloc(n + 1, sizeof(int));
+    graph->cost = (long long*)counted_calloc(n + 1, sizeof(long long));
+
+    DepEffects *all = depgraph_effects(program, st, first);
+    EdgeBuilder b = {{0}, {0}, NULL, NULL, 0, 0};
+    b.last_source = (int*)counted_malloc((n + 1) * sizeof(int));
+    b.finish = (long long*)counted_calloc(n + 1, sizeof(long long));
+
+    // Per resource: the statement that last wrote it, and who has read it since
+    int last_writer[DEP_RESOURCES];
+    IntList readers[DEP_RESOURCES];
+    memset(readers, 0, sizeof(readers));
+    for (int r = 0; r < DEP_RESOURCES; r++) last_writer[r] = -1;
+
+    if (!graph->pred_count || !graph->succ_start || !graph->cost || !all ||
+        !b.last_source || !b.finish) {
+        b.failed = 1;
+    } else {
+        for (int i = 0; i <= n; i++) b.last_source[i] = -1;
+    }
+
+    for (int i = 0; i < n && !b.failed; i++) {
+        const DepEffects *effects = &all[i];
+        graph->cost[i] = effects->cost;
+        graph->total_cost += effects->cost;
+
+        // Read after write, write after write, and write after read
+        b.start = 0;
+        for (int r = 0; r < DEP_RESOURCES; r++) {
+            int reads = depgraph_has_resource(effects->reads, r);
+            int writes = depgraph_has_resource(effects->writes, r);
+            if (!reads && !writes) continue;
+
+            add_edge(&b, last_writer[r], i);
+            if (writes) {
+                for (int k = 0; k < readers[r].count; k++) add_edge(&b, readers[r].items[k], i);
+                readers[r].count = 0;
+                last_writer[r] = i;
+            } else if (int_list_push(&readers[r], i) != 0) {
+                b.failed = 1;
+            }
+        }
+        b.finish[i] = b.start + effects->cost;
+        if (b.finish[i] > graph->critical_cost) graph->critical_cost = b.finish[i];
+    }
+
+    // Pack the edges: count successors, turn the counts into offsets, then fill
+    if (!b.failed) {
+        graph->succ = (int*)counted_malloc((b.to.count + 1) * sizeof(int));
+        if (!graph->succ) b.failed = 1;
+    }
+    if (!b.failed) {
+        for (int e = 0; e < b.from.count; e++) {
+            graph->succ_start[b.from.items[e] + 1]++;
+            graph->pred_count[b.to.items[e]]++;
+        }
+        for (int i = 0; i < n; i++) graph->succ_start[i + 1] += graph->succ_start[i];
+
+        int *fill = b.last_source; // No longer needed for deduplication
+        memcpy(fill, graph->succ_start, (n + 1) * sizeof(int));
+        for (int e = 0; e < b.from.count; e++) {
+            graph->succ[fill[b.from.items[e]]++] = b.to.items[e];
+        }
+    }
+
+    for (int r = 0; r < DEP_RESOURCES; r++) free(readers[r].items);
+    free(b.from.items);
+    free(b.to.items);
+    free(b.last_source);
+    free(b.finish);
+    free(all);
+
+    if (b.failed) {
+        depgraph_free(graph);
+        return NULL;
+    }
+    return graph;
+}
@@ -0,0 +1,1041 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <limits.h>
+#include "semantic.h"
+#include "parser.h"
+#include "alloc.h"
+
+// State shared by the semantic walk
+typedef struct {
+    SymbolTable *globals;
+    SymbolTable *scope; // Current function (or parallel for) scope, NULL at the top level
+    ASTNode *loop;      // The parallel for being resolved, if any
+    ASTNode *functions[MAX_FUNCTIONS];
+    int function_count;
+    int errors;
+    int verbose; // Print [SYMBOL] and [INLINE] progress lines
+    ASTNodeStack pending; // Expressions are walked with this stack rather than recursion
+} SemanticContext;
+
+// Helper map for built-in functions. The first 'array_args' arguments must name global arrays.
+static struct {
+    const char *name;
+    BuiltinType type;
+    int arg_count;
+    int array_args;
+} builtins[] = {
+    {"sum", BUILTIN_SUM, 1, 1},
+    {"min", BUILTIN_MIN, 1, 1},
+    {"max", BUILTIN_MAX, 1, 1},
+    {"add", BUILTIN_ADD, 2, 2},
+    {"scale", BUILTIN_SCALE, 2, 1},
+    {"read", BUILTIN_READ, 0, 0},
+    {"read_all", BUILTIN_READ_ALL, 1, 1},
+    {NULL, BUILTIN_NONE, 0, 0} // Sentinel
+};
+
+static void semantic_error(SemanticContext *ctx, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "Semantic Error: ");
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    ctx->errors++;
+}
+
+static int lookup_builtin(const char *name) {
+    for (int i = 0; builtins[i].name != NULL; i++) {
+        if (strcmp(builtins[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+static ASTNode* lookup_function(SemanticContext *ctx, const char *name) {
+    for (int i = 0; i < ctx->function_count; i++) {
+        if (strcmp(ctx->functions[i]->name, name) == 0) return ctx->functions[i];
+    }
+    return NULL;
+}
+
+// --- Pass 1: Declarations ---
+
+// Registers every top-level variable, array and function
+static void register_declarations(SemanticContext *ctx, ASTNode *program) {
+    for (int i = 0; i < program->statement_count; i++) {
+        ASTNode *stmt = program->statements[i];
+
+        if (stmt->type == STMT_VAR_DECL && stmt->array_size > 0) {
+            int index = symtab_insert_array(ctx->globals, stmt->name, stmt->array_size);
+            if (index == -1) {
+                ctx->errors++;
+                continue;
+            }
+            if (ctx->verbose) {
+                printf("[SYMBOL] Array '%s[%d]' registered at memory offset %d\n",
+                       stmt->name, stmt->array_size, ctx->globals->symbols[index].offset);
+            }
+        } else if (stmt->type == STMT_VAR_DECL) {
+            int index = symtab_insert(ctx->globals, stmt->name);
+            if (index == -1) {
+                ctx->errors++;
+                continue;
+            }
+            if (ctx->verbose) {
+                printf("[SYMBOL] Variable '%s' registered at memory index %d\n", stmt->name, index);
+            }
+        } else if (stmt->type == STMT_FUNC_DECL) {
+            if (lookup_builtin(stmt->name) != -1 || lookup_function(ctx, stmt->name)) {
+                semantic_error(ctx, "Function '%s' already defined.", stmt->name);
+                continue;
+            }
+            if (ctx->function_count >= MAX_FUNCTIONS) {
+                semantic_error(ctx, "Too many functions. Max %d supported.", MAX_FUNCTIONS);
+                continue;
+            }
+            ctx->functions[ctx->function_count++] = stmt;
+            if (ctx->verbose) {
+                printf("[SYMBOL] Function '%s' registered with %d parameter(s)\n", stmt->name, stmt->param_count);
+            }
+        }
+    }
+
+    for (int i = 0; i < ctx->function_count; i++) {
+        if (symtab_lookup(ctx->globals, ctx->functions[i]->name) != -1) {
+            semantic_error(ctx, "'%s' is declared as both a variable and a function.", ctx->functions[i]->name);
+        }
+    }
+}
+
+// --- Pass 2: Name Resolution ---
+
+static void resolve_expression(SemanticContext *ctx, ASTNode *expr);
+static void resolve_statement(SemanticContext *ctx, ASTNode *stmt);
+static void resolve_parallel_for(SemanticContext *ctx, ASTNode *loop);
+
+// Binds a name to its slot, checking it is used as the right kind (array or scalar)
+static void resolve_name(SemanticContext *ctx, ASTNode *node, int want_array) {
+    SymbolTable *owner = NULL;
+    int index = symtab_lookup_scoped(ctx->scope ? ctx->scope : ctx->globals, node->name, &owner);
+    if (index == -1) {
+        semantic_error(ctx, "Undefined variable '%s'.", node->name);
+        return;
+    }
+
+    node->slot = owner->symbols[index].stack_index;
+    node->is_local = (owner != ctx->globals);
+
+    int is_array = (owner->symbols[index].size > 0);
+    if (want_array && !is_array) {
+        semantic_error(ctx, "'%s' is not an array.", node->name);
+    } else if (!want_array && is_array) {
+        semantic_error(ctx, "Array '%s' used without an index.", node->name);
+    }
+}
+
+// Binds a call to its built-in or function. Argument expressions are pushed
+// onto ctx->pending for resolve_expression to visit.
+static void resolve_call(SemanticContext *ctx, ASTNode *call) {
+    int b = lookup_builtin(call->name);
+    if (b != -1) {
+        call->builtin = builtins[b].type;
+        if (call->arg_count != builtins[b].arg_count) {
+            semantic_error(ctx, "%s() takes %d argument(s), got %d.",
+                           call->name, builtins[b].arg_count, call->arg_count);
+            return;
+        }
+        for (int i = 0; i < call->arg_count; i++) {
+            if (i >= builtins[b].array_args) {
+                ast_stack_push(&ctx->pending, call->args[i]);
+            } else if (call->args[i]->type != EXPR_IDENTIFIER) {
+                semantic_error(ctx, "Argument %d of %s() must be an array name.", i + 1, call->name);
+            } else {
+                resolve_name(ctx, call->args[i], 1);
+            }
+        }
+        return;
+    }
+
+    call->callee = lookup_function(ctx, call->name);
+    if (!call->callee) {
+        semantic_error(ctx, "Unknown function '%s'.", call->name);
+        return;
+    }
+    if (call->arg_count != call->callee->param_count) {
+        semantic_error(ctx, "%s() takes %d argument(s), got %d.",
+                       call->name, call->callee->param_count, call->arg_count);
+    }
+    for (int i = call->arg_count - 1; i >= 0; i--) {
+        ast_stack_push(&ctx->pending, call->args[i]);
+    }
+}
+
+static void resolve_expression(SemanticContext *ctx, ASTNode *expr) {
+    ast_stack_push(&ctx->pending, expr);
+
+    while ((expr = ast_stack_pop(&ctx->pending)) != NULL) {
+        switch (expr->type) {
+            case EXPR_LITERAL:
+                break;
+            case EXPR_IDENTIFIER:
+                resolve_name(ctx, expr, 0);
+                break;
+            case EXPR_INDEX:
+                resolve_name(ctx, expr, 1);
+                ast_stack_push(&ctx->pending, expr->index);
+                break;
+            case EXPR_BINARY:
+                ast_stack_push(&ctx->pending, expr->right);
+                ast_stack_push(&ctx->pending, expr->left);
+                break;
+            case EXPR_CALL:
+                resolve_call(ctx, expr);
+                break;
+            default:
+                semantic_error(ctx, "Unexpected node type %d in expression.", expr->type);
+                break;
+        }
+    }
+}
+
+static int compare_cases(const void *a, const void *b) {
+    int x = ((const SwitchCase*)a)->value;
+    int y = ((const SwitchCase*)b)->value;
+    return (x > y) - (x < y);
+}
+
+// Sorts the case labels by value, which the VM's lookup relies on, and rejects repeats
+static void resolve_switch(SemanticContext *ctx, ASTNode *stmt) {
+    SwitchTable *table = stmt->switch_table;
+
+    resolve_expression(ctx, stmt->condition);
+    for (int i = 0; i < stmt->statement_count; i++) {
+        resolve_statement(ctx, stmt->statements[i]);
+    }
+
+    if (table->count > 1) qsort(table->cases, table->count, sizeof(SwitchCase), compare_cases);
+    for (int i = 1; i < table->count; i++) {
+        if (table->cases[i].value == table->cases[i - 1].value) {
+            semantic_error(ctx, "Duplicate case value %d in switch.", table->cases[i].value);
+        }
+    }
+}
+
+static void resolve_statement(SemanticContext *ctx, ASTNode *stmt) {
+    if (!stmt) return;
+
+    switch (stmt->type) {
+        case STMT_VAR_DECL:
+            // Top-level declarations were registered in pass 1 and never reach here
+            if (!ctx->scope) {
+                semantic_error(ctx, "'%s' must be declared at the top level or in a function body.", stmt->name);
+            } else if (stmt->array_size > 0) {
+                semantic_error(ctx, "Array '%s' must be declared at the top level.", stmt->name);
+            } else if (symtab_insert(ctx->scope, stmt->name) == -1) {
+                ctx->errors++;
+            }
+            break;
+        case STMT_FUNC_DECL:
+            semantic_error(ctx, "Function '%s' must be defined at the top level.", stmt->name);
+            break;
+        case STMT_ASSIGN:
+            resolve_name(ctx, stmt, stmt->index != NULL);
+            stmt->untraced = ctx->loop && stmt->is_local && stmt->slot >= 1 &&
+                             stmt->slot <= ctx->loop->reduction_count;
+            resolve_expression(ctx, stmt->index);
+            resolve_expression(ctx, stmt->expression);
+            break;
+        case STMT_PRINT:
+            resolve_expression(ctx, stmt->print_expr);
+            break;
+        case STMT_IF:
+            resolve_expression(ctx, stmt->condition);
+            resolve_statement(ctx, stmt->body);
+            break;
+        case STMT_SWITCH:
+            resolve_switch(ctx, stmt);
+            break;
+        case STMT_EXPR:
+            resolve_expression(ctx, stmt->expression);
+            break;
+        case STMT_LAZY:
+            break; // Resolved by semantic_expand_lazy when it first runs
+        case STMT_PARALLEL_FOR:
+            resolve_parallel_for(ctx, stmt);
+            break;
+        case STMT_BLOCK:
+            for (int i = 0; i < stmt->statement_count; i++) {
+                resolve_statement(ctx, stmt->statements[i]);
+            }
+            break;
+        case STMT_RETURN:
+            if (!ctx->scope) {
+                semantic_error(ctx, "'return' outside of a function.");
+            } else if (ctx->loop) {
+                semantic_error(ctx, "'return' inside a parallel for.");
+            }
+            resolve_expression(ctx, stmt->expression);
+            break;
+        default:
+            semantic_error(ctx, "Unexpected node type %d in statement.", stmt->type);
+            break;
+    }
+}
+
+// Resolves a function body in its own scope: parameters take frame slots 0..n-1, locals follow
+static void resolve_function(SemanticContext *ctx, ASTNode *function) {
+    ctx->scope = symtab_create_scope(ctx->globals);
+    if (!ctx->scope) {
+        fprintf(stderr, "Error: Could not allocate a scope for '%s'.\n", function->name);
+        exit(1);
+    }
+
+    for (int i = 0; i < function->param_count; i++) {
+        if (symtab_insert(ctx->scope, function->params[i]) == -1) ctx->errors++;
+    }
+    resolve_statement(ctx, function->body);
+    function->frame_size = ctx->scope->count;
+
+    symtab_destroy(ctx->scope);
+    ctx->scope = NULL;
+}
+
+// Resolves a parallel for in a scope of its own, laid out as ast.h describes:
+// the index, then a private copy of each reduction's variable, then the locals
+static void resolve_parallel_for(SemanticContext *ctx, ASTNode *loop) {
+    if (ctx->scope) {
+        semantic_error(ctx, "A parallel for must be at the top level, outside functions and other loops.");
+        return;
+    }
+    resolve_expression(ctx, loop->left);
+    resolve_expression(ctx, loop->right);
+
+    ctx->scope = symtab_create_scope(ctx->globals);
+    if (!ctx->scope) {
+        fprintf(stderr, "Error: Could not allocate a scope for a parallel for.\n");
+        exit(1);
+    }
+    if (symtab_insert(ctx->scope, loop->name) == -1) ctx->errors++;
+
+    for (int i = 0; i < loop->reduction_count; i++) {
+        LoopReduction *reduction = &loop->reductions[i];
+        int index = symtab_lookup(ctx->globals, reduction->name);
+        if (index == -1 || ctx->globals->symbols[index].size > 0) {
+            semantic_error(ctx, "Reduction variable '%s' must be a global scalar.", reduction->name);
+        } else {
+            reduction->slot = index;
+        }
+        if (symtab_insert(ctx->scope, reduction->name) == -1) ctx->errors++;
+    }
+
+    ctx->loop = loop;
+    resolve_statement(ctx, loop->body);
+    ctx->loop = NULL;
+    loop->frame_size = ctx->scope->count;
+
+    symtab_destroy(ctx->scope);
+    ctx->scope = NULL;
+}
+
+// --- Pass 3: Data Races ---
+// The iterations of a parallel for run in any order and at the same time, so
+// the body may only write what belongs to its own iteration: its locals, its
+// private reduction copies, and elements a[i] at exactly the loop index i.
+// Everything else it could write is a race, reported here before the program
+// runs. Functions the body calls are checked too, with everything they write
+// counted as shared.
+
+// A node the body runs, and the function it is in (NULL for the body itself)
+typedef struct {
+    ASTNode *node;
+    ASTNode *function;
+} RaceSite;
+
+typedef struct {
+    RaceSite *items;
+    int count;
+    int capacity;
+} RaceSites;
+
+static void add_site(RaceSites *sites, ASTNode *node, ASTNode *function) {
+    if (sites->count == sites->capacity) {
+        int capacity = sites->capacity ? sites->capacity * 2 : 64;
+        RaceSite *grown = (RaceSite*)counted_realloc(sites->items, capacity * sizeof(RaceSite));
+        if (!grown) {
+            fprintf(stderr, "Error: Could not allocate memory for race checking.\n");
+            exit(1);
+        }
+        sites->items = grown;
+        sites->capacity = capacity;
+    }
+    sites->items[sites->count].node = node;
+    sites->items[sites->count++].function = function;
+}
+
+// Lists every node of the loop's body and of every function it can reach
+static void collect_sites(SemanticContext *ctx, ASTNode *loop, RaceSites *sites) {
+    ASTNode *queue[MAX_FUNCTIONS + 1]; // Functions still to walk; NULL stands for the body
+    int queued = 0;
+    queue[queued++] = NULL;
+
+    for (int next = 0; next < queued; next++) {
+        ASTNode *function = queue[next];
+        ast_stack_push(&ctx->pending, function ? function->body : loop->body);
+
+        ASTNode *node;
+        while ((node = ast_stack_pop(&ctx->pending)) != NULL) {
+            add_site(sites, node, function);
+            ast_stack_push_children(&ctx->pending, node);
+            if (node->type != EXPR_CALL || !node->callee) continue;
+
+            int seen = 0;
+            for (int i = 1; i < queued; i++) seen |= (queue[i] == node->callee);
+            if (!seen) queue[queued++] = node->callee;
+        }
+    }
+}
+
+// Returns 1 if 'index' is the loop's own index variable (frame slot 0)
+static int is_loop_index(const ASTNode *index, const ASTNode *function) {
+    return !function && index->type == EXPR_IDENTIFIER && index->is_local && index->slot == 0;
+}
+
+// Reports one race. 'function' is where the access is, or NULL for the body.
+static void race_error(SemanticContext *ctx, const ASTNode *function, const char *format, const char *name) {
+    char what[160];
+    snprintf(what, sizeof(what), format, name);
+    if (function) {
+        semantic_error(ctx, "Data race in parallel for: '%s', which it calls, %s.", function->name, what);
+    } else {
+        semantic_error(ctx, "Data race in parallel for: the body %s.", what);
+    }
+}
+
+static void check_parallel_for(SemanticContext *ctx, ASTNode *loop) {
+    RaceSites sites = {0};
+    collect_sites(ctx, loop, &sites);
+    int errors = ctx->errors;
+
+    // Writes: which arrays the iterations write, each at its own index
+    unsigned char written[MAX_SYMBOLS] = {0};
+    for (int s = 0; s < sites.count; s++) {
+        ASTNode *node = sites.items[s].node;
+        ASTNode *function = sites.items[s].function;
+
+        if (node->type == STMT_ASSIGN && node->is_local) {
+            if (!function && !node->index && node->slot == 0) {
+                semantic_error(ctx, "The loop index '%s' cannot be assigned in a parallel for.", node->name);
+            }
+        } else if (node->type == STMT_ASSIGN && !node->index) {
+            race_error(ctx, function, "writes the shared variable '%s' (use a local or a reduction)", node->name);
+        } else if (node->type == STMT_ASSIGN) {
+            if (!is_loop_index(node->index, function)) {
+                race_error(ctx, function, "writes '%s' at an index other than the loop index", node->name);
+            }
+            written[node->slot] = 1;
+        } else if (node->type == EXPR_CALL && node->builtin == BUILTIN_READ) {
+            race_error(ctx, function, "calls %s(), which takes input in no fixed order", node->name);
+        } else if (node->type == EXPR_CALL && (node->builtin == BUILTIN_ADD || node->builtin == BUILTIN_SCALE ||
+                                                node->builtin == BUILTIN_READ_ALL)) {
+            race_error(ctx, function, "rewrites all of '%s' in every iteration", node->args[0]->name);
+        }
+    }
+
+    // Reads: an array one iteration writes may only be read at that same index
+    for (int s = 0; ctx->errors == errors && s < sites.count; s++) {
+        ASTNode *node = sites.items[s].node;
+        ASTNode *function = sites.items[s].function;
+
+        if (node->type == EXPR_INDEX && written[node->slot] && !is_loop_index(node->index, function)) {
+            race_error(ctx, function, "reads '%s', which other iterations write, away from the loop index", node->name);
+        } else if (node->type == EXPR_CALL && !node->callee && node->arg_count > 0 &&
+                   node->args[0]->type == EXPR_IDENTIFIER && written[node->args[0]->slot]) {
+            race_error(ctx, function, "reads all of '%s', which the iterations write", node->args[0]->name);
+        }
+    }
+    free(sites.items);
+}
+
+// Checks every parallel for under 'root'
+static void check_parallel_loops(SemanticContext *ctx, ASTNode *root) {
+    ASTNodeStack loops = {0};
+    ast_stack_push(&ctx->pending, root);
+
+    ASTNode *node;
+    while ((node = ast_stack_pop(&ctx->pending)) != NULL) {
+        if (node->type == STMT_PARALLEL_FOR) ast_stack_push(&loops, node);
+        ast_stack_push_children(&ctx->pending, node);
+    }
+    for (int i = 0; i < loops.count; i++) {
+        check_parallel_for(ctx, loops.items[i]);
+    }
+    ast_stack_free(&loops);
+}
+
+// --- Pass 4: Inlining ---
+// A function whose body is a single 'return <expr>;' over parameters, globals and
+// pure built-ins is replaced at each call site by a copy of <expr>. Such a body
+// calls no user function, so it can never be recursive.
+
+static int is_pure(ASTNode *expr) {
+    ASTNodeStack pending = {0};
+    ast_stack_push(&pending, expr);
+
+    int pure = 1;
+    while (pure && (expr = ast_stack_pop(&pending)) != NULL) {
+        switch (expr->type) {
+            case EXPR_LITERAL:
+            case EXPR_IDENTIFIER:
+                break;
+            case EXPR_INDEX:
+                ast_stack_push(&pending, expr->index);
+                break;
+            case EXPR_BINARY:
+                ast_stack_push(&pending, expr->left);
+                ast_stack_push(&pending, expr->right);
+                break;
+            case EXPR_CALL:
+                // Only the array reductions; their arguments are array names
+                pure = expr->builtin == BUILTIN_SUM || expr->builtin == BUILTIN_MIN ||
+                       expr->builtin == BUILTIN_MAX;
+                break;
+            default:
+                pure = 0;
+                break;
+        }
+    }
+    ast_stack_free(&pending);
+    return pure;
+}
+
+// Counts references to parameter 'slot' in an inlinable body
+static int count_param_uses(const ASTNode *expr, int slot) {
+    if (!expr) return 0;
+    int count = (expr->type == EXPR_IDENTIFIER && expr->is_local && expr->slot == slot);
+    count += count_param_uses(expr->index, slot);
+    count += count_param_uses(expr->left, slot);
+    count += count_param_uses(expr->right, slot);
+    return count;
+}
+
+// Returns the expression to inline for calls to 'function', or NULL if it is not inlinable
+static ASTNode* inline_body(const ASTNode *function) {
+    const ASTNode *body = function->body;
+    if (body->statement_count != 1 || body->statements[0]->type != STMT_RETURN) return NULL;
+
+    ASTNode *expr = body->statements[0]->expression;
+    if (ast_node_count(expr) > INLINE_MAX_NODES || !is_pure(expr)) return NULL;
+    return expr;
+}
+
+// Replaces parameter references under 'node' with copies of the call's arguments
+static void substitute_params(ASTNode **node, ASTNode **args) {
+    if (!*node) return;
+    if ((*node)->type == EXPR_IDENTIFIER && (*node)->is_local) {
+        ASTNode *arg = ast_node_clone(args[(*node)->slot]);
+        ast_node_free(*node);
+        *node = arg;
+        return;
+    }
+    substitute_params(&(*node)->index, args);
+    substitute_params(&(*node)->left, args);
+    substitute_params(&(*node)->right, args);
+}
+
+static void try_inline(SemanticContext *ctx, ASTNode *call) {
+    ASTNode *expr = inline_body(call->callee);
+    if (!expr) return;
+
+    // Arguments must be side-effect free. Anything bigger than a variable or literal
+    // must be used exactly once, so it is neither duplicated nor dropped.
+    for (int i = 0; i < call->arg_count; i++) {
+        ASTNode *arg = call->args[i];
+        if (!is_pure(arg)) return;
+        int is_leaf = (arg->type == EXPR_LITERAL || arg->type == EXPR_IDENTIFIER);
+        if (!is_leaf && count_param_uses(expr, i) != 1) return;
+    }
+
+    ASTNode *inlined = ast_node_clone(expr);
+    substitute_params(&inlined, call->args);
+    if (ctx->verbose) printf("[INLINE] Call to '%s' inlined\n", call->name);
+
+    // Turn the call node into the inlined expression, in place
+    free(call->name);
+    for (int i = 0; i < call->arg_count; i++) {
+        ast_node_free(call->args[i]);
+    }
+    free(call->args);
+    *call = *inlined;
+    free(inlined);
+}
+
+// Visits every node bottom-up, so arguments are inlined before their enclosing call.
+// Nodes are listed parent-first, then handled in reverse, which puts every node after
+// everything below it. Inlining frees a call's arguments, which are already behind us.
+static void inline_calls(SemanticContext *ctx, ASTNode *root) {
+    ASTNodeStack order = {0};
+    ast_stack_push(&ctx->pending, root);
+
+    ASTNode *node;
+    while ((node = ast_stack_pop(&ctx->pending)) != NULL) {
+        ast_stack_push(&order, node);
+        ast_stack_push_children(&ctx->pending, node);
+    }
+
+    for (int i = order.count - 1; i >= 0; i--) {
+        node = order.items[i];
+        if (node->type == EXPR_CALL && node->callee) {
+            try_inline(ctx, node);
+        }
+    }
+    ast_stack_free(&order);
+}
+
+// --- Pass 5: Strength Reduction ---
+// Folds operations on two literals, drops identities (x + 0, x * 1, x - x, ...)
+// and turns multiplication and division by a constant into the cheaper
+// BinaryKinds. Every rewrite gives the same result as the original for every
+// value, including wraparound and C's rounding toward zero, and keeps any
+// runtime error the original could raise.
+
+// Sets *value to 'left op right' for two constants. Returns 0 for operations
+// that must stay for run time: division by zero (an error) and INT_MIN / -1.
+static int fold_constant(BinaryKind op, int left, int right, int *value) {
+    switch (op) {
+        case BINARY_ADD: *value = (int)((unsigned)left + (unsigned)right); return 1;
+        case BINARY_SUB: *value = (int)((unsigned)left - (unsigned)right); return 1;
+        case BINARY_MUL: *value = (int)((unsigned)left * (unsigned)right); return 1;
+        case BINARY_DIV:
+            if (right == 0 || (left == INT_MIN && right == -1)) return 0;
+            *value = left / right;
+            return 1;
+        case BINARY_EQUAL:   *value = left == right; return 1;
+        case BINARY_LESS:    *value = left < right; return 1;
+        case BINARY_GREATER: *value = left > right; return 1;
+        default: return 0;
+    }
+}
+
+// Returns k if value == 2^k for 1 <= k <= 30, else -1
+static int power_of_two(int value) {
+    for (int k = 1; k <= 30; k++) {
+        if (value == 1 << k) return k;
+    }
+    return -1;
+}
+
+// Finds the multiplier and shift for signed division by 'd' (2 <= |d|, d != INT_MIN),
+// following Hacker's Delight, section 10-1
+static void division_magic(int d, int *magic, int *shift) {
+    const unsigned two31 = 0x80000000u;
+    unsigned ad = d < 0 ? 0u - (unsigned)d : (unsigned)d;
+    unsigned t = two31 + ((unsigned)d >> 31);
+    unsigned anc = t - 1 - t % ad; // |nc|, the largest dividend with remainder ad - 1
+    unsigned q1 = two31 / anc, r1 = two31 - q1 * anc;
+    unsigned q2 = two31 / ad, r2 = two31 - q2 * ad;
+    unsigned delta;
+    int p = 31;
+    do {
+        p++;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= anc) {
+            q1++;
+            r1 -= anc;
+        }
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= ad) {
+            q2++;
+            r2 -= ad;
+        }
+        delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+
+    unsigned m = q2 + 1;
+    *magic = (int)(d < 0 ? 0u - m : m);
+    *shift = p - 32;
+}
+
+// Makes 'node' a literal, freeing its operands
+static void become_literal(ASTNode *node, int value) {
+    ast_node_free(node->left);
+    ast_node_free(node->right);
+    ASTNode *literal = ast_node_create(EXPR_LITERAL);
+    literal->value = value;
+    *node = *literal;
+    free(literal);
+}
+
+// Makes 'node' into its operand 'keep', freeing the other one
+static void become_operand(ASTNode *node, ASTNode *keep) {
+    ast_node_free(keep == node->left ? node->right : node->left);
+    *node = *keep;
+    free(keep);
+}
+
+static int same_variable(const ASTNode *a, const ASTNode *b) {
+    return a->slot == b->slot && a->is_local == b->is_local;
+}
+
+// A scalar variable or literal: reading it has no effect and cannot fail
+static int is_plain_value(const ASTNode *node) {
+    return node->type == EXPR_LITERAL || node->type == EXPR_IDENTIFIER;
+}
+
+// Rewrites one binary node whose operands are already reduced. Returns 1 if it changed.
+static int reduce_binary(ASTNode *node) {
+    ASTNode *left = node->left, *right = node->right;
+    int folded;
+
+    if (left->type == EXPR_LITERAL && right->type == EXPR_LITERAL &&
+        fold_constant(node->binary, left->value, right->value, &folded)) {
+        become_literal(node, folded);
+        return 1;
+    }
+
+    // Constants go on the right of '+' and '*'; a literal has no effect to reorder
+    if ((node->binary == BINARY_ADD || node->binary == BINARY_MUL) && left->type == EXPR_LITERAL) {
+        node->left = right;
+        node->right = left;
+        left = node->left;
+        right = node->right;
+    }
+
+    if (node->binary == BINARY_SUB && left->type == EXPR_IDENTIFIER && right->type == EXPR_IDENTIFIER &&
+        same_variable(left, right)) {
+        become_literal(node, 0);
+        return 1;
+    }
+    if (right->type != EXPR_LITERAL) return 0;
+
+    int k = right->value;
+    switch (node->binary) {
+        case BINARY_ADD:
+        case BINARY_SUB:
+            if (k != 0) return 0;
+            become_operand(node, left);
+            return 1;
+        case BINARY_MUL:
+            if (k == 1) {
+                become_operand(node, left);
+                return 1;
+            }
+            if (k == 0 && is_plain_value(left)) {
+                become_literal(node, 0);
+                return 1;
+            }
+            if (power_of_two(k) > 0) {
+                node->binary = BINARY_SHIFT_LEFT;
+                node->shift = power_of_two(k);
+                return 1;
+            }
+            return 0;
+        case BINARY_DIV:
+            if (k == 1) {
+                become_operand(node, left);
+                return 1;
+            }
+            if (power_of_two(k) > 0) {
+                node->binary = BINARY_DIV_POW2;
+                node->shift = power_of_two(k);
+                return 1;
+            }
+            // Zero stays a runtime error; -1 would overflow for INT_MIN, as in C
+            if (k == 0 || k == -1 || k == 1 || k == INT_MIN) return 0;
+            node->binary = BINARY_DIV_MAGIC;
+            division_magic(k, &node->magic, &node->shift);
+            node->magic_add = (k > 0 && node->magic < 0) ? 1 : (k < 0 && node->magic > 0) ? -1 : 0;
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// Reduces every binary node under 'root', bottom-up so operands are final first
+static void reduce_strength(SemanticContext *ctx, ASTNode *root) {
+    ASTNodeStack order = {0};
+    ast_stack_push(&ctx->pending, root);
+
+    ASTNode *node;
+    while ((node = ast_stack_pop(&ctx->pending)) != NULL) {
+        ast_stack_push(&order, node);
+        ast_stack_push_children(&ctx->pending, node);
+    }
+
+    int reduced = 0;
+    for (int i = order.count - 1; i >= 0; i--) {
+        node = order.items[i];
+        if (node->type == EXPR_BINARY) reduced += reduce_binary(node);
+    }
+    ast_stack_free(&order);
+    if (ctx->verbose && reduced) printf("[REDUCE] %d operation(s) simplified or strength-reduced\n", reduced);
+}
+
+// --- Pass 6: Switch Lowering ---
+// Runs of 'if (x == K)' on one variable become a STMT_SWITCH, and every switch
+// whose labels are dense enough gets a jump table. The rest are binary searched.
+
+// If 'cond' is 'x == K' or 'K == x' for a scalar variable x, returns x and stores K
+static ASTNode* equality_subject(ASTNode *cond, int *value) {
+    if (cond->type != EXPR_BINARY || cond->binary != BINARY_EQUAL) return NULL;
+
+    ASTNode *var = cond->left, *literal = cond->right;
+    if (var->type == EXPR_LITERAL) {
+        var = cond->right;
+        literal = cond->left;
+    }
+    if (var->type != EXPR_IDENTIFIER || literal->type != EXPR_LITERAL) return NULL;
+    *value = literal->value;
+    return var;
+}
+
+// may_modify for a body that has not been parsed, from its tokens
+static int lazy_may_modify(SemanticContext *ctx, const ASTNode *lazy, const ASTNode *var) {
+    for (int i = 0; i + 1 < lazy->lazy_token_count; i++) {
+        const Token *token = lazy->lazy_tokens[i];
+        TokenType next = lazy->lazy_tokens[i + 1]->type;
+        if (token->type == TOKEN_PARALLEL && !var->is_local) return 1; // Its reductions write globals
+        if (token->type != TOKEN_IDENTIFIER) continue;
+        if (next == TOKEN_ASSIGN && strcmp(token->lexeme, var->name) == 0) return 1;
+        if (next == TOKEN_LPAREN && !var->is_local && lookup_function(ctx, token->lexeme)) return 1;
+    }
+    return 0;
+}
+
+// Returns 1 if running 'body' might change 'var': it assigns it, or 'var' is a
+// global and the body calls a user function
+static int may_modify(SemanticContext *ctx, ASTNode *body, const ASTNode *var) {
+    int modifies = 0;
+    ast_stack_push(&ctx->pending, body);
+
+    ASTNode *node;
+    while ((node = ast_stack_pop(&ctx->pending)) != NULL) {
+        if (node->type == STMT_ASSIGN && !node->index && same_variable(node, var)) modifies = 1;
+        if (node->type == EXPR_CALL && node->callee && !var->is_local) modifies = 1;
+        if (node->type == STMT_LAZY && lazy_may_modify(ctx, node, var)) modifies = 1;
+        for (int i = 0; node->type == STMT_PARALLEL_FOR && i < node->reduction_count; i++) {
+            if (!var->is_local && node->reductions[i].slot == var->slot) modifies = 1;
+        }
+        ast_stack_push_children(&ctx->pending, node);
+    }
+    return modifies;
+}
+
+// Returns 1 if 'stmt' can join a chain on 'var' whose first 'count' labels are in 'table'
+static int continues_chain(ASTNode *stmt, const ASTNode *var, const SwitchTable *table, int *value) {
+    if (stmt->type != STMT_IF || !stmt->body) return 0;
+
+    ASTNode *subject = equality_subject(stmt->condition, value);
+    if (!subject || !same_variable(subject, var)) return 0;
+    for (int i = 0; i < table->count; i++) {
+        if (table->cases[i].value == *value) return 0; // Both bodies would run
+    }
+    return 1;
+}
+
+// Replaces statements[first..] with one switch, as long as they form a chain.
+// Returns how many statements the switch replaced, or 0 if the chain is too short.
+static int merge_if_chain(SemanticContext *ctx, ASTNode **statements, int first, int count) {
+    int value;
+    ASTNode *head = statements[first];
+    if (head->type != STMT_IF || !head->body) return 0;
+    ASTNode *var = equality_subject(head->condition, &value);
+    if (!var) return 0;
+
+    ASTNode *node = ast_node_create(STMT_SWITCH);
+    int end = first;
+    while (end < count && continues_chain(statements[end], var, node->switch_table, &value)) {
+        ast_switch_add_case(node, value, end - first);
+        end++;
+        // A later test would see the new value, so the chain stops here
+        if (may_modify(ctx, statements[end - 1]->body, var)) break;
+    }
+    if (end - first < SWITCH_MIN_CHAIN) {
+        ast_node_free(node);
+        return 0;
+    }
+
+    // Move the variable and the bodies into the switch, then drop the 'if' shells
+    ASTNode *cond = head->condition;
+    if (cond->left == var) cond->left = NULL;
+    else cond->right = NULL;
+    node->condition = var;
+
+    for (int i = first; i < end; i++) {
+        ast_program_add_statement(node, statements[i]->body);
+        statements[i]->body = NULL;
+        ast_node_free(statements[i]);
+    }
+    qsort(node->switch_table->cases, node->switch_table->count, sizeof(SwitchCase), compare_cases);
+    if (ctx->verbose) printf("[SWITCH] %d tests of '%s' merged into a switch\n", end - first, var->name);
+
+    node->line = head->line; // Where a profile records it
+    statements[first] = node;
+    return end - first;
+}
+
+// Merges every chain in one statement list, in place
+static void merge_if_chains(SemanticContext *ctx, ASTNode *list) {
+    int kept = 0;
+    for (int i = 0; i < list->statement_count; ) {
+        int merged = merge_if_chain(ctx, list->statements, i, list->statement_count);
+        list->statements[kept++] = list->statements[i];
+        i += merged ? merged : 1;
+    }
+    list->statement_count = kept;
+}
+
+// Adds a jump table if the labels cover enough of their range. 'cases' is sorted.
+static void build_jump_table(SemanticContext *ctx, ASTNode *node) {
+    SwitchTable *table = node->switch_table;
+    if (table->count < SWITCH_JUMP_MIN_CASES) return;
+
+    long long min = table->cases[0].value;
+    long long range = (long long)table->cases[table->count - 1].value - min + 1;
+    if (range > (long long)table->count * SWITCH_JUMP_MAX_SPREAD) {
+        if (ctx->verbose) printf("[SWITCH] %d sparse cases: binary search\n", table->count);
+        return;
+    }
+
+    table->jump_table = (int*)counted_malloc(range * sizeof(int));
+    if (!table->jump_table) {
+        fprintf(stderr, "Error: Could not allocate memory for a jump table.\n");
+        exit(1);
+    }
+    for (long long i = 0; i < range; i++) {
+        table->jump_table[i] = table->default_target;
+    }
+    for (int i = 0; i < table->count; i++) {
+        table->jump_table[table->cases[i].value - min] = table->cases[i].target;
+    }
+    table->jump_min = (int)min;
+    table->jump_size = (int)range;
+    if (ctx->verbose) printf("[SWITCH] %d cases: jump table over %d values\n", table->count, table->jump_size);
+}
+
+static void lower_switches(SemanticContext *ctx, ASTNode *program) {
+    ASTNodeStack order = {0};
+    ast_stack_push(&ctx->pending, program);
+
+    ASTNode *node;
+    while ((node = ast_stack_pop(&ctx->pending)) != NULL) {
+        ast_stack_push(&order, node);
+        ast_stack_push_children(&ctx->pending, node);
+    }
+
+    // Inner lists first: merging frees 'if' shells, which must already be behind us
+    for (int i = order.count - 1; i >= 0; i--) {
+        node = order.items[i];
+        if (node->type == NODE_PROGRAM || node->type == STMT_BLOCK) merge_if_chains(ctx, node);
+    }
+    ast_stack_free(&order);
+
+    // Switches (including the new ones) are found in a fresh walk
+    ast_stack_push(&ctx->pending, program);
+    while ((node = ast_stack_pop(&ctx->pending)) != NULL) {
+        if (node->type == STMT_SWITCH) build_jump_table(ctx, node);
+        ast_stack_push_children(&ctx->pending, node);
+    }
+}
+
+// --- Profile-Guided Layout ---
+
+// Finds the body a switch runs for 'value', as the VM would without a hot value
+static int switch_target(const SwitchTable *table, int value) {
+    for (int i = 0; i < table->count; i++) {
+        if (table->cases[i].value == value) return table->cases[i].target;
+    }
+    return table->default_target;
+}
+
+void semantic_apply_profile(ASTNode *program, const Profile *profile, int verbose) {
+    ASTNodeStack pending = {0};
+    ast_stack_push(&pending, program);
+
+    ASTNode *node;
+    while ((node = ast_stack_pop(&pending)) != NULL) {
+        SwitchTable *table = node->switch_table;
+        int value;
+        if (node->type == STMT_SWITCH && !table->jump_table &&
+            profile_hot_value(profile, node->line, &value)) {
+            table->has_hot = 1;
+            table->hot_value = value;
+            table->hot_target = switch_target(table, value);
+            if (verbose) printf("[PROFILE] Switch on line %d tests %d first\n", node->line, value);
+        }
+        ast_stack_push_children(&pending, node);
+    }
+    ast_stack_free(&pending);
+}
+
+// --- Entry Point ---
+
+int semantic_analyze(ASTNode *program, SymbolTable *st, int flags) {
+    if (program->type != NODE_PROGRAM) return -1;
+
+    int verbose = (flags & SEMANTIC_VERBOSE) != 0;
+    if (verbose) printf("\n--- Semantic Pass: Registering Symbols ---\n");
+
+    SemanticContext ctx = {0};
+    ctx.globals = st;
+    ctx.verbose = verbose;
+
+    register_declarations(&ctx, program);
+    if (ctx.errors) return -1;
+    int result = -1;
+
+    for (int i = 0; i < program->statement_count; i++) {
+        ASTNode *stmt = program->statements[i];
+        if (stmt->type == STMT_VAR_DECL) continue; // Registered in pass 1
+        if (stmt->type == STMT_FUNC_DECL) {
+            resolve_function(&ctx, stmt);
+        } else {
+            resolve_statement(&ctx, stmt);
+        }
+    }
+    if (!ctx.errors) check_parallel_loops(&ctx, program);
+    if (!ctx.errors) {
+        if (!(flags & SEMANTIC_NO_INLINE)) inline_calls(&ctx, program);
+        reduce_strength(&ctx, program);
+        lower_switches(&ctx, program);
+        result = 0;
+    }
+    ast_stack_free(&ctx.pending);
+    return result;
+}
+
+int semantic_expand_lazy(ASTNode *lazy, SymbolTable *st) {
+    ASTNode *stmt = parse_lazy_statement(lazy);
+    if (!stmt) return -1;
+
+    // Lazy bodies only occur outside functions, so names resolve to globals
+    SemanticContext ctx = {0};
+    ctx.globals = st;
+    ASTNode *program = lazy->lazy_program;
+    for (int i = 0; i < program->statement_count && ctx.function_count < MAX_FUNCTIONS; i++) {
+        if (program->statements[i]->type == STMT_FUNC_DECL) {
+            ctx.functions[ctx.function_count++] = program->statements[i];
+        }
+    }
+
+    resolve_statement(&ctx, stmt);
+    if (!ctx.errors) check_parallel_loops(&ctx, stmt);
+    if (!ctx.errors) {
+        inline_calls(&ctx, stmt);
+        reduce_strength(&ctx, stmt);
+        lower_switches(&ctx, stmt);
+    }
+    ast_stack_free(&ctx.pending);
+    if (ctx.errors) {
+        ast_node_free(stmt);
+        return -1;
+    }
+
+    // Become the parsed statement, in place, so whatever pointed at the placeholder now runs it
+    *lazy = *stmt;
+    free(stmt);
+    return 0;
+}
@@ -1,12 +1,23 @@
 #include <stdlib.h>
 #include <string.h>
 #include "symtab.h"
+#include "alloc.h"
 
 // Creates and initializes a new Symbol Table
 SymbolTable* symtab_create() {
-    SymbolTable *st = (SymbolTable*)calloc(1, sizeof(SymbolTable));
+    SymbolTable *st = (SymbolTable*)counted_calloc(1, sizeof(SymbolTable));
     if (!st) return NULL;
     st->count = 0;
+    // Scalars occupy the first MAX_SYMBOLS ints; array storage begins on the next aligned boundary
+    st->memory_size = (MAX_SYMBOLS + SYMTAB_ARRAY_ALIGN - 1) / SYMTAB_ARRAY_ALIGN * SYMTAB_ARRAY_ALIGN;
+    return st;
+}
+
+// Creates a nested scope (e.g. a function body) whose symbols live in a call frame
+SymbolTable* symtab_create_scope(SymbolTable *parent) {
+    SymbolTable *st = (SymbolTable*)counted_calloc(1, sizeof(SymbolTable));
+    if (!st) return NULL;
+    st->parent = parent;
     return st;
 }
 
@@ -31,6 +42,18 @@ int symtab_lookup(SymbolTable *st, const char *name) {
     return -1; // Not found
 }
 
+// Looks up a symbol by name, searching enclosing scopes from the innermost out
+int symtab_lookup_scoped(SymbolTable *st, const char *name, SymbolTable **owner) {
+    for (SymbolTable *scope = st; scope; scope = scope->parent) {
+        int index = symtab_lookup(scope, name);
+        if (index != -1) {
+            *owner = scope;
+            return index;
+        }
+    }
+    return -1; // Not found
+}
+
 // Inserts a new symbol. Uses the next available stack index as its location.
 int symtab_insert(SymbolTable *st, const char *name) {
     if (st->count >= MAX_SYMBOLS) {
@@ -45,9 +68,33 @@ int symtab_insert(SymbolTable *st, const char *name) {
     }
     
     Symbol *s = &st->symbols[st->count];
-    s->name = strdup(name);
+    s->name = counted_strdup(name);
     s->stack_index = st->count; // Assign the current count as the memory address
     
     st->count++;
     return s->stack_index;
-}
\ No newline at end of file
+}
+
+// Inserts a new array symbol. Its elements get a contiguous, aligned block of VM memory.
+int symtab_insert_array(SymbolTable *st, const char *name, int size) {
+    if (size <= 0 || size > MAX_ARRAY_SIZE) {
+        fprintf(stderr, "Error: Array '%s' size %d out of range (1..%d).\n", name, size, MAX_ARRAY_SIZE);
+        return -1;
+    }
+
+    // Keep the next array aligned too
+    int padded = (size + SYMTAB_ARRAY_ALIGN - 1) / SYMTAB_ARRAY_ALIGN * SYMTAB_ARRAY_ALIGN;
+    if (padded > MAX_ARRAY_SIZE * 4 - st->memory_size) {
+        fprintf(stderr, "Error: Out of array memory while declaring '%s'.\n", name);
+        return -1;
+    }
+
+    int index = symtab_insert(st, name);
+    if (index == -1) return -1;
+
+    Symbol *s = &st->symbols[index];
+    s->size = size;
+    s->offset = st->memory_size;
+    st->memory_size += padded;
+    return index;
+}
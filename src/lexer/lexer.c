@@ -2,12 +2,13 @@
 #include <string.h> // <-- Added for strnlen, memcpy
 #include <ctype.h>
 #include "lexer.h"
+#include "alloc.h"
 
 // --- ADDED: Portable strndup implementation ---
 // This is needed because strndup is not standard C (it's POSIX).
 static char *strndup_portable(const char *s, size_t n) {
     size_t len = strnlen(s, n);
-    char *new_s = (char *)malloc(len + 1);
+    char *new_s = (char *)counted_malloc(len + 1);
     if (new_s == NULL) return NULL;
     memcpy(new_s, s, len);
     new_s[len] = '\0';
@@ -22,13 +23,19 @@ static struct {
     {"int", TOKEN_INT},
     {"if", TOKEN_IF},
     {"print", TOKEN_PRINT},
+    {"return", TOKEN_RETURN},
+    {"switch", TOKEN_SWITCH},
+    {"case", TOKEN_CASE},
+    {"default", TOKEN_DEFAULT},
+    {"parallel", TOKEN_PARALLEL},
+    {"for", TOKEN_FOR},
     {NULL, TOKEN_ILLEGAL} // Sentinel
 };
 
 // --- Lexer State Management Functions ---
 
 Lexer* lexer_create(const char *source_code) {
-    Lexer *l = (Lexer *)malloc(sizeof(Lexer));
+    Lexer *l = (Lexer *)counted_malloc(sizeof(Lexer));
     if (!l) return NULL;
 
     l->source = source_code;
@@ -141,7 +148,13 @@ Token* lexer_next_token(Lexer *l) {
         case '/': advance(l); return token_create(TOKEN_SLASH, "/", l->line, start_col);
         case '(': advance(l); return token_create(TOKEN_LPAREN, "(", l->line, start_col);
         case ')': advance(l); return token_create(TOKEN_RPAREN, ")", l->line, start_col);
+        case '[': advance(l); return token_create(TOKEN_LBRACKET, "[", l->line, start_col);
+        case ']': advance(l); return token_create(TOKEN_RBRACKET, "]", l->line, start_col);
+        case ',': advance(l); return token_create(TOKEN_COMMA, ",", l->line, start_col);
+        case '{': advance(l); return token_create(TOKEN_LBRACE, "{", l->line, start_col);
+        case '}': advance(l); return token_create(TOKEN_RBRACE, "}", l->line, start_col);
         case ';': advance(l); return token_create(TOKEN_SEMICOLON, ";", l->line, start_col);
+        case ':': advance(l); return token_create(TOKEN_COLON, ":", l->line, start_col);
 
         case '=':
             // Check for '==' (EQUAL) or '=' (ASSIGN)
@@ -165,4 +178,27 @@ Token* lexer_next_token(Lexer *l) {
             char illegal_str[2] = {current_char, '\0'};
             return token_create(TOKEN_ILLEGAL, illegal_str, l->line, start_col);
     }
-}
\ No newline at end of file
+}
+
+// Lexes everything up to and including EOF in one go
+Token** lexer_tokenize(Lexer *l, int *count) {
+    int capacity = 256;
+    Token **tokens = (Token**)counted_malloc(capacity * sizeof(Token*));
+    *count = 0;
+
+    while (tokens) {
+        if (*count == capacity) {
+            capacity *= 2;
+            Token **grown = (Token**)counted_realloc(tokens, capacity * sizeof(Token*));
+            if (!grown) {
+                free(tokens);
+                return NULL;
+            }
+            tokens = grown;
+        }
+        Token *t = lexer_next_token(l);
+        tokens[(*count)++] = t;
+        if (t->type == TOKEN_EOF) break;
+    }
+    return tokens;
+}
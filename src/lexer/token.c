@@ -1,24 +1,28 @@
 #include <stdlib.h>
 #include <string.h>
 #include "token.h"
+#include "alloc.h"
 
 // Helper array for debugging token types
 const char *TokenType_names[] = {
-    "INT", "IF", "PRINT", 
+    "INT", "IF", "PRINT", "RETURN", "SWITCH", "CASE", "DEFAULT",
+    "PARALLEL", "FOR",
     "ASSIGN", "PLUS", "MINUS", "STAR", "SLASH", "SEMICOLON", 
-    "LPAREN", "RPAREN", "EQUAL", "LT", "GT",
+    "LPAREN", "RPAREN", "LBRACKET", "RBRACKET", "COMMA",
+    "LBRACE", "RBRACE", "COLON",
+    "EQUAL", "LT", "GT",
     "IDENTIFIER", "INTEGER_LITERAL", 
     "EOF", "ILLEGAL"
 };
 
 // Function to create a new Token
 Token* token_create(TokenType type, const char *lexeme, int line, int column) {
-    Token *t = (Token *)malloc(sizeof(Token));
+    Token *t = (Token *)counted_malloc(sizeof(Token));
     if (!t) return NULL; 
 
     t->type = type;
     // Lexeme needs to be copied as the Lexer might overwrite the input buffer
-    t->lexeme = strdup(lexeme); 
+    t->lexeme = counted_strdup(lexeme); 
     t->line = line;
     t->column = column;
 
@@ -1,11 +1,19 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "lexer.h"
 #include "token.h"
 #include "parser.h" // <-- THIS LINE FIXES THE ERROR
 #include "ast.h"
 #include "symtab.h" 
+#include "semantic.h"
 #include "vm.h"     
+#include "snapshot.h"
+#include "profile.h"
+#include "stats.h"
+#include "input.h"
+#include "parallel.h"
+#include "alloc.h"
 
 // Test source code for Oba-C
 const char *test_source = 
@@ -19,80 +27,375 @@ const char *test_source =
     "print(my_score); \n";
 
 // --- AST Printing Function (for debugging) ---
-void ast_print(ASTNode *node, int indent) {
-    if (!node) return;
-
-    for (int i = 0; i < indent; i++) printf("  ");
-
-    switch (node->type) {
-        case NODE_PROGRAM:
-            printf("Program:\n");
-            for (int i = 0; i < node->statement_count; i++) {
-                ast_print(node->statements[i], indent + 1);
-            }
-            break;
-        case STMT_VAR_DECL:
-            printf("VarDecl: %s\n", node->name);
-            break;
-        case STMT_ASSIGN:
-            printf("Assign: %s\n", node->name);
-            ast_print(node->expression, indent + 1);
-            break;
-        case STMT_PRINT:
-            printf("Print:\n");
-            ast_print(node->print_expr, indent + 1);
-            break;
-        case STMT_IF:
-            printf("If:\n");
-            for (int i = 0; i < indent + 1; i++) printf("  ");
-            printf("Condition:\n");
-            ast_print(node->condition, indent + 2);
-            for (int i = 0; i < indent + 1; i++) printf("  ");
-            printf("Body:\n");
-            ast_print(node->body, indent + 2);
-            break;
-        case EXPR_BINARY:
-            printf("BinaryOp: %s\n", node->op->lexeme);
-            ast_print(node->left, indent + 1);
-            ast_print(node->right, indent + 1);
-            break;
-        case EXPR_LITERAL:
-            printf("Literal: %d\n", node->value);
-            break;
-        case EXPR_IDENTIFIER:
-            printf("Identifier: %s\n", node->name);
-            break;
+
+// Levels deeper than this are printed with their depth instead of more
+// indentation, so dumping a very deep tree stays linear in its size.
+#define AST_PRINT_MAX_INDENT 32
+
+// One line still to print: a node, or a heading such as "Condition:".
+// When 'switch_body' is set, the heading lists the labels of that body of switch 'node'.
+typedef struct {
+    ASTNode *node;
+    const char *label;
+    int indent;
+    int switch_body;
+} PrintItem;
+
+typedef struct {
+    PrintItem *items;
+    int count;
+    int capacity;
+} PrintStack;
+
+static void print_push(PrintStack *stack, ASTNode *node, const char *label, int indent) {
+    if (!node && !label) return;
+    if (stack->count == stack->capacity) {
+        int capacity = stack->capacity ? stack->capacity * 2 : 64;
+        PrintItem *grown = (PrintItem*)counted_realloc(stack->items, capacity * sizeof(PrintItem));
+        if (!grown) {
+            fprintf(stderr, "Error: Could not allocate memory to print the AST.\n");
+            exit(1);
+        }
+        stack->items = grown;
+        stack->capacity = capacity;
+    }
+    PrintItem *item = &stack->items[stack->count++];
+    item->node = node;
+    item->label = label;
+    item->indent = indent;
+    item->switch_body = -1;
+}
+
+// Queues the "Case 1, 2:" heading for body 'body' of a switch
+static void print_push_case(PrintStack *stack, ASTNode *node, int body, int indent) {
+    print_push(stack, node, NULL, indent);
+    stack->items[stack->count - 1].switch_body = body;
+}
+
+static void print_case_labels(const ASTNode *node, int body) {
+    const SwitchTable *table = node->switch_table;
+    int printed = 0;
+
+    for (int i = 0; i < table->count; i++) {
+        if (table->cases[i].target != body) continue;
+        printf("%s%d", printed++ ? ", " : "Case ", table->cases[i].value);
+    }
+    if (table->default_target == body) {
+        printf(printed ? ", default" : "Default");
+    }
+    printf(":\n");
+}
+
+static void print_indent(int indent) {
+    int shown = indent < AST_PRINT_MAX_INDENT ? indent : AST_PRINT_MAX_INDENT;
+    printf("%*s", shown * 2, "");
+    if (indent > shown) printf("[depth %d] ", indent);
+}
+
+// Prints the tree without recursion: children are pushed in reverse so they pop in order
+void ast_print(ASTNode *root, int indent) {
+    PrintStack stack = {0};
+    print_push(&stack, root, NULL, indent);
+
+    while (stack.count > 0) {
+        PrintItem item = stack.items[--stack.count];
+        ASTNode *node = item.node;
+        indent = item.indent;
+
+        print_indent(indent);
+        if (item.label) {
+            printf("%s\n", item.label);
+            continue;
+        }
+        if (item.switch_body >= 0) {
+            print_case_labels(node, item.switch_body);
+            continue;
+        }
+
+        switch (node->type) {
+            case NODE_PROGRAM:
+            case STMT_BLOCK:
+                printf(node->type == NODE_PROGRAM ? "Program:\n" : "Block:\n");
+                for (int i = node->statement_count - 1; i >= 0; i--) {
+                    print_push(&stack, node->statements[i], NULL, indent + 1);
+                }
+                break;
+            case STMT_VAR_DECL:
+                if (node->array_size > 0) {
+                    printf("VarDecl: %s[%d]\n", node->name, node->array_size);
+                } else {
+                    printf("VarDecl: %s\n", node->name);
+                }
+                break;
+            case STMT_ASSIGN:
+                printf("Assign: %s\n", node->name);
+                print_push(&stack, node->expression, NULL, indent + 1);
+                if (node->index) {
+                    print_push(&stack, node->index, NULL, indent + 2);
+                    print_push(&stack, NULL, "Index:", indent + 1);
+                }
+                break;
+            case STMT_EXPR:
+                printf("ExprStmt:\n");
+                print_push(&stack, node->expression, NULL, indent + 1);
+                break;
+            case STMT_FUNC_DECL:
+                printf("Function: %s(", node->name);
+                for (int i = 0; i < node->param_count; i++) {
+                    printf("%s%s", i ? ", " : "", node->params[i]);
+                }
+                printf(")\n");
+                print_push(&stack, node->body, NULL, indent + 1);
+                break;
+            case STMT_RETURN:
+                printf("Return:\n");
+                print_push(&stack, node->expression, NULL, indent + 1);
+                break;
+            case STMT_PRINT:
+                printf("Print:\n");
+                print_push(&stack, node->print_expr, NULL, indent + 1);
+                break;
+            case STMT_IF:
+                printf("If:\n");
+                print_push(&stack, node->body, NULL, indent + 2);
+                print_push(&stack, NULL, "Body:", indent + 1);
+                print_push(&stack, node->condition, NULL, indent + 2);
+                print_push(&stack, NULL, "Condition:", indent + 1);
+                break;
+            case STMT_SWITCH:
+                printf("Switch:\n");
+                for (int i = node->statement_count - 1; i >= 0; i--) {
+                    print_push(&stack, node->statements[i], NULL, indent + 2);
+                    print_push_case(&stack, node, i, indent + 1);
+                }
+                print_push(&stack, node->condition, NULL, indent + 2);
+                print_push(&stack, NULL, "Condition:", indent + 1);
+                break;
+            case STMT_PARALLEL_FOR:
+                printf("ParallelFor: %s", node->name);
+                for (int i = 0; i < node->reduction_count; i++) {
+                    BuiltinType kind = node->reductions[i].kind;
+                    printf(" %s(%s)", kind == BUILTIN_SUM ? "sum" : kind == BUILTIN_MIN ? "min" : "max",
+                           node->reductions[i].name);
+                }
+                printf("\n");
+                print_push(&stack, node->body, NULL, indent + 2);
+                print_push(&stack, NULL, "Body:", indent + 1);
+                print_push(&stack, node->right, NULL, indent + 2);
+                print_push(&stack, NULL, "To:", indent + 1);
+                print_push(&stack, node->left, NULL, indent + 2);
+                print_push(&stack, NULL, "From:", indent + 1);
+                break;
+            case STMT_LAZY:
+                printf("Lazy: %d tokens from line %d\n", node->lazy_token_count, node->lazy_tokens[0]->line);
+                break;
+            case EXPR_BINARY:
+                printf("BinaryOp: %s\n", node->op->lexeme);
+                print_push(&stack, node->right, NULL, indent + 1);
+                print_push(&stack, node->left, NULL, indent + 1);
+                break;
+            case EXPR_LITERAL:
+                printf("Literal: %d\n", node->value);
+                break;
+            case EXPR_IDENTIFIER:
+                printf("Identifier: %s\n", node->name);
+                break;
+            case EXPR_INDEX:
+                printf("Index: %s\n", node->name);
+                print_push(&stack, node->index, NULL, indent + 1);
+                break;
+            case EXPR_CALL:
+                printf("Call: %s\n", node->name);
+                for (int i = node->arg_count - 1; i >= 0; i--) {
+                    print_push(&stack, node->args[i], NULL, indent + 1);
+                }
+                break;
+        }
     }
+    free(stack.items);
 }
 
-// --- Semantic Analysis Pass (Symbol Registration) ---
-// Walks the AST to register all declarations in the Symbol Table
-static void register_symbols(ASTNode *program, SymbolTable *st) {
-    if (program->type != NODE_PROGRAM) return;
+// --- Command Line ---
+
+typedef struct {
+    const char *source_path;   // Script to run (NULL for the built-in test program)
+    const char *snapshot_path; // --snapshot=FILE: checkpoint the VM here...
+    int snapshot_at;           // --snapshot-at=N: ...after the first N top-level statements
+    const char *restore_path;  // --restore=FILE: resume from a checkpoint
+    int stats;                 // --stats[=json]: 1 for a table, 2 for JSON (on stderr)
+    const char *input_path;    // --input=FILE: numbers for read() and read_all() (default: stdin)
+    int threads;               // --threads=N: run independent statements and parallel for loops on N threads
+    int lazy;                  // --lazy: parse top-level 'if' bodies when they first run
+    int no_inline;             // --no-inline: leave every call out of line
+    const char *record_path;   // --record-profile=FILE: count what the run does, adding to FILE
+    const char *profile_path;  // --use-profile=FILE: compile for the run FILE recorded
+} Options;
+
+static void print_usage(const char *program_name) {
+    fprintf(stderr,
+            "Usage: %s [options] [script.oba]\n"
+            "  --snapshot=FILE     Save VM state to FILE after the first N top-level statements\n"
+            "  --snapshot-at=N     Checkpoint position for --snapshot (default: end of program)\n"
+            "  --restore=FILE      Resume from a snapshot of the same script, skipping its prefix\n"
+            "  --stats[=json]      Report time, memory and hardware counters per phase on stderr\n"
+            "  --input=FILE        Take read() and read_all() input from FILE instead of stdin\n"
+            "  --threads=N         Run independent top-level statements and parallel for\n"
+            "                      iterations on up to N threads\n"
+            "  --lazy              Parse the body of a top-level 'if' only when it first runs\n"
+            "  --no-inline         Do not inline small functions (cannot be used with --lazy)\n"
+            "  --record-profile=FILE\n"
+            "                      Count statements, branches and switch values into FILE\n"
+            "  --use-profile=FILE  Compile for the behaviour recorded in FILE\n"
+            "Without a script, the built-in test program is run.\n",
+            program_name);
+}
 
-    printf("\n--- Semantic Pass: Registering Symbols ---\n");
+// Returns 0 on success, -1 on a bad command line
+static int parse_options(int argc, char **argv, Options *opts) {
+    memset(opts, 0, sizeof(*opts));
+    opts->snapshot_at = -1;
 
-    for (int i = 0; i < program->statement_count; i++) {
-        ASTNode *stmt = program->statements[i];
-        if (stmt->type == STMT_VAR_DECL) {
-            int index = symtab_insert(st, stmt->name);
-            printf("[SYMBOL] Variable '%s' registered at memory index %d\n", stmt->name, index);
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--snapshot=", 11) == 0) {
+            opts->snapshot_path = arg + 11;
+        } else if (strncmp(arg, "--snapshot-at=", 14) == 0) {
+            opts->snapshot_at = atoi(arg + 14);
+            if (opts->snapshot_at < 0) return -1;
+        } else if (strncmp(arg, "--restore=", 10) == 0) {
+            opts->restore_path = arg + 10;
+        } else if (strcmp(arg, "--stats") == 0) {
+            opts->stats = 1;
+        } else if (strcmp(arg, "--stats=json") == 0) {
+            opts->stats = 2;
+        } else if (strncmp(arg, "--input=", 8) == 0) {
+            opts->input_path = arg + 8;
+        } else if (strncmp(arg, "--threads=", 10) == 0) {
+            opts->threads = atoi(arg + 10);
+            if (opts->threads < 1) return -1;
+        } else if (strcmp(arg, "--lazy") == 0) {
+            opts->lazy = 1;
+        } else if (strcmp(arg, "--no-inline") == 0) {
+            opts->no_inline = 1;
+        } else if (strncmp(arg, "--record-profile=", 17) == 0) {
+            opts->record_path = arg + 17;
+        } else if (strncmp(arg, "--use-profile=", 14) == 0) {
+            opts->profile_path = arg + 14;
+        } else if (arg[0] == '-' || opts->source_path) {
+            return -1;
+        } else {
+            opts->source_path = arg;
         }
     }
+    if (opts->snapshot_at >= 0 && !opts->snapshot_path) return -1;
+    if (opts->no_inline && opts->lazy) return -1; // Lazy bodies are analysed with the defaults
+    return 0;
+}
+
+// Creates a profile for the program and adds the counts in 'path' to it. Returns
+// NULL after reporting an error. 'loaded' is set to whether 'path' had counts.
+static Profile* open_profile(const char *path, uint64_t program_hash, int line_count, int *loaded) {
+    Profile *profile = profile_create(program_hash, line_count);
+    if (!profile) {
+        fprintf(stderr, "Error: Could not allocate a profile.\n");
+        return NULL;
+    }
+    int result = profile_load(profile, path);
+    if (result < 0) {
+        fprintf(stderr, "Error: '%s' is not a valid profile.\n", path);
+        profile_free(profile);
+        return NULL;
+    }
+    *loaded = result;
+    return profile;
 }
 
+// Reads a whole file into a NUL-terminated buffer. Returns NULL on error.
+static char* read_source_file(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+
+    size_t capacity = 4096, length = 0;
+    char *buffer = (char*)counted_malloc(capacity);
+    while (buffer) {
+        length += fread(buffer + length, 1, capacity - length - 1, f);
+        if (length < capacity - 1) break;
+        capacity *= 2;
+        char *grown = (char*)counted_realloc(buffer, capacity);
+        if (!grown) free(buffer);
+        buffer = grown;
+    }
+    if (buffer) {
+        if (ferror(f)) {
+            free(buffer);
+            buffer = NULL;
+        } else {
+            buffer[length] = '\0';
+        }
+    }
+    fclose(f);
+    return buffer;
+}
+
+int main(int argc, char **argv) {
+    Options opts;
+    if (parse_options(argc, argv, &opts) != 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    char *file_source = NULL;
+    const char *source = test_source;
+    if (opts.source_path) {
+        file_source = read_source_file(opts.source_path);
+        if (!file_source) {
+            fprintf(stderr, "Error: Could not read '%s'.\n", opts.source_path);
+            return 1;
+        }
+        source = file_source;
+    }
+
+    Stats stats;
+    if (opts.stats) stats_init(&stats);
 
-int main() {
     printf("--- Oba-C Compiler: Front-End ---\n");
 
     // 1. Lexer
-    Lexer *l = lexer_create(test_source);
+    if (opts.stats) stats_begin(&stats);
+    Lexer *l = lexer_create(source);
+    int token_count = 0;
+    Token **tokens = lexer_tokenize(l, &token_count);
+    if (opts.stats) stats_end(&stats, PHASE_LEX);
+
+    if (!tokens) {
+        fprintf(stderr, "Compilation failed during lexing.\n");
+        return 1;
+    }
     
+    // A profile is only used for the script it was recorded on
+    uint64_t program_hash = snapshot_hash_program(source);
+    int line_count = tokens[token_count - 1]->line; // The EOF token's
+    Profile *profile = NULL;
+    if (opts.profile_path) {
+        int loaded = 0;
+        profile = open_profile(opts.profile_path, program_hash, line_count, &loaded);
+        if (!profile) return 1;
+        if (!loaded) {
+            printf("[PROFILE] '%s' has no counts for this script; compiling without it\n", opts.profile_path);
+            profile_free(profile);
+            profile = NULL;
+        }
+    }
+
     // 2. Parser
-    Parser *p = parser_create(l); // This line needs "parser.h"
+    if (opts.stats) stats_begin(&stats);
+    Parser *p = parser_create_from_tokens(tokens, token_count); // This line needs "parser.h"
+    p->lazy = opts.lazy;
+    p->profile = profile;
     ASTNode *program = parse_program(p);
+    if (opts.stats) stats_end(&stats, PHASE_PARSE);
 
-    if (!program) {
+    if (!program || p->error_count > 0) {
         fprintf(stderr, "Compilation failed during parsing.\n");
         return 1;
     }
@@ -102,19 +405,85 @@ int main() {
     ast_print(program, 0);
 
     // 4. Semantic Pass (Symbol Table creation)
+    if (opts.stats) stats_begin(&stats);
     SymbolTable *st = symtab_create();
-    register_symbols(program, st);
+    int semantic_result = semantic_analyze(program, st, SEMANTIC_VERBOSE | (opts.no_inline ? SEMANTIC_NO_INLINE : 0));
+    if (opts.stats) stats_end(&stats, PHASE_SEMANTIC);
+    if (semantic_result != 0) {
+        fprintf(stderr, "Compilation failed during semantic analysis.\n");
+        return 1;
+    }
+    if (profile) {
+        semantic_apply_profile(program, profile, 1);
+        printf("[PROFILE] %d 'if' bodies that never ran left unparsed\n", p->cold_bodies);
+    }
     
     // 5. Code Generation / Execution
+    if (opts.stats) stats_begin(&stats);
     VirtualMachine *vm = vm_create(st);
-    vm_execute_program(vm, program); // Run the program
+    if (!vm) {
+        fprintf(stderr, "Could not create the virtual machine.\n");
+        return 1;
+    }
+    vm->threads = opts.threads > 1 ? opts.threads : 1;
+    if (opts.record_path) {
+        int loaded = 0;
+        vm->profile = open_profile(opts.record_path, program_hash, line_count, &loaded);
+        if (!vm->profile) return 1;
+        vm->threads = 1; // Worker VMs do not record, so a recording run is sequential
+    }
+    vm->input = opts.input_path ? input_open_file(opts.input_path) : input_open_fd(0);
+    if (!vm->input) {
+        fprintf(stderr, "Error: Could not open input '%s'.\n", opts.input_path ? opts.input_path : "stdin");
+        return 1;
+    }
+
+    if (opts.restore_path) {
+        if (snapshot_restore(opts.restore_path, vm, program_hash, program->statement_count) != 0) {
+            fprintf(stderr, "Could not restore '%s'.\n", opts.restore_path);
+            return 1;
+        }
+        printf("\n[SNAPSHOT] Restored '%s', resuming at statement %d\n", opts.restore_path, vm->pc);
+    }
+
+    printf("\n--- Running Oba-C Virtual Machine ---\n");
+    if (opts.snapshot_path) {
+        int at = opts.snapshot_at >= 0 ? opts.snapshot_at : program->statement_count;
+        vm_execute_until(vm, program, at);
+        if (snapshot_save(opts.snapshot_path, vm, program_hash) != 0) return 1;
+        printf("[SNAPSHOT] Saved '%s' at statement %d\n", opts.snapshot_path, vm->pc);
+    }
+    if (opts.threads > 1 && !vm->profile) {
+        vm_execute_parallel(vm, program, opts.threads, 1);
+    } else {
+        vm_execute_program(vm, program); // Run the (rest of the) program
+    }
+    if (opts.stats) stats_end(&stats, PHASE_EXECUTE);
+    printf("--- Execution Complete ---\n");
+    if (vm->profile) {
+        if (profile_save(vm->profile, opts.record_path) != 0) return 1;
+        printf("[PROFILE] Saved '%s'\n", opts.record_path);
+    }
+
+    if (opts.stats) {
+        fflush(stdout);
+        stats.token_count = token_count;
+        stats.node_count = ast_node_count(program);
+        stats_report(&stats, stderr, opts.stats == 2);
+        stats_close(&stats);
+    }
     
     // 6. Cleanup
     ast_node_free(program);
+    input_close(vm->input);
+    profile_free(vm->profile);
+    profile_free(profile);
     vm_destroy(vm);
     symtab_destroy(st);
     parser_destroy(p);
     lexer_destroy(l); 
+    free(tokens);
+    free(file_source);
    
     return 0;
-}
\ No newline at end of file
+}
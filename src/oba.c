@@ -0,0 +1,364 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "oba.h"
+#include "oba_internal.h"
+#include "lexer.h"
+#include "parser.h"
+#include "semantic.h"
+#include "input.h"
+#include "alloc.h"
+
+// --- Compilation ---
+
+static void set_error(char *error, size_t error_size, const char *message) {
+    if (error && error_size > 0) {
+        snprintf(error, error_size, "%s", message);
+    }
+}
+
+ObaProgram* oba_compile(const char *source, char *error, size_t error_size) {
+    ObaProgram *program = (ObaProgram*)counted_calloc(1, sizeof(ObaProgram));
+    if (!program) {
+        set_error(error, error_size, "out of memory");
+        return NULL;
+    }
+
+    Lexer *l = lexer_create(source);
+    program->tokens = l ? lexer_tokenize(l, &program->token_count) : NULL;
+    lexer_destroy(l);
+    if (!program->tokens) {
+        set_error(error, error_size, "out of memory");
+        oba_program_free(program);
+        return NULL;
+    }
+
+    Parser *p = parser_create_from_tokens(program->tokens, program->token_count);
+    program->ast = parse_program(p);
+    int syntax_errors = p->error_count;
+    parser_destroy(p);
+    if (!program->ast || syntax_errors > 0) {
+        set_error(error, error_size, "syntax error");
+        oba_program_free(program);
+        return NULL;
+    }
+
+    program->symtab = symtab_create();
+    if (!program->symtab || semantic_analyze(program->ast, program->symtab, 0) != 0) {
+        set_error(error, error_size, "semantic error");
+        oba_program_free(program);
+        return NULL;
+    }
+    return program;
+}
+
+void oba_program_free(ObaProgram *program) {
+    if (!program) return;
+
+    ast_node_free(program->ast);
+    symtab_destroy(program->symtab);
+    for (int i = 0; program->tokens && i < program->token_count; i++) {
+        token_free(program->tokens[i]);
+    }
+    free(program->tokens);
+    free(program);
+}
+
+// --- Contexts ---
+
+// Default output sink: remember printed values for oba_context_output
+static void collect_output(void *user_data, int value) {
+    ObaContext *ctx = (ObaContext*)user_data;
+    if (ctx->output_count == ctx->output_capacity) {
+        int capacity = ctx->output_capacity ? ctx->output_capacity * 2 : 16;
+        int *grown = (int*)counted_realloc(ctx->output, capacity * sizeof(int));
+        if (!grown) return; // Drop the value rather than fail the run
+        ctx->output = grown;
+        ctx->output_capacity = capacity;
+    }
+    ctx->output[ctx->output_count++] = value;
+}
+
+// Wraps a new VM for 'program' in a context, or frees it if out of memory
+static ObaContext* context_create(const ObaProgram *program, VirtualMachine *vm) {
+    if (!vm) return NULL;
+    ObaContext *ctx = (ObaContext*)counted_calloc(1, sizeof(ObaContext));
+    if (!ctx) {
+        vm_destroy(vm);
+        return NULL;
+    }
+
+    ctx->program = program;
+    ctx->vm = vm;
+    ctx->vm->trace = 0;
+    oba_context_set_output(ctx, NULL, NULL);
+    return ctx;
+}
+
+ObaContext* oba_context_create(const ObaProgram *program) {
+    return context_create(program, vm_create(program->symtab));
+}
+
+// Drops the reactive record; the variables keep their current values
+static void leave_reactive(ObaContext *ctx) {
+    reactive_free(ctx->reactive);
+    ctx->reactive = NULL;
+    ctx->recomputed = 0;
+}
+
+void oba_context_free(ObaContext *ctx) {
+    if (!ctx) return;
+    leave_reactive(ctx);
+    input_close(ctx->vm->input);
+    vm_destroy(ctx->vm);
+    free(ctx->output);
+    free(ctx);
+}
+
+void oba_context_reset(ObaContext *ctx) {
+    leave_reactive(ctx);
+    vm_reset(ctx->vm);
+    ctx->output_count = 0;
+    ctx->vm->error_message[0] = '\0';
+}
+
+void oba_context_set_output(ObaContext *ctx, ObaOutputFn fn, void *user_data) {
+    if (fn) {
+        ctx->vm->output = fn;
+        ctx->vm->output_data = user_data;
+    } else {
+        ctx->vm->output = collect_output;
+        ctx->vm->output_data = ctx;
+    }
+}
+
+const int* oba_context_output(const ObaContext *ctx, int *count) {
+    *count = ctx->output_count;
+    return ctx->output;
+}
+
+const char* oba_context_error(const ObaContext *ctx) {
+    return ctx->vm->error_message;
+}
+
+// --- Inputs and Results ---
+
+// Returns the named global if it exists and is (or is not) an array, else NULL
+static Symbol* find_global(const ObaContext *ctx, const char *name, int want_array) {
+    SymbolTable *st = ctx->program->symtab;
+    int index = symtab_lookup(st, name);
+    if (index == -1) return NULL;
+
+    Symbol *s = &st->symbols[index];
+    if ((s->size > 0) != (want_array != 0)) return NULL;
+    return s;
+}
+
+int oba_set(ObaContext *ctx, const char *name, int value) {
+    Symbol *s = find_global(ctx, name, 0);
+    if (!s) return -1;
+    leave_reactive(ctx);
+    ctx->vm->memory[s->stack_index] = value;
+    return 0;
+}
+
+int oba_get(const ObaContext *ctx, const char *name, int *value) {
+    Symbol *s = find_global(ctx, name, 0);
+    if (!s) return -1;
+    *value = ctx->vm->memory[s->stack_index];
+    return 0;
+}
+
+int oba_set_array(ObaContext *ctx, const char *name, const int *values, int count) {
+    Symbol *s = find_global(ctx, name, 1);
+    if (!s || count < 0) return -1;
+    if (count > s->size) count = s->size;
+    leave_reactive(ctx);
+    memcpy(&ctx->vm->memory[s->offset], values, (size_t)count * sizeof(int));
+    return 0;
+}
+
+int oba_get_array(const ObaContext *ctx, const char *name, int *values, int count) {
+    Symbol *s = find_global(ctx, name, 1);
+    if (!s || count < 0) return -1;
+    if (count > s->size) count = s->size;
+    memcpy(values, &ctx->vm->memory[s->offset], (size_t)count * sizeof(int));
+    return 0;
+}
+
+// --- Input ---
+
+static int replace_input(ObaContext *ctx, InputReader *in) {
+    if (!in) return -1;
+    input_close(ctx->vm->input);
+    ctx->vm->input = in;
+    return 0;
+}
+
+int oba_context_set_input(ObaContext *ctx, const char *data, size_t size) {
+    return replace_input(ctx, input_open_memory(data, size));
+}
+
+int oba_context_set_input_file(ObaContext *ctx, const char *path) {
+    return replace_input(ctx, input_open_file(path));
+}
+
+// --- Execution ---
+
+// Runs top-level statements from 'start' up to 'end' with an empty call stack,
+// keeping the variables as injected
+static int run_statements(const ObaProgram *program, ObaContext *ctx, int start, int end) {
+    VirtualMachine *vm = ctx->vm;
+    if (ctx->program != program) {
+        snprintf(vm->error_message, sizeof(vm->error_message), "Context belongs to a different program.");
+        return -1;
+    }
+
+    leave_reactive(ctx);
+    vm->pc = start;
+    vm_unwind(vm);
+    vm->error_message[0] = '\0';
+    ctx->output_count = 0;
+
+    if (setjmp(vm->error_jump)) {
+        vm->error_jump_set = 0;
+        return -1;
+    }
+    vm->error_jump_set = 1;
+    vm_execute_until(vm, program->ast, end);
+    vm->error_jump_set = 0;
+    return 0;
+}
+
+int oba_run(const ObaProgram *program, ObaContext *ctx) {
+    return run_statements(program, ctx, 0, program->ast->statement_count);
+}
+
+int oba_run_prefix(const ObaProgram *program, ObaContext *ctx, int count) {
+    return run_statements(program, ctx, 0, count < 0 ? 0 : count);
+}
+
+int oba_resume(const ObaProgram *program, ObaContext *ctx) {
+    return run_statements(program, ctx, ctx->vm->pc, program->ast->statement_count);
+}
+
+// The VM's out-of-fuel callback for oba_context_set_fuel
+static int context_refuel(void *user_data) {
+    ObaContext *ctx = (ObaContext*)user_data;
+    long long grant = ctx->fuel_fn(ctx->fuel_data);
+    if (grant <= 0) return -1;
+    ctx->vm->fuel = grant - 1; // The statement that ran out is paid from the new allowance
+    return 0;
+}
+
+void oba_context_set_fuel(ObaContext *ctx, long long first, ObaFuelFn fn, void *user_data) {
+    ctx->fuel_fn = fn;
+    ctx->fuel_data = user_data;
+    ctx->vm->out_of_fuel = fn ? context_refuel : NULL;
+    ctx->vm->fuel_data = fn ? ctx : NULL;
+    ctx->vm->fuel = fn ? first : VM_FUEL_UNLIMITED;
+}
+
+// --- Forking ---
+
+ObaBase* oba_base_create(const ObaContext *ctx) {
+    ObaBase *base = (ObaBase*)counted_malloc(sizeof(ObaBase));
+    if (!base) return NULL;
+    base->program = ctx->program;
+    base->image = vm_image_create(ctx->vm);
+    if (!base->image) {
+        free(base);
+        return NULL;
+    }
+    return base;
+}
+
+void oba_base_free(ObaBase *base) {
+    if (!base) return;
+    vm_image_free(base->image);
+    free(base);
+}
+
+ObaContext* oba_context_fork(const ObaBase *base) {
+    return context_create(base->program, vm_fork(base->image, base->program->symtab));
+}
+
+// --- Reactive Mode ---
+
+// Runs a full recorded run ('symbol' < 0) or an update for 'symbol', catching
+// runtime errors like oba_run. An error ends reactive mode.
+static int run_reactive(ObaContext *ctx, int symbol) {
+    VirtualMachine *vm = ctx->vm;
+    VMOutputFn output = vm->output;
+    void *output_data = vm->output_data;
+    vm_unwind(vm);
+    vm->error_message[0] = '\0';
+
+    int status = 0;
+    if (setjmp(vm->error_jump)) {
+        vm->error_jump_set = 0;
+        leave_reactive(ctx);
+        status = -1;
+    } else {
+        vm->error_jump_set = 1;
+        if (symbol < 0) reactive_run(ctx->reactive);
+        else ctx->recomputed = reactive_update(ctx->reactive, symbol);
+        vm->error_jump_set = 0;
+    }
+    vm->output = output;
+    vm->output_data = output_data;
+    return status;
+}
+
+int oba_reactive_run(const ObaProgram *program, ObaContext *ctx) {
+    VirtualMachine *vm = ctx->vm;
+    if (ctx->program != program) {
+        snprintf(vm->error_message, sizeof(vm->error_message), "Context belongs to a different program.");
+        return -1;
+    }
+    leave_reactive(ctx);
+
+    const char *error;
+    ctx->reactive = reactive_create(vm, program->ast, &error);
+    if (!ctx->reactive) {
+        snprintf(vm->error_message, sizeof(vm->error_message), "%s", error);
+        return -1;
+    }
+    vm->pc = program->ast->statement_count;
+    return run_reactive(ctx, -1);
+}
+
+// Checks that 'ctx' is in reactive mode, setting the error message if not
+static int require_reactive(ObaContext *ctx) {
+    if (ctx->reactive) return 0;
+    snprintf(ctx->vm->error_message, sizeof(ctx->vm->error_message),
+             "Not in reactive mode; call oba_reactive_run first.");
+    return -1;
+}
+
+int oba_reactive_set(ObaContext *ctx, const char *name, int value) {
+    Symbol *s = find_global(ctx, name, 0);
+    if (!s || require_reactive(ctx) != 0) return -1;
+    ctx->vm->memory[s->stack_index] = value;
+    return run_reactive(ctx, symtab_lookup(ctx->program->symtab, name));
+}
+
+int oba_reactive_set_array(ObaContext *ctx, const char *name, const int *values, int count) {
+    Symbol *s = find_global(ctx, name, 1);
+    if (!s || count < 0 || require_reactive(ctx) != 0) return -1;
+    if (count > s->size) count = s->size;
+    memcpy(&ctx->vm->memory[s->offset], values, (size_t)count * sizeof(int));
+    return run_reactive(ctx, symtab_lookup(ctx->program->symtab, name));
+}
+
+const int* oba_reactive_output(ObaContext *ctx, int *count) {
+    if (!ctx->reactive) {
+        *count = 0;
+        return NULL;
+    }
+    return reactive_output(ctx->reactive, count);
+}
+
+int oba_reactive_recomputed(const ObaContext *ctx) {
+    return ctx->recomputed;
+}
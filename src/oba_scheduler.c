@@ -0,0 +1,317 @@
+#define _DEFAULT_SOURCE // For MAP_ANONYMOUS and MAP_NORESERVE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "oba.h"
+#include "oba_internal.h"
+#include "alloc.h"
+
+// Each run is a green thread: a ucontext with its own C stack, started with
+// oba_run and suspended from the VM's out-of-fuel callback. The VM keeps all
+// of its state in the VirtualMachine or on that stack and nothing in
+// thread-locals, so a suspended run can be resumed by any worker.
+
+// C stack reserved per running context. It is mapped on demand, so only the
+// pages a run actually touches (deep recursion) use memory.
+#define TASK_STACK_SIZE (8 * 1024 * 1024)
+
+typedef struct ObaTask {
+    const ObaProgram *program;
+    ObaContext *ctx;
+
+    int priority;
+    long long quantum;
+    long long budget;   // 0 for no limit
+    long long spent;    // Fuel handed out so far
+    unsigned long long turn; // Queue position: lower runs sooner among equal priorities
+
+    ucontext_t context;
+    ucontext_t *worker; // The worker running this task right now, to switch back to
+    char *stack;        // NULL until the first turn, and again once finished
+    int finished;
+    int result;         // oba_run's return value
+} ObaTask;
+
+struct ObaScheduler {
+    int thread_count;
+    ObaSchedulePolicy policy;
+
+    // Every task added since the last run, in order (they are freed after it)
+    ObaTask **tasks;
+    int task_count;
+    int task_capacity;
+
+    // Ready queue: a binary heap ordered by runs_before, guarded by 'lock'
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    ObaTask **heap;
+    int heap_count;
+    int unfinished;
+    unsigned long long next_turn;
+};
+
+// --- Ready Queue ---
+
+// Returns 1 if 'a' should run before 'b'
+static int runs_before(const ObaScheduler *s, const ObaTask *a, const ObaTask *b) {
+    if (s->policy == OBA_SCHEDULE_PRIORITY && a->priority != b->priority) {
+        return a->priority > b->priority;
+    }
+    return a->turn < b->turn;
+}
+
+// The heap has room for every task, so these never allocate. Both need 'lock'.
+static void queue_push(ObaScheduler *s, ObaTask *task) {
+    task->turn = s->next_turn++;
+
+    int i = s->heap_count++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!runs_before(s, task, s->heap[parent])) break;
+        s->heap[i] = s->heap[parent];
+        i = parent;
+    }
+    s->heap[i] = task;
+}
+
+static ObaTask* queue_pop(ObaScheduler *s) {
+    ObaTask *top = s->heap[0];
+    ObaTask *last = s->heap[--s->heap_count];
+
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= s->heap_count) break;
+        if (child + 1 < s->heap_count && runs_before(s, s->heap[child + 1], s->heap[child])) child++;
+        if (!runs_before(s, s->heap[child], last)) break;
+        s->heap[i] = s->heap[child];
+        i = child;
+    }
+    if (s->heap_count > 0) s->heap[i] = last;
+    return top;
+}
+
+// --- Green Threads ---
+
+// Hands the task its next slice of fuel, capped by what is left of its budget.
+// Returns 0, or -1 if the budget is used up.
+static int task_refuel(ObaTask *task) {
+    long long grant = task->quantum;
+    if (task->budget > 0) {
+        if (task->spent >= task->budget) return -1;
+        if (grant > task->budget - task->spent) grant = task->budget - task->spent;
+    }
+    task->spent += grant;
+    task->ctx->vm->fuel = grant;
+    return 0;
+}
+
+// The VM's out-of-fuel callback: give up the worker until the next turn
+static int task_yield(void *user_data) {
+    ObaTask *task = (ObaTask*)user_data;
+    if (task_refuel(task) != 0) return -1;
+    task->ctx->vm->fuel--; // The statement that ran out is paid from the new slice
+
+    swapcontext(&task->context, task->worker);
+    return 0;
+}
+
+// makecontext only passes ints, so the task pointer arrives in two halves
+static void task_main(unsigned int high, unsigned int low) {
+    ObaTask *task = (ObaTask*)(((uintptr_t)high << 16 << 16) | (uintptr_t)low);
+    VirtualMachine *vm = task->ctx->vm;
+
+    vm->out_of_fuel = task_yield;
+    vm->fuel_data = task;
+    task_refuel(task);
+    task->result = oba_run(task->program, task->ctx);
+
+    // Leave the context as a plain oba_run would find it
+    vm->out_of_fuel = NULL;
+    vm->fuel_data = NULL;
+    vm->fuel = VM_FUEL_UNLIMITED;
+
+    task->finished = 1;
+    setcontext(task->worker); // The worker frees this stack
+}
+
+// Prepares a task's first turn. Returns 0, or -1 if no stack could be mapped.
+static int task_start(ObaTask *task) {
+    void *stack = mmap(NULL, TASK_STACK_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (stack == MAP_FAILED) return -1;
+    // A guard page at the low end turns a C stack overflow into a fault
+    mprotect(stack, (size_t)sysconf(_SC_PAGESIZE), PROT_NONE);
+    task->stack = (char*)stack;
+
+    getcontext(&task->context);
+    task->context.uc_stack.ss_sp = task->stack;
+    task->context.uc_stack.ss_size = TASK_STACK_SIZE;
+    task->context.uc_link = NULL;
+
+    uintptr_t address = (uintptr_t)task;
+    makecontext(&task->context, (void (*)(void))task_main, 2,
+                (unsigned int)(address >> 16 >> 16), (unsigned int)(address & 0xFFFFFFFFu));
+    return 0;
+}
+
+static void task_release_stack(ObaTask *task) {
+    if (task->stack) munmap(task->stack, TASK_STACK_SIZE);
+    task->stack = NULL;
+}
+
+// --- Workers ---
+
+// Runs one turn of 'task' on the calling thread. Returns 1 once the task has finished.
+static int worker_run_turn(ObaTask *task, ucontext_t *worker) {
+    if (!task->stack && task_start(task) != 0) {
+        snprintf(task->ctx->vm->error_message, sizeof(task->ctx->vm->error_message),
+                 "Could not allocate a stack for the run.");
+        task->result = -1;
+        return 1;
+    }
+
+    task->worker = worker;
+    swapcontext(worker, &task->context);
+
+    if (!task->finished) return 0;
+    task_release_stack(task);
+    return 1;
+}
+
+static void* worker_main(void *arg) {
+    ObaScheduler *s = (ObaScheduler*)arg;
+    ucontext_t worker;
+
+    pthread_mutex_lock(&s->lock);
+    for (;;) {
+        while (s->heap_count == 0 && s->unfinished > 0) {
+            pthread_cond_wait(&s->ready, &s->lock);
+        }
+        if (s->unfinished == 0) break;
+
+        ObaTask *task = queue_pop(s);
+        pthread_mutex_unlock(&s->lock);
+        int finished = worker_run_turn(task, &worker);
+        pthread_mutex_lock(&s->lock);
+
+        if (finished) {
+            // The last one out wakes everyone so they can exit
+            if (--s->unfinished == 0) pthread_cond_broadcast(&s->ready);
+        } else {
+            queue_push(s, task);
+            pthread_cond_signal(&s->ready);
+        }
+    }
+    pthread_mutex_unlock(&s->lock);
+    return NULL;
+}
+
+// --- Public API ---
+
+ObaScheduler* oba_scheduler_create(int threads, ObaSchedulePolicy policy) {
+    if (threads < 1) return NULL;
+
+    ObaScheduler *s = (ObaScheduler*)counted_calloc(1, sizeof(ObaScheduler));
+    if (!s) return NULL;
+    s->thread_count = threads;
+    s->policy = policy;
+
+    if (pthread_mutex_init(&s->lock, NULL) != 0) {
+        free(s);
+        return NULL;
+    }
+    if (pthread_cond_init(&s->ready, NULL) != 0) {
+        pthread_mutex_destroy(&s->lock);
+        free(s);
+        return NULL;
+    }
+    return s;
+}
+
+static void free_tasks(ObaScheduler *s) {
+    for (int i = 0; i < s->task_count; i++) {
+        task_release_stack(s->tasks[i]);
+        free(s->tasks[i]);
+    }
+    s->task_count = 0;
+}
+
+void oba_scheduler_free(ObaScheduler *scheduler) {
+    if (!scheduler) return;
+    free_tasks(scheduler);
+    free(scheduler->tasks);
+    free(scheduler->heap);
+    pthread_cond_destroy(&scheduler->ready);
+    pthread_mutex_destroy(&scheduler->lock);
+    free(scheduler);
+}
+
+int oba_scheduler_add(ObaScheduler *scheduler, const ObaProgram *program, ObaContext *ctx,
+                      const ObaTaskOptions *options) {
+    if (ctx->program != program) return -1;
+
+    ObaScheduler *s = scheduler;
+    if (s->task_count == s->task_capacity) {
+        int capacity = s->task_capacity ? s->task_capacity * 2 : 64;
+        ObaTask **tasks = (ObaTask**)counted_realloc(s->tasks, capacity * sizeof(ObaTask*));
+        if (!tasks) return -1;
+        s->tasks = tasks;
+        ObaTask **heap = (ObaTask**)counted_realloc(s->heap, capacity * sizeof(ObaTask*));
+        if (!heap) return -1;
+        s->heap = heap;
+        s->task_capacity = capacity;
+    }
+
+    ObaTask *task = (ObaTask*)counted_calloc(1, sizeof(ObaTask));
+    if (!task) return -1;
+    task->program = program;
+    task->ctx = ctx;
+    task->quantum = OBA_DEFAULT_QUANTUM;
+    if (options) {
+        task->priority = options->priority;
+        if (options->quantum > 0) task->quantum = options->quantum;
+        if (options->budget > 0) task->budget = options->budget;
+    }
+    s->tasks[s->task_count++] = task;
+    return 0;
+}
+
+int oba_scheduler_run(ObaScheduler *scheduler) {
+    ObaScheduler *s = scheduler;
+
+    // Queue in the order added, so round-robin starts with the first one
+    s->heap_count = 0;
+    s->next_turn = 0;
+    for (int i = 0; i < s->task_count; i++) {
+        queue_push(s, s->tasks[i]);
+    }
+    s->unfinished = s->task_count;
+
+    // The calling thread is one of the workers
+    pthread_t *threads = NULL;
+    int started = 0;
+    if (s->thread_count > 1) {
+        threads = (pthread_t*)counted_malloc((size_t)(s->thread_count - 1) * sizeof(pthread_t));
+    }
+    while (threads && started < s->thread_count - 1 &&
+           pthread_create(&threads[started], NULL, worker_main, s) == 0) {
+        started++;
+    }
+    worker_main(s);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    int failed = 0;
+    for (int i = 0; i < s->task_count; i++) {
+        if (s->tasks[i]->result != 0) failed++;
+    }
+    free_tasks(s);
+    return failed;
+}
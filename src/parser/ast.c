@@ -2,28 +2,38 @@
 #include <stdio.h>
 #include <string.h>
 #include "ast.h"
+#include "alloc.h"
 
 // Creates a new, blank AST Node
 ASTNode* ast_node_create(ASTNodeType type) {
-    ASTNode *node = (ASTNode*)calloc(1, sizeof(ASTNode));
+    ASTNode *node = (ASTNode*)counted_calloc(1, sizeof(ASTNode));
     if (!node) {
         fprintf(stderr, "Error: Could not allocate memory for AST node.\n");
         exit(1);
     }
     node->type = type;
+
+    if (type == STMT_SWITCH) {
+        node->switch_table = (SwitchTable*)counted_calloc(1, sizeof(SwitchTable));
+        if (!node->switch_table) {
+            fprintf(stderr, "Error: Could not allocate memory for AST node.\n");
+            exit(1);
+        }
+        node->switch_table->default_target = -1;
+    }
     return node;
 }
 
 // Helper to add a statement to a program node's dynamic array
 void ast_program_add_statement(ASTNode *program, ASTNode *statement) {
-    if (program->type != NODE_PROGRAM) {
+    if (program->type != NODE_PROGRAM && program->type != STMT_BLOCK && program->type != STMT_SWITCH) {
         fprintf(stderr, "Error: Attempted to add statement to non-program node.\n");
         return;
     }
 
     // Increase the size of the statements array
     program->statement_count++;
-    program->statements = (ASTNode**)realloc(program->statements, 
+    program->statements = (ASTNode**)counted_realloc(program->statements, 
                                              program->statement_count * sizeof(ASTNode*));
     if (!program->statements) {
         fprintf(stderr, "Error: Could not reallocate memory for statements.\n");
@@ -34,52 +44,194 @@ void ast_program_add_statement(ASTNode *program, ASTNode *statement) {
     program->statements[program->statement_count - 1] = statement;
 }
 
-// Recursively frees an AST node and its children
-void ast_node_free(ASTNode *node) {
+// Helper to add an argument to a call node's dynamic array
+void ast_call_add_argument(ASTNode *call, ASTNode *argument) {
+    if (call->type != EXPR_CALL) {
+        fprintf(stderr, "Error: Attempted to add argument to non-call node.\n");
+        return;
+    }
+
+    call->arg_count++;
+    call->args = (ASTNode**)counted_realloc(call->args, call->arg_count * sizeof(ASTNode*));
+    if (!call->args) {
+        fprintf(stderr, "Error: Could not reallocate memory for call arguments.\n");
+        exit(1);
+    }
+
+    call->args[call->arg_count - 1] = argument;
+}
+
+// Helper to add a parameter name to a function declaration
+void ast_function_add_param(ASTNode *function, const char *name) {
+    function->param_count++;
+    function->params = (char**)counted_realloc(function->params, function->param_count * sizeof(char*));
+    if (!function->params) {
+        fprintf(stderr, "Error: Could not reallocate memory for parameters.\n");
+        exit(1);
+    }
+
+    function->params[function->param_count - 1] = counted_strdup(name);
+}
+
+// Helper to add a 'case value:' label that runs the switch body at index 'target'
+void ast_switch_add_case(ASTNode *node, int value, int target) {
+    SwitchTable *table = node->switch_table;
+
+    table->count++;
+    table->cases = (SwitchCase*)counted_realloc(table->cases, table->count * sizeof(SwitchCase));
+    if (!table->cases) {
+        fprintf(stderr, "Error: Could not reallocate memory for case labels.\n");
+        exit(1);
+    }
+
+    table->cases[table->count - 1].value = value;
+    table->cases[table->count - 1].target = target;
+}
+
+// Helper to add a reduction clause, e.g. sum(total), to a parallel for
+void ast_loop_add_reduction(ASTNode *loop, BuiltinType kind, const char *name) {
+    loop->reduction_count++;
+    loop->reductions = (LoopReduction*)counted_realloc(loop->reductions, loop->reduction_count * sizeof(LoopReduction));
+    if (!loop->reductions) {
+        fprintf(stderr, "Error: Could not reallocate memory for reductions.\n");
+        exit(1);
+    }
+
+    LoopReduction *reduction = &loop->reductions[loop->reduction_count - 1];
+    reduction->kind = kind;
+    reduction->name = counted_strdup(name);
+    reduction->slot = -1;
+}
+
+// --- Node Stacks ---
+
+void ast_stack_push(ASTNodeStack *stack, ASTNode *node) {
     if (!node) return;
 
-    switch (node->type) {
-        case NODE_PROGRAM:
-            for (int i = 0; i < node->statement_count; i++) {
-                ast_node_free(node->statements[i]);
-            }
-            free(node->statements);
-            break;
-
-        case STMT_VAR_DECL:
-            free(node->name);
-            break;
-
-        case STMT_ASSIGN:
-            free(node->name);
-            ast_node_free(node->expression);
-            break;
-
-        case STMT_PRINT:
-            ast_node_free(node->print_expr);
-            break;
-            
-        case STMT_IF:
-            ast_node_free(node->condition);
-            ast_node_free(node->body);
-            break;
-
-        case EXPR_BINARY:
-            ast_node_free(node->left);
-            ast_node_free(node->right);
-            // We don't free the token here, as the parser might reuse it
-            // or the lexer will free it. Let's assume tokens are managed elsewhere for now.
-            break;
-
-        case EXPR_LITERAL:
-            // No dynamic memory to free (value is inline)
-            break;
-            
-        case EXPR_IDENTIFIER:
-            free(node->name);
-            break;
+    if (stack->count == stack->capacity) {
+        int capacity = stack->capacity ? stack->capacity * 2 : 64;
+        ASTNode **grown = (ASTNode**)counted_realloc(stack->items, capacity * sizeof(ASTNode*));
+        if (!grown) {
+            fprintf(stderr, "Error: Could not reallocate memory for AST traversal.\n");
+            exit(1);
+        }
+        stack->items = grown;
+        stack->capacity = capacity;
     }
-    
-    // Finally, free the node itself
-    free(node);
-}
\ No newline at end of file
+    stack->items[stack->count++] = node;
+}
+
+ASTNode* ast_stack_pop(ASTNodeStack *stack) {
+    return stack->count > 0 ? stack->items[--stack->count] : NULL;
+}
+
+// Pushes every child of 'node' so that they pop in source order
+void ast_stack_push_children(ASTNodeStack *stack, ASTNode *node) {
+    ast_stack_push(stack, node->right);
+    ast_stack_push(stack, node->left);
+    ast_stack_push(stack, node->body);
+    ast_stack_push(stack, node->condition);
+    ast_stack_push(stack, node->print_expr);
+    ast_stack_push(stack, node->expression);
+    ast_stack_push(stack, node->index);
+    for (int i = node->arg_count - 1; i >= 0; i--) {
+        ast_stack_push(stack, node->args[i]);
+    }
+    for (int i = node->statement_count - 1; i >= 0; i--) {
+        ast_stack_push(stack, node->statements[i]);
+    }
+}
+
+void ast_stack_free(ASTNodeStack *stack) {
+    free(stack->items);
+    stack->items = NULL;
+    stack->count = stack->capacity = 0;
+}
+
+// --- Whole-Tree Operations ---
+// These walk with an explicit stack, so arbitrarily deep expressions
+// (e.g. machine-generated ones) cannot overflow the C stack.
+
+// Copies one expression node. Its children still point into the original tree
+// until ast_node_clone replaces them.
+static ASTNode* clone_one(const ASTNode *node) {
+    ASTNode *copy = ast_node_create(node->type);
+    *copy = *node; // Scalars, resolved slots and the (shared) operator token
+
+    if (node->name) copy->name = counted_strdup(node->name);
+    if (node->type == EXPR_CALL && node->arg_count > 0) {
+        copy->args = (ASTNode**)counted_malloc(node->arg_count * sizeof(ASTNode*));
+        if (!copy->args) {
+            fprintf(stderr, "Error: Could not allocate memory for call arguments.\n");
+            exit(1);
+        }
+        memcpy(copy->args, node->args, node->arg_count * sizeof(ASTNode*));
+    }
+    return copy;
+}
+
+// Copies an expression node and its children
+ASTNode* ast_node_clone(const ASTNode *node) {
+    if (!node) return NULL;
+
+    ASTNode *root = clone_one(node);
+    ASTNodeStack pending = {0};
+    ast_stack_push(&pending, root);
+
+    ASTNode *copy;
+    while ((copy = ast_stack_pop(&pending)) != NULL) {
+        if (copy->index) ast_stack_push(&pending, copy->index = clone_one(copy->index));
+        if (copy->left) ast_stack_push(&pending, copy->left = clone_one(copy->left));
+        if (copy->right) ast_stack_push(&pending, copy->right = clone_one(copy->right));
+        for (int i = 0; i < copy->arg_count; i++) {
+            ast_stack_push(&pending, copy->args[i] = clone_one(copy->args[i]));
+        }
+    }
+    ast_stack_free(&pending);
+    return root;
+}
+
+// Counts a node and everything below it
+int ast_node_count(const ASTNode *node) {
+    int count = 0;
+    ASTNodeStack pending = {0};
+    ast_stack_push(&pending, (ASTNode*)node);
+
+    ASTNode *current;
+    while ((current = ast_stack_pop(&pending)) != NULL) {
+        count++;
+        ast_stack_push_children(&pending, current);
+    }
+    ast_stack_free(&pending);
+    return count;
+}
+
+// Frees an AST node and everything below it
+void ast_node_free(ASTNode *node) {
+    ASTNodeStack pending = {0};
+    ast_stack_push(&pending, node);
+
+    while ((node = ast_stack_pop(&pending)) != NULL) {
+        ast_stack_push_children(&pending, node);
+
+        // Operator tokens belong to the token array, which the caller frees
+        free(node->name);
+        free(node->statements);
+        free(node->args);
+        for (int i = 0; i < node->param_count; i++) {
+            free(node->params[i]);
+        }
+        free(node->params);
+        for (int i = 0; i < node->reduction_count; i++) {
+            free(node->reductions[i].name);
+        }
+        free(node->reductions);
+        if (node->switch_table) {
+            free(node->switch_table->cases);
+            free(node->switch_table->jump_table);
+            free(node->switch_table);
+        }
+        free(node);
+    }
+    ast_stack_free(&pending);
+}
@@ -1,24 +1,32 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include "parser.h" // <-- This MUST be here to define Parser
 #include "ast.h"    // <-- This MUST be here to define ASTNode
+#include "input.h"  // Decimal literal parsing
+#include "symtab.h" // MAX_ARRAY_SIZE
+#include "alloc.h"
 
 // --- Private Function Prototypes (for our grammar) ---
 static ASTNode* parse_statement(Parser *p);
 static ASTNode* parse_var_decl_statement(Parser *p);
 static ASTNode* parse_assign_statement(Parser *p, Token* identifier_token);
+static ASTNode* parse_expression_statement(Parser *p);
 static ASTNode* parse_print_statement(Parser *p);
 static ASTNode* parse_if_statement(Parser *p);
+static ASTNode* parse_block_statement(Parser *p);
+static ASTNode* parse_return_statement(Parser *p);
+static ASTNode* parse_function_decl(Parser *p, const char *name);
 
+static ASTNode* parse_switch_statement(Parser *p);
+static ASTNode* parse_parallel_for(Parser *p);
 static ASTNode* parse_expression(Parser *p);
-static ASTNode* parse_term(Parser *p);
-static ASTNode* parse_factor(Parser *p);
 
 // --- Core Parser Functions ---
 
 Parser* parser_create(Lexer *l) {
-    Parser *p = (Parser*)calloc(1, sizeof(Parser));
+    Parser *p = (Parser*)counted_calloc(1, sizeof(Parser));
     p->lexer = l;
 
     // Initialize by loading two tokens (current and peek)
@@ -28,15 +36,42 @@ Parser* parser_create(Lexer *l) {
     return p;
 }
 
+Parser* parser_create_from_tokens(Token **tokens, int count) {
+    Parser *p = (Parser*)counted_calloc(1, sizeof(Parser));
+    p->tokens = tokens;
+    p->token_count = count;
+
+    parser_next_token(p);
+    parser_next_token(p);
+
+    return p;
+}
+
 void parser_destroy(Parser *p) {
     // Note: We don't free the lexer here, as it was created externally.
+    ast_stack_free(&p->operands);
+    free(p->frames);
     free(p);
 }
 
 // Advances the token stream
 void parser_next_token(Parser *p) {
     p->current_token = p->peek_token;
-    p->peek_token = lexer_next_token(p->lexer);
+    if (p->tokens) {
+        p->current_position = p->token_position - 1; // Where the old peek_token came from
+        // Stay on the final EOF token once the array is used up
+        int i = p->token_position < p->token_count ? p->token_position++ : p->token_count - 1;
+        p->peek_token = p->tokens[i];
+    } else {
+        p->peek_token = lexer_next_token(p->lexer);
+    }
+}
+
+// Moves back (or forward) so that current_token is tokens[position]
+static void parser_seek(Parser *p, int position) {
+    p->token_position = position;
+    parser_next_token(p);
+    parser_next_token(p);
 }
 
 // Helper to check and consume the next token if it matches
@@ -46,6 +81,7 @@ static int expect_peek(Parser *p, TokenType type) {
         return 1;
     } else {
         // Simple error handling
+        p->error_count++;
         fprintf(stderr, "Parser Error (Line %d): Expected token %s, got %s\n",
                 p->peek_token->line, 
                 token_type_to_string(type),
@@ -59,6 +95,7 @@ static int expect_peek(Parser *p, TokenType type) {
 // Program -> Statement*
 ASTNode* parse_program(Parser *p) {
     ASTNode *program = ast_node_create(NODE_PROGRAM);
+    p->program = program;
 
     while (p->current_token->type != TOKEN_EOF) {
         ASTNode *stmt = parse_statement(p);
@@ -70,27 +107,48 @@ ASTNode* parse_program(Parser *p) {
     return program;
 }
 
-// Statement -> Declaration | Assignment | PrintStatement | IfStatement
+// Statement -> Declaration | FunctionDecl | Assignment | PrintStatement | IfStatement
+//            | SwitchStatement | ParallelFor | CallStatement | Block | ReturnStatement
 static ASTNode* parse_statement(Parser *p) {
+    int line = p->current_token->line;
+    ASTNode *node = NULL;
     switch (p->current_token->type) {
+        case TOKEN_LBRACE:
+            node = parse_block_statement(p);
+            break;
+        case TOKEN_RETURN:
+            node = parse_return_statement(p);
+            break;
         case TOKEN_INT:
-            return parse_var_decl_statement(p);
+            node = parse_var_decl_statement(p);
+            break;
         case TOKEN_PRINT:
-            return parse_print_statement(p);
+            node = parse_print_statement(p);
+            break;
         case TOKEN_IF:
-            return parse_if_statement(p);
+            node = parse_if_statement(p);
+            break;
+        case TOKEN_SWITCH:
+            node = parse_switch_statement(p);
+            break;
+        case TOKEN_PARALLEL:
+            node = parse_parallel_for(p);
+            break;
         case TOKEN_IDENTIFIER:
-            if (p->peek_token->type == TOKEN_ASSIGN) {
-                return parse_assign_statement(p, p->current_token);
+            if (p->peek_token->type == TOKEN_ASSIGN || p->peek_token->type == TOKEN_LBRACKET) {
+                node = parse_assign_statement(p, p->current_token);
+            } else if (p->peek_token->type == TOKEN_LPAREN) {
+                node = parse_expression_statement(p);
             }
             break;
         default:
-            return NULL;
+            break;
     }
-    return NULL;
+    if (node) node->line = line;
+    return node;
 }
 
-// Declaration -> 'int' Identifier ';'
+// Declaration -> 'int' Identifier [ '[' Number ']' ] ';'
 static ASTNode* parse_var_decl_statement(Parser *p) {
     ASTNode *node = ast_node_create(STMT_VAR_DECL);
 
@@ -99,7 +157,40 @@ static ASTNode* parse_var_decl_statement(Parser *p) {
         return NULL;
     }
     
-    node->name = strdup(p->current_token->lexeme);
+    node->name = counted_strdup(p->current_token->lexeme);
+
+    // 'int name(' starts a function definition instead
+    if (p->peek_token->type == TOKEN_LPAREN) {
+        ASTNode *function = parse_function_decl(p, node->name);
+        ast_node_free(node);
+        return function;
+    }
+
+    // Optional array extent, e.g. 'int a[10];'
+    if (p->peek_token->type == TOKEN_LBRACKET) {
+        parser_next_token(p); // current_token is now '['
+
+        if (!expect_peek(p, TOKEN_INTEGER_LITERAL)) {
+            ast_node_free(node);
+            return NULL;
+        }
+        // strtol rather than atoi, so a size too big for an int is rejected instead of wrapping
+        errno = 0;
+        long size = strtol(p->current_token->lexeme, NULL, 10);
+        if (errno == ERANGE || size <= 0 || size > MAX_ARRAY_SIZE) {
+            p->error_count++;
+            fprintf(stderr, "Parser Error (Line %d): Array '%s' must have a size from 1 to %d\n",
+                    p->current_token->line, node->name, MAX_ARRAY_SIZE);
+            ast_node_free(node);
+            return NULL;
+        }
+        node->array_size = (int)size;
+
+        if (!expect_peek(p, TOKEN_RBRACKET)) {
+            ast_node_free(node);
+            return NULL;
+        }
+    }
 
     if (!expect_peek(p, TOKEN_SEMICOLON)) {
         ast_node_free(node);
@@ -109,10 +200,30 @@ static ASTNode* parse_var_decl_statement(Parser *p) {
     return node;
 }
 
-// Assignment -> Identifier '=' Expression ';'
+// Assignment -> Identifier [ '[' Expression ']' ] '=' Expression ';'
 static ASTNode* parse_assign_statement(Parser *p, Token* identifier_token) {
     ASTNode *node = ast_node_create(STMT_ASSIGN);
-    node->name = strdup(identifier_token->lexeme);
+    node->name = counted_strdup(identifier_token->lexeme);
+
+    // Element assignment, e.g. 'a[i] = 5;'
+    if (p->peek_token->type == TOKEN_LBRACKET) {
+        parser_next_token(p); // current_token is now '['
+        parser_next_token(p); // current_token is now the start of the index
+
+        node->index = parse_expression(p);
+
+        if (!expect_peek(p, TOKEN_RBRACKET)) {
+            ast_node_free(node);
+            return NULL;
+        }
+        if (p->peek_token->type != TOKEN_ASSIGN) {
+            p->error_count++;
+            fprintf(stderr, "Parser Error (Line %d): Expected '=' after '%s[...]'\n",
+                    p->peek_token->line, node->name);
+            ast_node_free(node);
+            return NULL;
+        }
+    }
 
     // Consume the '='
     parser_next_token(p); // current_token is now '='
@@ -128,7 +239,98 @@ static ASTNode* parse_assign_statement(Parser *p, Token* identifier_token) {
     return node;
 }
 
-// PrintStatement -> 'print' '(' Identifier ')' ';'
+// FunctionDecl -> 'int' Identifier '(' [ 'int' Identifier { ',' 'int' Identifier }* ] ')' Block
+static ASTNode* parse_function_decl(Parser *p, const char *name) {
+    ASTNode *node = ast_node_create(STMT_FUNC_DECL);
+    node->name = counted_strdup(name);
+
+    parser_next_token(p); // current_token is now '('
+
+    while (p->peek_token->type != TOKEN_RPAREN) {
+        if (node->param_count > 0 && !expect_peek(p, TOKEN_COMMA)) {
+            ast_node_free(node);
+            return NULL;
+        }
+        if (!expect_peek(p, TOKEN_INT) || !expect_peek(p, TOKEN_IDENTIFIER)) {
+            ast_node_free(node);
+            return NULL;
+        }
+        ast_function_add_param(node, p->current_token->lexeme);
+    }
+    parser_next_token(p); // current_token is now ')'
+
+    if (!expect_peek(p, TOKEN_LBRACE)) {
+        ast_node_free(node);
+        return NULL;
+    }
+
+    p->in_function++;
+    node->body = parse_block_statement(p);
+    p->in_function--;
+    if (!node->body) {
+        ast_node_free(node);
+        return NULL;
+    }
+    return node;
+}
+
+// Block -> '{' Statement* '}'
+static ASTNode* parse_block_statement(Parser *p) {
+    ASTNode *node = ast_node_create(STMT_BLOCK);
+
+    parser_next_token(p); // Consume '{'
+
+    while (p->current_token->type != TOKEN_RBRACE) {
+        if (p->current_token->type == TOKEN_EOF) {
+            p->error_count++;
+            fprintf(stderr, "Parser Error (Line %d): Expected '}' before end of file\n",
+                    p->current_token->line);
+            ast_node_free(node);
+            return NULL;
+        }
+        ASTNode *stmt = parse_statement(p);
+        if (stmt) {
+            ast_program_add_statement(node, stmt);
+        }
+        parser_next_token(p);
+    }
+    return node;
+}
+
+// ReturnStatement -> 'return' Expression ';'
+static ASTNode* parse_return_statement(Parser *p) {
+    ASTNode *node = ast_node_create(STMT_RETURN);
+
+    parser_next_token(p); // Consume 'return'
+    node->expression = parse_expression(p);
+
+    if (!node->expression || !expect_peek(p, TOKEN_SEMICOLON)) {
+        ast_node_free(node);
+        return NULL;
+    }
+    return node;
+}
+
+// CallStatement -> Call ';'
+static ASTNode* parse_expression_statement(Parser *p) {
+    ASTNode *node = ast_node_create(STMT_EXPR);
+    node->expression = parse_expression(p);
+
+    if (node->expression && node->expression->type != EXPR_CALL) {
+        p->error_count++;
+        fprintf(stderr, "Parser Error (Line %d): Only a call can be used as a statement\n",
+                p->current_token->line);
+        ast_node_free(node);
+        return NULL;
+    }
+    if (!node->expression || !expect_peek(p, TOKEN_SEMICOLON)) {
+        ast_node_free(node);
+        return NULL;
+    }
+    return node;
+}
+
+// PrintStatement -> 'print' '(' Expression ')' ';'
 static ASTNode* parse_print_statement(Parser *p) {
     ASTNode *node = ast_node_create(STMT_PRINT);
 
@@ -137,16 +339,16 @@ static ASTNode* parse_print_statement(Parser *p) {
         return NULL;
     }
     
-    if (!expect_peek(p, TOKEN_IDENTIFIER)) {
-         fprintf(stderr, "Parser Error (Line %d): Expected IDENTIFIER inside print()\n", p->current_token->line);
+    parser_next_token(p); // Consume '('
+
+    node->print_expr = parse_expression(p);
+    if (!node->print_expr) {
+         p->error_count++;
+         fprintf(stderr, "Parser Error (Line %d): Expected expression inside print()\n", p->current_token->line);
          ast_node_free(node);
          return NULL;
     }
 
-    node->print_expr = ast_node_create(EXPR_IDENTIFIER);
-    node->print_expr->name = strdup(p->current_token->lexeme);
-
-
     if (!expect_peek(p, TOKEN_RPAREN)) {
         ast_node_free(node);
         return NULL;
@@ -159,9 +361,111 @@ static ASTNode* parse_print_statement(Parser *p) {
     return node;
 }
 
+// --- Lazy Bodies ---
+// In lazy mode an 'if' body is only delimited, by matching brackets, and
+// parsed when it first runs. The skip is deliberately cheap and permissive:
+// anything it cannot delimit with certainty is parsed in full straight away,
+// and syntax errors inside a skipped body are reported when it runs.
+
+// With current_token on '(', '[' or '{', moves it to the matching closer
+static int skip_group(Parser *p) {
+    int depth = 0;
+    for (;;) {
+        switch (p->current_token->type) {
+            case TOKEN_LPAREN: case TOKEN_LBRACKET: case TOKEN_LBRACE: depth++; break;
+            case TOKEN_RPAREN: case TOKEN_RBRACKET: case TOKEN_RBRACE: depth--; break;
+            default: break;
+        }
+        if (depth == 0) return 0;
+        if (p->current_position >= p->token_count - 1) return -1; // Ran out of tokens
+        parser_next_token(p);
+    }
+}
+
+// Moves current_token to the ';' that ends an assignment, call, print or return
+static int skip_simple_statement(Parser *p) {
+    while (p->current_token->type != TOKEN_SEMICOLON) {
+        switch (p->current_token->type) {
+            case TOKEN_LPAREN:
+            case TOKEN_LBRACKET:
+                if (skip_group(p) != 0) return -1;
+                break;
+            case TOKEN_LBRACE: case TOKEN_RBRACE: case TOKEN_RPAREN: case TOKEN_RBRACKET:
+                return -1;
+            default:
+                break;
+        }
+        if (p->current_position >= p->token_count - 1) return -1;
+        parser_next_token(p);
+    }
+    return 0;
+}
+
+// Moves current_token to the last token of the statement it starts, without
+// building anything. Returns -1 if the statement cannot be delimited this way.
+static int skip_statement(Parser *p) {
+    switch (p->current_token->type) {
+        case TOKEN_LBRACE:
+            return skip_group(p);
+        case TOKEN_IF:
+        case TOKEN_SWITCH: {
+            TokenType keyword = p->current_token->type;
+            if (p->peek_token->type != TOKEN_LPAREN) return -1;
+            parser_next_token(p); // current_token is now '('
+            if (skip_group(p) != 0) return -1;
+            parser_next_token(p); // current_token now starts the body
+            if (keyword == TOKEN_IF) return skip_statement(p);
+            return p->current_token->type == TOKEN_LBRACE ? skip_group(p) : -1;
+        }
+        case TOKEN_IDENTIFIER:
+            if (p->peek_token->type != TOKEN_ASSIGN && p->peek_token->type != TOKEN_LBRACKET &&
+                p->peek_token->type != TOKEN_LPAREN) {
+                return -1;
+            }
+            return skip_simple_statement(p);
+        case TOKEN_PRINT:
+        case TOKEN_RETURN:
+            return skip_simple_statement(p);
+        default:
+            return -1;
+    }
+}
+
+// Skips the 'if' body at current_token and returns a placeholder for it, or
+// returns NULL, back where it started, if the body has to be parsed now
+static ASTNode* skip_lazy_body(Parser *p) {
+    int first = p->current_position;
+    if (skip_statement(p) != 0) {
+        parser_seek(p, first);
+        return NULL;
+    }
+
+    ASTNode *node = ast_node_create(STMT_LAZY);
+    node->line = p->tokens[first]->line;
+    node->lazy_tokens = &p->tokens[first];
+    node->lazy_token_count = p->current_position - first + 1;
+    node->lazy_program = p->program;
+    return node;
+}
+
+ASTNode* parse_lazy_statement(const ASTNode *lazy) {
+    Parser *p = parser_create_from_tokens(lazy->lazy_tokens, lazy->lazy_token_count);
+    p->lazy = 1;
+    p->program = lazy->lazy_program;
+
+    ASTNode *stmt = parse_statement(p);
+    if (p->error_count > 0 || !stmt) {
+        ast_node_free(stmt);
+        stmt = NULL;
+    }
+    parser_destroy(p);
+    return stmt;
+}
+
 // IfStatement -> 'if' '(' Condition ')' Statement
 static ASTNode* parse_if_statement(Parser *p) {
     ASTNode *node = ast_node_create(STMT_IF);
+    int line = p->current_token->line;
 
     if (!expect_peek(p, TOKEN_LPAREN)) {
         ast_node_free(node);
@@ -178,81 +482,351 @@ static ASTNode* parse_if_statement(Parser *p) {
     }
     
     parser_next_token(p); // Consume ')'
-    
+
+    if (p->tokens && !p->in_function) {
+        int cold = !p->lazy && p->profile && profile_if_cold(p->profile, line, p->current_token->line);
+        if (p->lazy || cold) node->body = skip_lazy_body(p);
+        if (node->body) {
+            p->cold_bodies += cold;
+            return node;
+        }
+    }
     node->body = parse_statement(p);
     
     return node;
 }
 
+// SwitchStatement -> 'switch' '(' Expression ')' '{' { CaseLabel Statement* }* '}'
+// CaseLabel       -> 'case' [ '-' ] Number ':' | 'default' ':'
+// Only the matching case runs; there is no fall-through. A label directly
+// followed by another label shares that label's statements.
+static ASTNode* parse_switch_statement(Parser *p) {
+    ASTNode *node = ast_node_create(STMT_SWITCH);
+    SwitchTable *table = node->switch_table;
 
-// --- Expression Parsing (with precedence) ---
+    if (!expect_peek(p, TOKEN_LPAREN)) {
+        ast_node_free(node);
+        return NULL;
+    }
+    parser_next_token(p); // Consume '('
 
-// Expression -> Term { ('+' | '-') Term }*
-static ASTNode* parse_expression(Parser *p) {
-    ASTNode *left = parse_term(p);
+    node->condition = parse_expression(p);
+    if (!node->condition || !expect_peek(p, TOKEN_RPAREN) || !expect_peek(p, TOKEN_LBRACE)) {
+        ast_node_free(node);
+        return NULL;
+    }
+    parser_next_token(p); // Consume '{'
+
+    while (p->current_token->type != TOKEN_RBRACE) {
+        // Labels for the next body, which will be statements[statement_count]
+        int target = node->statement_count;
+
+        if (p->current_token->type == TOKEN_CASE) {
+            int negative = (p->peek_token->type == TOKEN_MINUS);
+            if (negative) parser_next_token(p);
+            if (!expect_peek(p, TOKEN_INTEGER_LITERAL)) {
+                ast_node_free(node);
+                return NULL;
+            }
+            int value;
+            const char *digits = p->current_token->lexeme;
+            input_parse_int(digits, digits + strlen(digits), &value);
+            ast_switch_add_case(node, negative ? (int)(0u - (unsigned)value) : value, target);
+        } else if (p->current_token->type == TOKEN_DEFAULT) {
+            if (table->default_target != -1) {
+                p->error_count++;
+                fprintf(stderr, "Parser Error (Line %d): A switch can only have one 'default'\n",
+                        p->current_token->line);
+                ast_node_free(node);
+                return NULL;
+            }
+            table->default_target = target;
+        } else {
+            p->error_count++;
+            fprintf(stderr, "Parser Error (Line %d): Expected 'case', 'default' or '}' in switch, got %s\n",
+                    p->current_token->line, token_type_to_string(p->current_token->type));
+            ast_node_free(node);
+            return NULL;
+        }
 
-    while (p->peek_token->type == TOKEN_PLUS || p->peek_token->type == TOKEN_MINUS ||
-           p->peek_token->type == TOKEN_EQUAL || p->peek_token->type == TOKEN_LT ||
-           p->peek_token->type == TOKEN_GT) 
-    {
-        parser_next_token(p); // Consume the operator
-        ASTNode *node = ast_node_create(EXPR_BINARY);
-        node->op = p->current_token;
-        node->left = left;
-        
-        parser_next_token(p); // Consume operator, move to right-hand side
-        node->right = parse_term(p);
-        
-        left = node; 
+        if (!expect_peek(p, TOKEN_COLON)) {
+            ast_node_free(node);
+            return NULL;
+        }
+        parser_next_token(p); // Consume ':'
+
+        // Another label straight away shares the body that follows it
+        TokenType next = p->current_token->type;
+        if (next == TOKEN_CASE || next == TOKEN_DEFAULT) continue;
+
+        ASTNode *body = ast_node_create(STMT_BLOCK);
+        while (p->current_token->type != TOKEN_CASE && p->current_token->type != TOKEN_DEFAULT &&
+               p->current_token->type != TOKEN_RBRACE) {
+            if (p->current_token->type == TOKEN_EOF) {
+                p->error_count++;
+                fprintf(stderr, "Parser Error (Line %d): Expected '}' before end of file\n",
+                        p->current_token->line);
+                ast_node_free(body);
+                ast_node_free(node);
+                return NULL;
+            }
+            ASTNode *stmt = parse_statement(p);
+            if (stmt) {
+                ast_program_add_statement(body, stmt);
+            }
+            parser_next_token(p);
+        }
+        ast_program_add_statement(node, body);
     }
-    
-    return left;
+    return node;
 }
 
-// Term -> Factor { ('*' | '/') Factor }*
-static ASTNode* parse_term(Parser *p) {
-    ASTNode *left = parse_factor(p);
+// ParallelFor -> 'parallel' 'for' '(' Identifier '=' Expression ';' Identifier '<' Expression ')'
+//                { Reduction }* Statement
+// Reduction   -> ( 'sum' | 'min' | 'max' ) '(' Identifier ')'
+static ASTNode* parse_parallel_for(Parser *p) {
+    ASTNode *node = ast_node_create(STMT_PARALLEL_FOR);
 
-    while (p->peek_token->type == TOKEN_STAR || p->peek_token->type == TOKEN_SLASH) {
-        parser_next_token(p); // Consume the operator
-        ASTNode *node = ast_node_create(EXPR_BINARY);
-        node->op = p->current_token;
-        node->left = left;
-        
-        parser_next_token(p); // Consume operator, move to right-hand side
-        node->right = parse_factor(p);
-        
-        left = node;
+    if (!expect_peek(p, TOKEN_FOR) || !expect_peek(p, TOKEN_LPAREN) ||
+        !expect_peek(p, TOKEN_IDENTIFIER)) {
+        ast_node_free(node);
+        return NULL;
     }
-    
-    return left;
-}
+    node->name = counted_strdup(p->current_token->lexeme);
+    if (!expect_peek(p, TOKEN_ASSIGN)) {
+        ast_node_free(node);
+        return NULL;
+    }
+    parser_next_token(p); // Consume '='
 
-// Factor -> Number | Identifier | '(' Expression ')'
-static ASTNode* parse_factor(Parser *p) {
-    ASTNode *node = NULL;
+    node->left = parse_expression(p);
+    if (!node->left || !expect_peek(p, TOKEN_SEMICOLON) || !expect_peek(p, TOKEN_IDENTIFIER)) {
+        ast_node_free(node);
+        return NULL;
+    }
+    if (strcmp(p->current_token->lexeme, node->name) != 0) {
+        p->error_count++;
+        fprintf(stderr, "Parser Error (Line %d): The loop condition must test '%s'\n",
+                p->current_token->line, node->name);
+        ast_node_free(node);
+        return NULL;
+    }
+    if (!expect_peek(p, TOKEN_LT)) {
+        ast_node_free(node);
+        return NULL;
+    }
+    parser_next_token(p); // Consume '<'
 
-    if (p->current_token->type == TOKEN_INTEGER_LITERAL) {
-        node = ast_node_create(EXPR_LITERAL);
-        node->value = atoi(p->current_token->lexeme);
-    } 
-    else if (p->current_token->type == TOKEN_IDENTIFIER) {
-        node = ast_node_create(EXPR_IDENTIFIER);
-        node->name = strdup(p->current_token->lexeme);
-    }
-    else if (p->current_token->type == TOKEN_LPAREN) {
-        parser_next_token(p); // Consume '('
-        node = parse_expression(p); // Parse the sub-expression
-        
+    node->right = parse_expression(p);
+    if (!node->right || !expect_peek(p, TOKEN_RPAREN)) {
+        ast_node_free(node);
+        return NULL;
+    }
+    parser_next_token(p); // Consume ')'
+
+    // Reduction clauses, until the body starts
+    while (p->current_token->type == TOKEN_IDENTIFIER && p->peek_token->type == TOKEN_LPAREN) {
+        const char *clause = p->current_token->lexeme;
+        BuiltinType kind = strcmp(clause, "sum") == 0 ? BUILTIN_SUM
+                         : strcmp(clause, "min") == 0 ? BUILTIN_MIN
+                         : strcmp(clause, "max") == 0 ? BUILTIN_MAX : BUILTIN_NONE;
+        if (kind == BUILTIN_NONE) break; // A call statement as the body
+        parser_next_token(p); // current_token is now '('
+        if (!expect_peek(p, TOKEN_IDENTIFIER)) {
+            ast_node_free(node);
+            return NULL;
+        }
+        ast_loop_add_reduction(node, kind, p->current_token->lexeme);
         if (!expect_peek(p, TOKEN_RPAREN)) {
             ast_node_free(node);
             return NULL;
         }
-    } else {
-        fprintf(stderr, "Parser Error (Line %d): Expected literal, identifier, or '(', got %s\n",
-                p->current_token->line,
-                token_type_to_string(p->current_token->type));
+        parser_next_token(p); // Consume ')'
     }
 
+    // The body has locals of its own, so it is parsed in full like a function's
+    p->in_function++;
+    node->body = parse_statement(p);
+    p->in_function--;
+    if (!node->body) {
+        ast_node_free(node);
+        return NULL;
+    }
     return node;
-}
\ No newline at end of file
+}
+
+// --- Expression Parsing (with precedence) ---
+// Expressions are parsed by precedence climbing over an explicit stack rather
+// than one C call per nesting level, so machine-generated expressions of any
+// depth parse in linear time without exhausting the C stack.
+
+// Binding strength of each binary operator (0 if the token is not one).
+// Operators of equal strength associate to the left.
+static const int binary_precedence[TOKEN_ILLEGAL + 1] = {
+    [TOKEN_PLUS] = 1, [TOKEN_MINUS] = 1,
+    [TOKEN_EQUAL] = 1, [TOKEN_LT] = 1, [TOKEN_GT] = 1,
+    [TOKEN_STAR] = 2, [TOKEN_SLASH] = 2,
+};
+
+// The operation each binary operator performs
+static const BinaryKind binary_kind[TOKEN_ILLEGAL + 1] = {
+    [TOKEN_PLUS] = BINARY_ADD, [TOKEN_MINUS] = BINARY_SUB,
+    [TOKEN_STAR] = BINARY_MUL, [TOKEN_SLASH] = BINARY_DIV,
+    [TOKEN_EQUAL] = BINARY_EQUAL, [TOKEN_LT] = BINARY_LESS, [TOKEN_GT] = BINARY_GREATER,
+};
+
+static void push_frame(Parser *p, ExprFrameKind kind, Token *op, int precedence, ASTNode *node) {
+    if (p->frame_count == p->frame_capacity) {
+        int capacity = p->frame_capacity ? p->frame_capacity * 2 : 32;
+        ExprFrame *grown = (ExprFrame*)counted_realloc(p->frames, capacity * sizeof(ExprFrame));
+        if (!grown) {
+            fprintf(stderr, "Error: Could not reallocate memory for the expression stack.\n");
+            exit(1);
+        }
+        p->frames = grown;
+        p->frame_capacity = capacity;
+    }
+    ExprFrame *frame = &p->frames[p->frame_count++];
+    frame->kind = kind;
+    frame->op = op;
+    frame->precedence = precedence;
+    frame->node = node;
+}
+
+// Combines operands under every stacked operator binding at least as tightly as 'min_precedence'
+static void reduce_operators(Parser *p, int min_precedence) {
+    while (p->frame_count > 0) {
+        ExprFrame *frame = &p->frames[p->frame_count - 1];
+        if (frame->kind != FRAME_OPERATOR || frame->precedence < min_precedence) break;
+
+        ASTNode *node = ast_node_create(EXPR_BINARY);
+        node->op = frame->op;
+        node->binary = binary_kind[frame->op->type];
+        node->right = ast_stack_pop(&p->operands);
+        node->left = ast_stack_pop(&p->operands);
+        ast_stack_push(&p->operands, node);
+        p->frame_count--;
+    }
+}
+
+// Frees a partly parsed expression after a syntax error
+static ASTNode* discard_expression(Parser *p) {
+    ASTNode *node;
+    while ((node = ast_stack_pop(&p->operands)) != NULL) {
+        ast_node_free(node);
+    }
+    for (int i = 0; i < p->frame_count; i++) {
+        ast_node_free(p->frames[i].node);
+    }
+    p->frame_count = 0;
+    return NULL;
+}
+
+// Expression -> Operand { ('+' | '-' | '*' | '/' | '==' | '<' | '>') Operand }*
+// Operand    -> Number | Identifier | Identifier '[' Expression ']' | Call | '(' Expression ')'
+// Call       -> Identifier '(' [ Expression { ',' Expression }* ] ')'
+static ASTNode* parse_expression(Parser *p) {
+    p->operands.count = 0;
+    p->frame_count = 0;
+
+    for (;;) {
+        // Operand position: current_token starts an operand, or opens a group around one
+        Token *token = p->current_token;
+
+        if (token->type == TOKEN_INTEGER_LITERAL) {
+            ASTNode *node = ast_node_create(EXPR_LITERAL);
+            input_parse_int(token->lexeme, token->lexeme + strlen(token->lexeme), &node->value);
+            ast_stack_push(&p->operands, node);
+        }
+        else if (token->type == TOKEN_IDENTIFIER && p->peek_token->type == TOKEN_LPAREN) {
+            ASTNode *node = ast_node_create(EXPR_CALL);
+            node->name = counted_strdup(token->lexeme);
+            parser_next_token(p); // current_token is now '('
+
+            if (p->peek_token->type == TOKEN_RPAREN) {
+                parser_next_token(p); // Empty argument list
+                ast_stack_push(&p->operands, node);
+            } else {
+                push_frame(p, FRAME_CALL, NULL, 0, node);
+                parser_next_token(p); // Move to the first argument
+                continue;
+            }
+        }
+        else if (token->type == TOKEN_IDENTIFIER && p->peek_token->type == TOKEN_LBRACKET) {
+            ASTNode *node = ast_node_create(EXPR_INDEX);
+            node->name = counted_strdup(token->lexeme);
+            push_frame(p, FRAME_INDEX, NULL, 0, node);
+
+            parser_next_token(p); // current_token is now '['
+            parser_next_token(p); // current_token is now the start of the index
+            continue;
+        }
+        else if (token->type == TOKEN_IDENTIFIER) {
+            ASTNode *node = ast_node_create(EXPR_IDENTIFIER);
+            node->name = counted_strdup(token->lexeme);
+            ast_stack_push(&p->operands, node);
+        }
+        else if (token->type == TOKEN_LPAREN) {
+            push_frame(p, FRAME_GROUP, NULL, 0, NULL);
+            parser_next_token(p); // Consume '('
+            continue;
+        }
+        else {
+            p->error_count++;
+            fprintf(stderr, "Parser Error (Line %d): Expected literal, identifier, or '(', got %s\n",
+                    token->line, token_type_to_string(token->type));
+            return discard_expression(p);
+        }
+
+        // Operator position: current_token ends an operand. Close every group it
+        // completes, then either take the next operator or finish.
+        for (;;) {
+            TokenType next = p->peek_token->type;
+            int precedence = binary_precedence[next];
+
+            if (precedence > 0) {
+                reduce_operators(p, precedence);
+                parser_next_token(p); // current_token is now the operator
+                push_frame(p, FRAME_OPERATOR, p->current_token, precedence, NULL);
+                parser_next_token(p); // Move to the right-hand side
+                break;
+            }
+
+            reduce_operators(p, 1);
+            if (p->frame_count == 0) {
+                return ast_stack_pop(&p->operands); // The whole expression
+            }
+
+            ExprFrame *frame = &p->frames[p->frame_count - 1];
+            if (frame->kind == FRAME_GROUP && next == TOKEN_RPAREN) {
+                p->frame_count--;
+                parser_next_token(p); // current_token is now ')'
+                continue;
+            }
+            if (frame->kind == FRAME_INDEX && next == TOKEN_RBRACKET) {
+                ASTNode *node = frame->node;
+                node->index = ast_stack_pop(&p->operands);
+                ast_stack_push(&p->operands, node);
+                p->frame_count--;
+                parser_next_token(p); // current_token is now ']'
+                continue;
+            }
+            if (frame->kind == FRAME_CALL && (next == TOKEN_COMMA || next == TOKEN_RPAREN)) {
+                ASTNode *node = frame->node;
+                ast_call_add_argument(node, ast_stack_pop(&p->operands));
+                parser_next_token(p); // current_token is now ',' or ')'
+                if (next == TOKEN_COMMA) {
+                    parser_next_token(p); // Move to the next argument
+                    break;
+                }
+                ast_stack_push(&p->operands, node);
+                p->frame_count--;
+                continue;
+            }
+
+            // The innermost group is missing its closing token
+            expect_peek(p, frame->kind == FRAME_INDEX ? TOKEN_RBRACKET : TOKEN_RPAREN);
+            return discard_expression(p);
+        }
+    }
+}
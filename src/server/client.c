@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "oba_protocol.h"
+#include "snapshot.h"
+
+// oba_client: runs one script on an oba_server and prints what it printed,
+// in the same form as oba_c. The script is sent by hash, and in full only if
+// the server has not compiled it yet.
+
+// Reads the rest of 'f' into a NUL-terminated buffer. Returns NULL on error.
+static char* read_stream(FILE *f, size_t *length) {
+    size_t capacity = 4096;
+    *length = 0;
+    char *buffer = (char*)malloc(capacity);
+    while (buffer) {
+        *length += fread(buffer + *length, 1, capacity - *length - 1, f);
+        if (*length < capacity - 1) break;
+        capacity *= 2;
+        char *grown = (char*)realloc(buffer, capacity);
+        if (!grown) free(buffer);
+        buffer = grown;
+    }
+    if (buffer && ferror(f)) {
+        free(buffer);
+        buffer = NULL;
+    }
+    if (buffer) buffer[*length] = '\0';
+    return buffer;
+}
+
+static char* read_file(const char *path, size_t *length) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    char *buffer = read_stream(f, length);
+    fclose(f);
+    return buffer;
+}
+
+static void print_values(void *user_data, const int32_t *values, int count) {
+    (void)user_data;
+    for (int i = 0; i < count; i++) {
+        printf("Oba-C Output: %d\n", values[i]);
+    }
+}
+
+static void print_usage(const char *program_name) {
+    fprintf(stderr,
+            "Usage: %s [options] script.oba\n"
+            "  --socket=PATH   Connect to the server on PATH (default: %s)\n"
+            "  --input=FILE    Numbers for read() and read_all() (default: stdin, unless it is a terminal)\n",
+            program_name, OBA_DEFAULT_SOCKET);
+}
+
+int main(int argc, char **argv) {
+    const char *socket_path = OBA_DEFAULT_SOCKET;
+    const char *input_path = NULL;
+    const char *script_path = NULL;
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--socket=", 9) == 0) {
+            socket_path = arg + 9;
+        } else if (strncmp(arg, "--input=", 8) == 0) {
+            input_path = arg + 8;
+        } else if (arg[0] != '-' && !script_path) {
+            script_path = arg;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!script_path) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    size_t source_length, input_length = 0;
+    char *source = read_file(script_path, &source_length);
+    if (!source) {
+        fprintf(stderr, "Error: Could not read '%s'.\n", script_path);
+        return 1;
+    }
+    // The input goes out with the request, so stdin is read up front. A terminal
+    // is left alone rather than waited on: the script then sees no input.
+    char *input = NULL;
+    if (input_path || !isatty(STDIN_FILENO)) {
+        input = input_path ? read_file(input_path, &input_length) : read_stream(stdin, &input_length);
+        if (!input) {
+            fprintf(stderr, "Error: Could not read '%s'.\n", input_path ? input_path : "stdin");
+            return 1;
+        }
+    }
+
+    int fd = protocol_connect(socket_path);
+    if (fd < 0) {
+        fprintf(stderr, "Error: No server is listening on '%s'.\n", socket_path);
+        return 1;
+    }
+
+    ObaRunResult result;
+    char error[256];
+    if (protocol_run(fd, snapshot_hash_program(source), source, source_length, input, input_length,
+                     print_values, NULL, &result, error, sizeof(error)) != 0) {
+        fprintf(stderr, "Error: Lost the connection to the server.\n");
+        return 1;
+    }
+    if (result.status != 0) fprintf(stderr, "Error: %s\n", error);
+
+    close(fd);
+    free(source);
+    free(input);
+    return result.status != 0;
+}
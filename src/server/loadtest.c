@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include "oba_protocol.h"
+#include "snapshot.h"
+
+// oba_loadtest: sends the same script to an oba_server from several client
+// threads at once and reports requests per second and latency percentiles.
+// With --process it also runs the script as one oba_c process per request,
+// the way it is run without a server, for comparison.
+
+typedef struct {
+    const char *socket_path;
+    const char *script_path;
+    const char *process_path; // oba_c to compare against, or NULL
+    const char *source;
+    size_t source_length;
+    uint64_t hash;
+    int clients;
+    int requests;             // In all, split between the clients
+} LoadTest;
+
+// One client thread's share of the requests
+typedef struct {
+    const LoadTest *test;
+    int requests;
+    double *latencies;        // Seconds, one per request
+    int failures;
+} Client;
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// --- Clients ---
+
+static void* server_client(void *arg) {
+    Client *c = (Client*)arg;
+    const LoadTest *test = c->test;
+    int fd = protocol_connect(test->socket_path);
+
+    for (int i = 0; i < c->requests; i++) {
+        double start = now();
+        ObaRunResult result;
+        char error[256];
+        if (fd < 0 || protocol_run(fd, test->hash, test->source, test->source_length, NULL, 0,
+                                   NULL, NULL, &result, error, sizeof(error)) != 0) {
+            c->failures += c->requests - i; // The connection is gone
+            break;
+        }
+        if (result.status != 0) c->failures++;
+        c->latencies[i] = now() - start;
+    }
+    if (fd >= 0) close(fd);
+    return NULL;
+}
+
+static void* process_client(void *arg) {
+    Client *c = (Client*)arg;
+    const LoadTest *test = c->test;
+
+    for (int i = 0; i < c->requests; i++) {
+        double start = now();
+        pid_t pid = fork();
+        if (pid == 0) {
+            int null_fd = open("/dev/null", O_RDWR);
+            dup2(null_fd, 0);
+            dup2(null_fd, 1);
+            dup2(null_fd, 2);
+            execl(test->process_path, test->process_path, test->script_path, (char*)NULL);
+            _exit(127);
+        }
+        int status = 0;
+        if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            c->failures++;
+        }
+        c->latencies[i] = now() - start;
+    }
+    return NULL;
+}
+
+// --- Measurement ---
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// The latency below which 'percent' of the requests finished
+static double percentile(const double *sorted, int count, double percent) {
+    int index = (int)(count * percent / 100.0 + 0.999999) - 1;
+    if (index < 0) index = 0;
+    if (index >= count) index = count - 1;
+    return sorted[index];
+}
+
+// Runs every request through 'client' threads and prints one row of results.
+// Returns 0, or -1 if out of memory.
+static int measure(const LoadTest *test, const char *mode, void *(*client)(void*)) {
+    Client *clients = (Client*)calloc(test->clients, sizeof(Client));
+    pthread_t *threads = (pthread_t*)malloc(test->clients * sizeof(pthread_t));
+    double *latencies = (double*)calloc(test->requests, sizeof(double));
+    if (!clients || !threads || !latencies) {
+        free(clients);
+        free(threads);
+        free(latencies);
+        return -1;
+    }
+
+    int given = 0;
+    for (int t = 0; t < test->clients; t++) {
+        clients[t].test = test;
+        clients[t].requests = test->requests / test->clients + (t < test->requests % test->clients);
+        clients[t].latencies = latencies + given;
+        given += clients[t].requests;
+    }
+
+    double start = now();
+    int started = 0;
+    for (; started < test->clients; started++) {
+        if (pthread_create(&threads[started], NULL, client, &clients[started]) != 0) break;
+    }
+    int failures = 0;
+    for (int t = 0; t < test->clients; t++) {
+        if (t < started) pthread_join(threads[t], NULL);
+        else clients[t].failures = clients[t].requests;
+        failures += clients[t].failures;
+    }
+    double elapsed = now() - start;
+
+    qsort(latencies, test->requests, sizeof(double), compare_doubles);
+    printf("%-8s %9d %9.3f %10.1f %9.3f %9.3f %9d\n", mode, test->requests, elapsed,
+           test->requests / elapsed, percentile(latencies, test->requests, 50) * 1000,
+           percentile(latencies, test->requests, 99) * 1000, failures);
+
+    free(clients);
+    free(threads);
+    free(latencies);
+    return 0;
+}
+
+static void print_usage(const char *program_name) {
+    fprintf(stderr,
+            "Usage: %s [options] script.oba\n"
+            "  --socket=PATH    Server to test (default: %s)\n"
+            "  --clients=N      Concurrent clients, each on its own connection (default: 4)\n"
+            "  --requests=N     Runs in all (default: 1000)\n"
+            "  --process=OBA_C  Also time one 'OBA_C script.oba' process per run\n",
+            program_name, OBA_DEFAULT_SOCKET);
+}
+
+int main(int argc, char **argv) {
+    LoadTest test;
+    memset(&test, 0, sizeof(test));
+    test.socket_path = OBA_DEFAULT_SOCKET;
+    test.clients = 4;
+    test.requests = 1000;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--socket=", 9) == 0) {
+            test.socket_path = arg + 9;
+        } else if (strncmp(arg, "--clients=", 10) == 0 && atoi(arg + 10) > 0) {
+            test.clients = atoi(arg + 10);
+        } else if (strncmp(arg, "--requests=", 11) == 0 && atoi(arg + 11) > 0) {
+            test.requests = atoi(arg + 11);
+        } else if (strncmp(arg, "--process=", 10) == 0) {
+            test.process_path = arg + 10;
+        } else if (arg[0] != '-' && !test.script_path) {
+            test.script_path = arg;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!test.script_path) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (test.clients > test.requests) test.clients = test.requests;
+
+    // The whole script, sent whenever the server asks for it
+    FILE *f = fopen(test.script_path, "rb");
+    char *source = NULL;
+    long length = -1;
+    if (f && fseek(f, 0, SEEK_END) == 0 && (length = ftell(f)) >= 0 && fseek(f, 0, SEEK_SET) == 0) {
+        source = (char*)malloc(length + 1);
+        if (source && fread(source, 1, length, f) != (size_t)length) {
+            free(source);
+            source = NULL;
+        }
+    }
+    if (f) fclose(f);
+    if (!source) {
+        fprintf(stderr, "Error: Could not read '%s'.\n", test.script_path);
+        return 1;
+    }
+    source[length] = '\0';
+    test.source = source;
+    test.source_length = (size_t)length;
+    test.hash = snapshot_hash_program(source);
+
+    printf("%-8s %9s %9s %10s %9s %9s %9s\n", "mode", "requests", "seconds", "req/s", "p50 ms", "p99 ms", "failed");
+    int result = measure(&test, "server", server_client);
+    if (result == 0 && test.process_path) result = measure(&test, "process", process_client);
+    if (result != 0) fprintf(stderr, "Error: Out of memory.\n");
+
+    free(source);
+    return result != 0;
+}
@@ -0,0 +1,170 @@
+#include <stdlib.h>
+#include <string.h>
+#include "program_cache.h"
+
+ProgramCache* program_cache_create(int capacity) {
+    ProgramCache *cache = (ProgramCache*)calloc(1, sizeof(ProgramCache));
+    if (!cache) return NULL;
+    if (capacity < 1) capacity = 1;
+    cache->capacity = capacity;
+
+    // At most one entry per bucket on average
+    cache->bucket_count = 16;
+    while (cache->bucket_count < capacity) cache->bucket_count *= 2;
+    cache->buckets = (CachedProgram**)calloc(cache->bucket_count, sizeof(CachedProgram*));
+    if (!cache->buckets) {
+        free(cache);
+        return NULL;
+    }
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+static void entry_free(CachedProgram *entry) {
+    for (int i = 0; i < entry->context_count; i++) {
+        oba_context_free(entry->contexts[i]);
+    }
+    oba_program_free(entry->program);
+    free(entry->source);
+    free(entry);
+}
+
+void program_cache_free(ProgramCache *cache) {
+    if (!cache) return;
+    CachedProgram *entry = cache->newest;
+    while (entry) {
+        CachedProgram *older = entry->older;
+        entry_free(entry);
+        entry = older;
+    }
+    free(cache->buckets);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+// --- Recency List and Buckets ---
+// All of these run with the lock held.
+
+static CachedProgram** bucket_for(ProgramCache *cache, uint64_t hash) {
+    return &cache->buckets[(hash ^ (hash >> 32)) & (uint64_t)(cache->bucket_count - 1)];
+}
+
+static void unlink_recency(ProgramCache *cache, CachedProgram *entry) {
+    if (entry->newer) entry->newer->older = entry->older;
+    else cache->newest = entry->older;
+    if (entry->older) entry->older->newer = entry->newer;
+    else cache->oldest = entry->newer;
+    entry->newer = entry->older = NULL;
+}
+
+static void push_newest(ProgramCache *cache, CachedProgram *entry) {
+    entry->older = cache->newest;
+    if (cache->newest) cache->newest->newer = entry;
+    else cache->oldest = entry;
+    cache->newest = entry;
+}
+
+// Takes an entry out of the cache. It is freed now, or by its last user.
+static void evict(ProgramCache *cache, CachedProgram *entry) {
+    CachedProgram **link = bucket_for(cache, entry->hash);
+    while (*link != entry) link = &(*link)->bucket_next;
+    *link = entry->bucket_next;
+    unlink_recency(cache, entry);
+    cache->count--;
+    cache->evictions++;
+
+    entry->evicted = 1;
+    if (entry->users == 0) entry_free(entry);
+}
+
+static CachedProgram* find(ProgramCache *cache, uint64_t hash, const char *source, size_t source_length) {
+    for (CachedProgram *entry = *bucket_for(cache, hash); entry; entry = entry->bucket_next) {
+        if (entry->hash != hash) continue;
+        if (!source) return entry;
+        if (entry->source_length == source_length && memcmp(entry->source, source, source_length) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// --- Lookup ---
+
+CachedProgram* program_cache_get(ProgramCache *cache, uint64_t hash, const char *source, size_t source_length) {
+    pthread_mutex_lock(&cache->lock);
+    CachedProgram *entry = find(cache, hash, source, source_length);
+    if (entry) {
+        unlink_recency(cache, entry);
+        push_newest(cache, entry);
+        entry->users++;
+        cache->hits++;
+    } else if (source) {
+        cache->misses++; // Only once per script: a hash-only miss is retried with the source
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return entry;
+}
+
+CachedProgram* program_cache_insert(ProgramCache *cache, uint64_t hash, ObaProgram *program,
+                                    const char *source, size_t source_length) {
+    CachedProgram *entry = (CachedProgram*)calloc(1, sizeof(CachedProgram));
+    char *copy = (char*)malloc(source_length + 1);
+    if (!entry || !copy) {
+        free(entry);
+        free(copy);
+        oba_program_free(program);
+        return NULL;
+    }
+    memcpy(copy, source, source_length);
+    copy[source_length] = '\0';
+    entry->hash = hash;
+    entry->program = program;
+    entry->source = copy;
+    entry->source_length = source_length;
+    entry->users = 1;
+
+    pthread_mutex_lock(&cache->lock);
+    CachedProgram *existing = find(cache, hash, source, source_length);
+    if (existing) {
+        // Compiled twice at once: keep the first
+        existing->users++;
+        pthread_mutex_unlock(&cache->lock);
+        entry_free(entry);
+        return existing;
+    }
+
+    // A different source with the same hash gives way, so lookups by hash stay unambiguous
+    CachedProgram *clash = find(cache, hash, NULL, 0);
+    if (clash) evict(cache, clash);
+
+    CachedProgram **bucket = bucket_for(cache, hash);
+    entry->bucket_next = *bucket;
+    *bucket = entry;
+    push_newest(cache, entry);
+    cache->count++;
+    while (cache->count > cache->capacity) evict(cache, cache->oldest);
+    pthread_mutex_unlock(&cache->lock);
+    return entry;
+}
+
+// --- Contexts ---
+
+ObaContext* program_cache_context(ProgramCache *cache, CachedProgram *entry) {
+    pthread_mutex_lock(&cache->lock);
+    ObaContext *ctx = entry->context_count > 0 ? entry->contexts[--entry->context_count] : NULL;
+    pthread_mutex_unlock(&cache->lock);
+    return ctx ? ctx : oba_context_create(entry->program);
+}
+
+void program_cache_release(ProgramCache *cache, CachedProgram *entry, ObaContext *ctx) {
+    pthread_mutex_lock(&cache->lock);
+    if (ctx && !entry->evicted && entry->context_count < PROGRAM_CACHE_CONTEXTS) {
+        entry->contexts[entry->context_count++] = ctx;
+        ctx = NULL;
+    }
+    int last = --entry->users == 0 && entry->evicted;
+    pthread_mutex_unlock(&cache->lock);
+
+    oba_context_free(ctx);
+    if (last) entry_free(entry);
+}
@@ -0,0 +1,146 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "oba_protocol.h"
+
+int protocol_read(int fd, void *data, size_t size) {
+    char *p = (char*)data;
+    while (size > 0) {
+        ssize_t n = read(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+int protocol_send(int fd, uint32_t type, const struct iovec *parts, int part_count) {
+    ObaMessageHeader header = { type, 0 };
+    struct iovec iov[8];
+    if (part_count > 7) return -1;
+
+    iov[0].iov_base = &header;
+    iov[0].iov_len = sizeof(header);
+    size_t length = 0;
+    for (int i = 0; i < part_count; i++) {
+        iov[i + 1] = parts[i];
+        length += parts[i].iov_len;
+    }
+    if (length > OBA_MAX_MESSAGE) return -1;
+    header.length = (uint32_t)length;
+
+    // sendmsg rather than writev, so a client that has gone away is an error, not SIGPIPE
+    struct msghdr msg = {0};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = part_count + 1;
+    while (msg.msg_iovlen > 0) {
+        ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -1;
+
+        // Skip what was sent, then send the rest
+        while (msg.msg_iovlen > 0 && (size_t)n >= msg.msg_iov->iov_len) {
+            n -= (ssize_t)msg.msg_iov->iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen > 0) {
+            msg.msg_iov->iov_base = (char*)msg.msg_iov->iov_base + n;
+            msg.msg_iov->iov_len -= (size_t)n;
+        }
+    }
+    return 0;
+}
+
+int protocol_read_header(int fd, ObaMessageHeader *header, uint32_t max_length) {
+    if (protocol_read(fd, header, sizeof(*header)) != 0) return -1;
+    return header->length <= max_length ? 0 : -1;
+}
+
+// --- Client Side ---
+
+int protocol_connect(const char *path) {
+    struct sockaddr_un address;
+    if (strlen(path) >= sizeof(address.sun_path)) return -1;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Reads the answer to one OBA_MSG_RUN. Returns 0 for OBA_MSG_DONE, 1 for
+// OBA_MSG_UNKNOWN, or -1 if the connection failed.
+static int read_answer(int fd, ProtocolOutputFn output, void *user_data,
+                       ObaRunResult *result, char *error, size_t error_size) {
+    int32_t values[OBA_OUTPUT_BATCH];
+    for (;;) {
+        ObaMessageHeader header;
+        if (protocol_read_header(fd, &header, OBA_MAX_MESSAGE) != 0) return -1;
+
+        switch (header.type) {
+            case OBA_MSG_OUTPUT: {
+                if (header.length > sizeof(values) || header.length % sizeof(int32_t) != 0) return -1;
+                if (protocol_read(fd, values, header.length) != 0) return -1;
+                if (output) output(user_data, values, (int)(header.length / sizeof(int32_t)));
+                break;
+            }
+            case OBA_MSG_DONE: {
+                if (header.length < sizeof(*result) ||
+                    protocol_read(fd, result, sizeof(*result)) != 0) {
+                    return -1;
+                }
+                // The message, cut to fit 'error'
+                size_t length = header.length - sizeof(*result);
+                size_t kept = error_size == 0 ? 0 : length < error_size ? length : error_size - 1;
+                if (error_size > 0) {
+                    if (protocol_read(fd, error, kept) != 0) return -1;
+                    error[kept] = '\0';
+                }
+                char discard[256];
+                for (length -= kept; length > 0; ) {
+                    size_t n = length < sizeof(discard) ? length : sizeof(discard);
+                    if (protocol_read(fd, discard, n) != 0) return -1;
+                    length -= n;
+                }
+                return 0;
+            }
+            case OBA_MSG_UNKNOWN:
+                return header.length == 0 ? 1 : -1;
+            default:
+                return -1;
+        }
+    }
+}
+
+int protocol_run(int fd, uint64_t hash, const char *source, size_t source_length,
+                 const char *input, size_t input_length, ProtocolOutputFn output, void *user_data,
+                 ObaRunResult *result, char *error, size_t error_size) {
+    ObaRunRequest request = { hash, 0, (uint32_t)input_length };
+    struct iovec parts[3] = {
+        { &request, sizeof(request) },
+        { (void*)source, 0 },
+        { (void*)input, input_length },
+    };
+
+    // By hash alone first, then with the source
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (attempt == 1) {
+            request.source_length = (uint32_t)source_length;
+            parts[1].iov_len = source_length;
+        }
+        if (protocol_send(fd, OBA_MSG_RUN, parts, 3) != 0) return -1;
+        int answer = read_answer(fd, output, user_data, result, error, error_size);
+        if (answer <= 0) return answer;
+    }
+    return -1; // Unknown even with its source
+}
@@ -0,0 +1,476 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include "oba_server.h"
+#include "oba_protocol.h"
+#include "program_cache.h"
+#include "snapshot.h"
+
+// Connections ready for a worker, first come first served
+typedef struct {
+    int *fds;
+    int head;
+    int count;
+    int capacity; // A power of two
+} ConnectionQueue;
+
+struct ObaServer {
+    struct sockaddr_un address; // Where it listens ('sun_path' is emptied if the file is not ours to remove)
+    int listen_fd;
+    int wake[2];  // Workers hand connections back (and oba_server_stop writes -1) here
+    int worker_count;
+    long long max_statements; // Per request, or 0
+    ProgramCache *cache;
+
+    pthread_mutex_t lock;     // Guards the queue, 'stopping' and 'requests'
+    pthread_cond_t ready;
+    ConnectionQueue queue;
+    int stopping;
+    long long requests;
+
+    // Connections waiting for their next request, watched by oba_server_run
+    int *idle;
+    int idle_count;
+    int idle_capacity;
+};
+
+// One worker thread's reusable buffers
+typedef struct {
+    ObaServer *server;
+    char *request;      // Payload of the request being served
+    size_t request_capacity;
+    char *source;       // Its source, NUL-terminated for the compiler
+    size_t source_capacity;
+
+    // print() values not yet sent
+    int fd;
+    int32_t output[OBA_OUTPUT_BATCH];
+    int output_count;
+    int send_failed;
+
+    long long fuel_granted;  // Statements the run in progress has been allowed so far
+    char stop_reason[96];    // Why the fuel callback stopped it, or ""
+} Worker;
+
+// --- Connection Lists ---
+
+static int queue_push(ConnectionQueue *q, int fd) {
+    if (q->count == q->capacity) {
+        int capacity = q->capacity ? q->capacity * 2 : 64;
+        int *fds = (int*)malloc(capacity * sizeof(int));
+        if (!fds) return -1;
+        for (int i = 0; i < q->count; i++) {
+            fds[i] = q->fds[(q->head + i) & (q->capacity - 1)];
+        }
+        free(q->fds);
+        q->fds = fds;
+        q->head = 0;
+        q->capacity = capacity;
+    }
+    q->fds[(q->head + q->count) & (q->capacity - 1)] = fd;
+    q->count++;
+    return 0;
+}
+
+static int queue_pop(ConnectionQueue *q) {
+    int fd = q->fds[q->head];
+    q->head = (q->head + 1) & (q->capacity - 1);
+    q->count--;
+    return fd;
+}
+
+static int add_idle(ObaServer *server, int fd) {
+    if (server->idle_count == server->idle_capacity) {
+        int capacity = server->idle_capacity ? server->idle_capacity * 2 : 64;
+        int *grown = (int*)realloc(server->idle, capacity * sizeof(int));
+        if (!grown) return -1;
+        server->idle = grown;
+        server->idle_capacity = capacity;
+    }
+    server->idle[server->idle_count++] = fd;
+    return 0;
+}
+
+// --- Serving a Request ---
+
+static int reserve(char **buffer, size_t *capacity, size_t size) {
+    if (size <= *capacity) return 0;
+    char *grown = (char*)realloc(*buffer, size);
+    if (!grown) return -1;
+    *buffer = grown;
+    *capacity = size;
+    return 0;
+}
+
+static void flush_output(Worker *w) {
+    if (w->output_count == 0) return;
+    struct iovec part = { w->output, w->output_count * sizeof(int32_t) };
+    if (!w->send_failed && protocol_send(w->fd, OBA_MSG_OUTPUT, &part, 1) != 0) w->send_failed = 1;
+    w->output_count = 0;
+}
+
+// The contexts' output callback: values go out in batches while the script runs
+static void stream_value(void *user_data, int value) {
+    Worker *w = (Worker*)user_data;
+    w->output[w->output_count++] = value;
+    if (w->output_count == OBA_OUTPUT_BATCH) flush_output(w);
+}
+
+// Grants the run its next slice, capped by what is left of the request's budget
+static long long grant_fuel(Worker *w) {
+    long long slice = OBA_SERVER_FUEL_SLICE;
+    long long max = w->server->max_statements;
+    if (max > 0 && slice > max - w->fuel_granted) slice = max - w->fuel_granted;
+    w->fuel_granted += slice;
+    return slice;
+}
+
+// The contexts' fuel callback: ends runs that are over budget, whose client has
+// gone, or that would keep oba_server_stop waiting
+static long long refuel_run(void *user_data) {
+    Worker *w = (Worker*)user_data;
+    pthread_mutex_lock(&w->server->lock);
+    int stopping = w->server->stopping;
+    pthread_mutex_unlock(&w->server->lock);
+
+    long long slice = 0;
+    if (stopping) {
+        snprintf(w->stop_reason, sizeof(w->stop_reason), "The server is shutting down.");
+    } else if (w->send_failed) {
+        snprintf(w->stop_reason, sizeof(w->stop_reason), "The client stopped reading the output.");
+    } else if ((slice = grant_fuel(w)) <= 0) {
+        snprintf(w->stop_reason, sizeof(w->stop_reason), "Exceeded the limit of %lld statements.",
+                 w->server->max_statements);
+    }
+    return slice;
+}
+
+static int send_done(Worker *w, int status, uint32_t flags, const char *message) {
+    ObaRunResult result = { status, flags };
+    struct iovec parts[2] = {
+        { &result, sizeof(result) },
+        { (void*)message, strlen(message) },
+    };
+    if (w->send_failed || protocol_send(w->fd, OBA_MSG_DONE, parts, 2) != 0) return -1;
+    return 0;
+}
+
+// Finds or compiles the request's program. Returns NULL after answering the
+// request itself (hash unknown, or a compile error); 'answered' then says
+// whether that answer reached the client.
+static CachedProgram* lookup_program(Worker *w, const ObaRunRequest *request, const char *source,
+                                     uint32_t *flags, int *answered) {
+    ProgramCache *cache = w->server->cache;
+    *answered = 0;
+
+    if (request->source_length == 0) {
+        CachedProgram *entry = program_cache_get(cache, request->hash, NULL, 0);
+        if (entry) {
+            *flags |= OBA_RESULT_CACHED;
+            return entry;
+        }
+        *answered = protocol_send(w->fd, OBA_MSG_UNKNOWN, NULL, 0) == 0;
+        return NULL;
+    }
+
+    // The compiler needs the source NUL-terminated
+    if (reserve(&w->source, &w->source_capacity, request->source_length + 1) != 0) {
+        *answered = send_done(w, -1, 0, "out of memory") == 0;
+        return NULL;
+    }
+    memcpy(w->source, source, request->source_length);
+    w->source[request->source_length] = '\0';
+    uint64_t hash = snapshot_hash_program(w->source);
+
+    CachedProgram *entry = program_cache_get(cache, hash, w->source, request->source_length);
+    if (entry) {
+        *flags |= OBA_RESULT_CACHED;
+        return entry;
+    }
+
+    char error[256];
+    ObaProgram *program = oba_compile(w->source, error, sizeof(error));
+    if (program) entry = program_cache_insert(cache, hash, program, w->source, request->source_length);
+    if (!entry) *answered = send_done(w, -1, 0, program ? "out of memory" : error) == 0;
+    return entry;
+}
+
+// Reads one request from the connection and answers it. Returns 0 if the
+// connection can take another, or -1 to close it.
+static int serve_request(Worker *w, int fd) {
+    ObaMessageHeader header;
+    ObaRunRequest request;
+    if (protocol_read_header(fd, &header, OBA_MAX_MESSAGE) != 0 || header.type != OBA_MSG_RUN ||
+        header.length < sizeof(request) ||
+        reserve(&w->request, &w->request_capacity, header.length) != 0 ||
+        protocol_read(fd, w->request, header.length) != 0) {
+        return -1;
+    }
+    memcpy(&request, w->request, sizeof(request));
+    if ((uint64_t)request.source_length + request.input_length != header.length - sizeof(request)) {
+        return -1;
+    }
+    const char *source = w->request + sizeof(request);
+    const char *input = source + request.source_length;
+
+    pthread_mutex_lock(&w->server->lock);
+    w->server->requests++;
+    pthread_mutex_unlock(&w->server->lock);
+
+    w->fd = fd;
+    w->output_count = 0;
+    w->send_failed = 0;
+    uint32_t flags = 0;
+    int answered;
+    CachedProgram *entry = lookup_program(w, &request, source, &flags, &answered);
+    if (!entry) return answered ? 0 : -1;
+
+    ObaContext *ctx = program_cache_context(w->server->cache, entry);
+    if (!ctx) {
+        program_cache_release(w->server->cache, entry, NULL);
+        return send_done(w, -1, flags, "out of memory");
+    }
+    oba_context_set_output(ctx, stream_value, w);
+    w->fuel_granted = 0;
+    w->stop_reason[0] = '\0';
+    oba_context_set_fuel(ctx, grant_fuel(w), refuel_run, w);
+    int status = oba_context_set_input(ctx, input, request.input_length);
+    if (status == 0) status = oba_run(entry->program, ctx);
+    flush_output(w);
+    const char *message = status == 0 ? "" : w->stop_reason[0] ? w->stop_reason : oba_context_error(ctx);
+    int sent = send_done(w, status, flags, message);
+
+    // The input refers to this request's buffer, so it does not outlive the run
+    oba_context_set_input(ctx, "", 0);
+    oba_context_set_fuel(ctx, 0, NULL, NULL);
+    oba_context_reset(ctx);
+    program_cache_release(w->server->cache, entry, ctx);
+    return sent;
+}
+
+// --- Workers ---
+
+static void* worker_main(void *arg) {
+    Worker *w = (Worker*)arg;
+    ObaServer *server = w->server;
+
+    for (;;) {
+        pthread_mutex_lock(&server->lock);
+        while (!server->stopping && server->queue.count == 0) {
+            pthread_cond_wait(&server->ready, &server->lock);
+        }
+        if (server->stopping) {
+            pthread_mutex_unlock(&server->lock);
+            break;
+        }
+        int fd = queue_pop(&server->queue);
+        pthread_mutex_unlock(&server->lock);
+
+        if (serve_request(w, fd) == 0) {
+            // Back to the poll set to wait for its next request
+            if (write(server->wake[1], &fd, sizeof(fd)) != sizeof(fd)) close(fd);
+        } else {
+            close(fd);
+        }
+    }
+
+    free(w->request);
+    free(w->source);
+    return NULL;
+}
+
+// --- Server ---
+
+ObaServer* oba_server_create(const ObaServerOptions *options) {
+    const char *path = options->socket_path ? options->socket_path : OBA_DEFAULT_SOCKET;
+    ObaServer *server = (ObaServer*)calloc(1, sizeof(ObaServer));
+    if (!server) return NULL;
+    server->listen_fd = -1;
+    server->wake[0] = server->wake[1] = -1;
+    pthread_mutex_init(&server->lock, NULL);
+    pthread_cond_init(&server->ready, NULL);
+
+    if (strlen(path) >= sizeof(server->address.sun_path)) {
+        fprintf(stderr, "Error: Socket path '%s' is too long.\n", path);
+        oba_server_free(server);
+        return NULL;
+    }
+    server->address.sun_family = AF_UNIX;
+    strcpy(server->address.sun_path, path);
+
+    server->worker_count = options->workers;
+    server->max_statements = options->max_statements > 0 ? options->max_statements : 0;
+    if (server->worker_count <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        server->worker_count = cpus > 0 ? (int)cpus : 1;
+    }
+    server->cache = program_cache_create(options->cache_size > 0 ? options->cache_size : OBA_SERVER_DEFAULT_CACHE);
+    if (!server->cache || pipe(server->wake) != 0) {
+        fprintf(stderr, "Error: Could not set up the server.\n");
+        oba_server_free(server);
+        return NULL;
+    }
+    fcntl(server->wake[0], F_SETFL, O_NONBLOCK);
+
+    // A socket file nobody answers on is left over from a server that died: replace it
+    int other = protocol_connect(path);
+    if (other >= 0) {
+        close(other);
+        fprintf(stderr, "Error: A server is already listening on '%s'.\n", path);
+        server->address.sun_path[0] = '\0'; // Not ours to remove
+        oba_server_free(server);
+        return NULL;
+    }
+    unlink(path);
+
+    server->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server->listen_fd < 0 ||
+        bind(server->listen_fd, (struct sockaddr*)&server->address, sizeof(server->address)) != 0 ||
+        listen(server->listen_fd, SOMAXCONN) != 0) {
+        fprintf(stderr, "Error: Could not listen on '%s': %s\n", path, strerror(errno));
+        if (server->listen_fd >= 0) close(server->listen_fd);
+        server->listen_fd = -1;
+        server->address.sun_path[0] = '\0';
+        oba_server_free(server);
+        return NULL;
+    }
+    fcntl(server->listen_fd, F_SETFL, O_NONBLOCK);
+    return server;
+}
+
+void oba_server_stop(ObaServer *server) {
+    int stop = -1;
+    ssize_t written = write(server->wake[1], &stop, sizeof(stop));
+    (void)written; // The pipe only fills up if the server is already stuck
+}
+
+// Accepts every connection waiting on the listening socket
+static void accept_connections(ObaServer *server) {
+    struct timeval timeout = { OBA_SERVER_READ_TIMEOUT, 0 };
+    for (;;) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            return; // EAGAIN, or out of descriptors until some close
+        }
+        int flags = fcntl(fd, F_GETFL);
+        fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        if (add_idle(server, fd) != 0) close(fd);
+    }
+}
+
+// Takes back connections the workers have finished with. Returns 1 once stop was asked for.
+static int read_wake_pipe(ObaServer *server) {
+    int fd, stop = 0;
+    while (read(server->wake[0], &fd, sizeof(fd)) == sizeof(fd)) {
+        if (fd < 0) stop = 1;
+        else if (add_idle(server, fd) != 0) close(fd);
+    }
+    return stop;
+}
+
+int oba_server_run(ObaServer *server) {
+    Worker *workers = (Worker*)calloc(server->worker_count, sizeof(Worker));
+    pthread_t *threads = (pthread_t*)malloc(server->worker_count * sizeof(pthread_t));
+    struct pollfd *fds = NULL;
+    int fds_capacity = 0;
+    int started = 0;
+    if (workers && threads) {
+        for (; started < server->worker_count; started++) {
+            workers[started].server = server;
+            if (pthread_create(&threads[started], NULL, worker_main, &workers[started]) != 0) break;
+        }
+    }
+    int result = started > 0 ? 0 : -1;
+
+    int stop = started == 0;
+    while (!stop) {
+        // The listening socket, the wake pipe, then every idle connection
+        int count = 2 + server->idle_count;
+        if (count > fds_capacity) {
+            struct pollfd *grown = (struct pollfd*)realloc(fds, count * 2 * sizeof(struct pollfd));
+            if (!grown) break;
+            fds = grown;
+            fds_capacity = count * 2;
+        }
+        fds[0].fd = server->listen_fd;
+        fds[1].fd = server->wake[0];
+        for (int i = 0; i < server->idle_count; i++) fds[2 + i].fd = server->idle[i];
+        for (int i = 0; i < count; i++) fds[i].events = POLLIN;
+
+        if (poll(fds, count, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        // Connections with a request (or a hang-up) go to the workers
+        int kept = 0;
+        pthread_mutex_lock(&server->lock);
+        for (int i = 0; i < server->idle_count; i++) {
+            int fd = server->idle[i];
+            if (fds[2 + i].revents == 0) {
+                server->idle[kept++] = fd;
+            } else if (queue_push(&server->queue, fd) != 0) {
+                close(fd);
+            }
+        }
+        server->idle_count = kept;
+        pthread_cond_broadcast(&server->ready);
+        pthread_mutex_unlock(&server->lock);
+
+        if (fds[1].revents) stop = read_wake_pipe(server);
+        if (fds[0].revents) accept_connections(server);
+    }
+
+    // Runs in progress see 'stopping' at their next fuel check and end; then drop every connection
+    pthread_mutex_lock(&server->lock);
+    server->stopping = 1;
+    pthread_cond_broadcast(&server->ready);
+    pthread_mutex_unlock(&server->lock);
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+
+    read_wake_pipe(server);
+    while (server->queue.count > 0) close(queue_pop(&server->queue));
+    for (int i = 0; i < server->idle_count; i++) close(server->idle[i]);
+    server->idle_count = 0;
+
+    free(fds);
+    free(threads);
+    free(workers);
+    return result;
+}
+
+void oba_server_free(ObaServer *server) {
+    if (!server) return;
+    if (server->listen_fd >= 0) close(server->listen_fd);
+    if (server->address.sun_path[0]) unlink(server->address.sun_path);
+    if (server->wake[0] >= 0) close(server->wake[0]);
+    if (server->wake[1] >= 0) close(server->wake[1]);
+    program_cache_free(server->cache);
+    free(server->queue.fds);
+    free(server->idle);
+    pthread_mutex_destroy(&server->lock);
+    pthread_cond_destroy(&server->ready);
+    free(server);
+}
+
+void oba_server_stats(ObaServer *server, ObaServerStats *stats) {
+    pthread_mutex_lock(&server->lock);
+    stats->requests = server->requests;
+    pthread_mutex_unlock(&server->lock);
+
+    pthread_mutex_lock(&server->cache->lock);
+    stats->cache_hits = server->cache->hits;
+    stats->cache_misses = server->cache->misses;
+    stats->evictions = server->cache->evictions;
+    pthread_mutex_unlock(&server->cache->lock);
+}
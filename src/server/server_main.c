@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include "oba_server.h"
+#include "oba_protocol.h"
+
+// oba_server: serves compile-and-run requests on a Unix domain socket until
+// interrupted. See oba_client for a client and oba_loadtest for a benchmark.
+
+static ObaServer *running_server;
+
+static void handle_signal(int signal_number) {
+    (void)signal_number;
+    oba_server_stop(running_server);
+}
+
+static void print_usage(const char *program_name) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --socket=PATH         Listen on PATH (default: %s)\n"
+            "  --workers=N           Run scripts on N threads (default: one per CPU)\n"
+            "  --cache=N             Keep up to N compiled programs (default: %d)\n"
+            "  --max-statements=N    End a request with an error after N statements (default: no limit)\n",
+            program_name, OBA_DEFAULT_SOCKET, OBA_SERVER_DEFAULT_CACHE);
+}
+
+int main(int argc, char **argv) {
+    ObaServerOptions options;
+    memset(&options, 0, sizeof(options));
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--socket=", 9) == 0) {
+            options.socket_path = arg + 9;
+        } else if (strncmp(arg, "--workers=", 10) == 0 && atoi(arg + 10) > 0) {
+            options.workers = atoi(arg + 10);
+        } else if (strncmp(arg, "--cache=", 8) == 0 && atoi(arg + 8) > 0) {
+            options.cache_size = atoi(arg + 8);
+        } else if (strncmp(arg, "--max-statements=", 17) == 0 && atoll(arg + 17) > 0) {
+            options.max_statements = atoll(arg + 17);
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    running_server = oba_server_create(&options);
+    if (!running_server) return 1;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_signal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    printf("[SERVER] Listening on '%s'\n", options.socket_path ? options.socket_path : OBA_DEFAULT_SOCKET);
+    fflush(stdout);
+    int result = oba_server_run(running_server);
+
+    ObaServerStats stats;
+    oba_server_stats(running_server, &stats);
+    printf("[SERVER] %lld requests, %lld cache hits, %lld misses, %lld evictions\n",
+           stats.requests, stats.cache_hits, stats.cache_misses, stats.evictions);
+    oba_server_free(running_server);
+    if (result != 0) fprintf(stderr, "Error: Could not start the worker threads.\n");
+    return result != 0;
+}
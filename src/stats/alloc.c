@@ -0,0 +1,52 @@
+#include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+
+static uint64_t allocated_total = 0;
+
+// --- Counting ---
+
+// A relaxed atomic add: workers of --threads and parallel for allocate concurrently
+// and only the total matters, not its order against other memory operations.
+void allocation_count_add(size_t size) {
+#if defined(__GNUC__)
+    __atomic_fetch_add(&allocated_total, (uint64_t)size, __ATOMIC_RELAXED);
+#else
+    allocated_total += size;
+#endif
+}
+
+uint64_t allocated_bytes_total(void) {
+#if defined(__GNUC__)
+    return __atomic_load_n(&allocated_total, __ATOMIC_RELAXED);
+#else
+    return allocated_total;
+#endif
+}
+
+// --- Allocation ---
+
+void* counted_malloc(size_t size) {
+    void *ptr = malloc(size);
+    if (ptr) allocation_count_add(size);
+    return ptr;
+}
+
+void* counted_calloc(size_t count, size_t size) {
+    void *ptr = calloc(count, size);
+    if (ptr) allocation_count_add(count * size);
+    return ptr;
+}
+
+void* counted_realloc(void *ptr, size_t size) {
+    void *grown = realloc(ptr, size);
+    if (grown) allocation_count_add(size);
+    return grown;
+}
+
+char* counted_strdup(const char *s) {
+    size_t length = strlen(s) + 1;
+    char *copy = (char*)counted_malloc(length);
+    if (copy) memcpy(copy, s, length);
+    return copy;
+}
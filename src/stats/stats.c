@@ -0,0 +1,189 @@
+#define _GNU_SOURCE // For syscall() and perf_event_open
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "stats.h"
+#include "alloc.h"
+
+#if defined(__linux__)
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+static const char *phase_names[PHASE_COUNT] = { "lex", "parse", "semantic", "execute" };
+static const char *counter_names[COUNTER_COUNT] = { "cycles", "instructions", "cache_misses", "branch_misses" };
+
+// --- Readings ---
+
+static double clock_ms(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// Bytes currently allocated through malloc, or -1 where the C library cannot tell us
+static long long heap_in_use(void) {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    return (long long)(info.uordblks + info.hblkhd); // Small blocks plus large mmap'd ones
+#else
+    return -1;
+#endif
+}
+
+static uint64_t read_counter(int fd) {
+    uint64_t value = 0;
+    if (fd >= 0 && read(fd, &value, sizeof(value)) != (ssize_t)sizeof(value)) value = 0;
+    return value;
+}
+
+// --- Setup ---
+
+#if defined(__linux__)
+// Opens one user-space hardware counter for this process, or returns -1. The
+// counter also counts threads created after it is opened (--threads workers and
+// parallel for pools), once each has exited, so stats_init must run before any.
+static int open_counter(uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.inherit = 1;
+
+    long fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd < 0) return -1;
+    ioctl((int)fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl((int)fd, PERF_EVENT_IOC_ENABLE, 0);
+    return (int)fd;
+}
+#endif
+
+void stats_init(Stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->heap_available = heap_in_use() >= 0;
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        stats->perf_fds[i] = -1;
+    }
+
+    // Containers and locked-down kernels (perf_event_paranoid) commonly refuse these;
+    // the counters are then simply left out of the report.
+#if defined(__linux__)
+    static const uint64_t configs[COUNTER_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES,
+    };
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        stats->perf_fds[i] = open_counter(configs[i]);
+    }
+#endif
+}
+
+void stats_close(Stats *stats) {
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        if (stats->perf_fds[i] >= 0) close(stats->perf_fds[i]);
+        stats->perf_fds[i] = -1;
+    }
+}
+
+// --- Measurement ---
+
+void stats_begin(Stats *stats) {
+    stats->start_heap_bytes = heap_in_use();
+    stats->start_allocated_bytes = allocated_bytes_total();
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        stats->start_counters[i] = read_counter(stats->perf_fds[i]);
+    }
+    stats->start_cpu_ms = clock_ms(CLOCK_PROCESS_CPUTIME_ID);
+    stats->start_wall_ms = clock_ms(CLOCK_MONOTONIC);
+}
+
+void stats_end(Stats *stats, StatsPhase phase) {
+    double wall = clock_ms(CLOCK_MONOTONIC);
+    double cpu = clock_ms(CLOCK_PROCESS_CPUTIME_ID);
+    PhaseStats *ps = &stats->phases[phase];
+
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        ps->counters[i] += read_counter(stats->perf_fds[i]) - stats->start_counters[i];
+    }
+    ps->wall_ms += wall - stats->start_wall_ms;
+    ps->cpu_ms += cpu - stats->start_cpu_ms;
+
+    ps->allocated_bytes += allocated_bytes_total() - stats->start_allocated_bytes;
+    if (stats->heap_available) ps->net_heap_bytes += heap_in_use() - stats->start_heap_bytes;
+}
+
+// --- Reporting ---
+
+void stats_report(Stats *stats, FILE *out, int json) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        stats->peak_rss_kb = usage.ru_maxrss; // Kilobytes on Linux
+    }
+
+    int perf_available = 0;
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        if (stats->perf_fds[i] >= 0) perf_available = 1;
+    }
+
+    if (json) {
+        fprintf(out, "{\"tokens\":%d,\"nodes\":%d,\"peak_rss_kb\":%ld,\"perf_available\":%s,\"phases\":{",
+                stats->token_count, stats->node_count, stats->peak_rss_kb, perf_available ? "true" : "false");
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            PhaseStats *ps = &stats->phases[p];
+            fprintf(out, "%s\"%s\":{\"wall_ms\":%.3f,\"cpu_ms\":%.3f,\"net_heap_bytes\":",
+                    p ? "," : "", phase_names[p], ps->wall_ms, ps->cpu_ms);
+            if (!stats->heap_available) fprintf(out, "null");
+            else fprintf(out, "%lld", ps->net_heap_bytes);
+            fprintf(out, ",\"allocated_bytes\":%llu", (unsigned long long)ps->allocated_bytes);
+
+            for (int i = 0; i < COUNTER_COUNT; i++) {
+                fprintf(out, ",\"%s\":", counter_names[i]);
+                if (stats->perf_fds[i] < 0) fprintf(out, "null");
+                else fprintf(out, "%llu", (unsigned long long)ps->counters[i]);
+            }
+            fprintf(out, "}");
+        }
+        fprintf(out, "}}\n");
+        return;
+    }
+
+    fprintf(out, "\n--- Oba-C Statistics ---\n");
+    fprintf(out, "%-10s %10s %10s %14s %15s", "phase", "wall_ms", "cpu_ms", "net_heap_bytes", "allocated_bytes");
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        fprintf(out, " %14s", counter_names[i]);
+    }
+    fprintf(out, "\n");
+
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        PhaseStats *ps = &stats->phases[p];
+        fprintf(out, "%-10s %10.3f %10.3f", phase_names[p], ps->wall_ms, ps->cpu_ms);
+        if (!stats->heap_available) fprintf(out, " %14s", "n/a");
+        else fprintf(out, " %14lld", ps->net_heap_bytes);
+        fprintf(out, " %15llu", (unsigned long long)ps->allocated_bytes);
+
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            if (stats->perf_fds[i] < 0) fprintf(out, " %14s", "n/a");
+            else fprintf(out, " %14llu", (unsigned long long)ps->counters[i]);
+        }
+        fprintf(out, "\n");
+    }
+
+    fprintf(out, "tokens: %d, AST nodes: %d, peak RSS: %ld KB\n",
+            stats->token_count, stats->node_count, stats->peak_rss_kb);
+    if (!perf_available) {
+        fprintf(out, "(hardware counters unavailable: perf events are not permitted here)\n");
+    }
+}
@@ -0,0 +1,177 @@
+#include <stdlib.h>
+#include <string.h>
+#include "array.h"
+#include "alloc.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
+// --- Storage ---
+
+int* array_alloc(size_t count) {
+    void *data = NULL;
+    size_t bytes = count * sizeof(int);
+#if defined(_WIN32)
+    data = _aligned_malloc(bytes, ARRAY_ALIGNMENT);
+#else
+    if (posix_memalign(&data, ARRAY_ALIGNMENT, bytes) != 0) data = NULL;
+#endif
+    if (!data) return NULL;
+    allocation_count_add(bytes);
+    memset(data, 0, bytes);
+    return (int*)data;
+}
+
+void array_free(int *data) {
+#if defined(_WIN32)
+    _aligned_free(data);
+#else
+    free(data);
+#endif
+}
+
+// --- SIMD Helpers ---
+// SSE2 lacks 32-bit min/max/multiply, so fall back to equivalent sequences when
+// the build does not target SSE4.1.
+
+#if defined(__SSE2__)
+static inline __m128i vec_min(__m128i a, __m128i b) {
+#if defined(__SSE4_1__)
+    return _mm_min_epi32(a, b);
+#else
+    __m128i a_greater = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(a_greater, b), _mm_andnot_si128(a_greater, a));
+#endif
+}
+
+static inline __m128i vec_max(__m128i a, __m128i b) {
+#if defined(__SSE4_1__)
+    return _mm_max_epi32(a, b);
+#else
+    __m128i a_greater = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(a_greater, a), _mm_andnot_si128(a_greater, b));
+#endif
+}
+
+static inline __m128i vec_mullo(__m128i a, __m128i b) {
+#if defined(__SSE4_1__)
+    return _mm_mullo_epi32(a, b);
+#else
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+#endif
+}
+
+// Folds the four lanes of 'v' into lane 0 using 'op'
+#define VEC_REDUCE(v, op) \
+    do { \
+        (v) = op((v), _mm_shuffle_epi32((v), _MM_SHUFFLE(1, 0, 3, 2))); \
+        (v) = op((v), _mm_shuffle_epi32((v), _MM_SHUFFLE(2, 3, 0, 1))); \
+    } while (0)
+#endif
+
+// --- Bulk Kernels ---
+// Each kernel runs two 4-lane accumulators per iteration, then finishes the tail in scalar code.
+
+int array_sum(const int *data, int count) {
+    int i = 0;
+    unsigned int total = 0;
+#if defined(__SSE2__)
+    __m128i acc0 = _mm_setzero_si128();
+    __m128i acc1 = _mm_setzero_si128();
+    for (; i + 8 <= count; i += 8) {
+        acc0 = _mm_add_epi32(acc0, _mm_loadu_si128((const __m128i*)(data + i)));
+        acc1 = _mm_add_epi32(acc1, _mm_loadu_si128((const __m128i*)(data + i + 4)));
+    }
+    acc0 = _mm_add_epi32(acc0, acc1);
+    VEC_REDUCE(acc0, _mm_add_epi32);
+    total = (unsigned int)_mm_cvtsi128_si32(acc0);
+#endif
+    for (; i < count; i++) {
+        total += (unsigned int)data[i];
+    }
+    return (int)total;
+}
+
+int array_min(const int *data, int count) {
+    int i = 0;
+    int result = data[0];
+#if defined(__SSE2__)
+    if (count >= 8) {
+        __m128i acc0 = _mm_loadu_si128((const __m128i*)data);
+        __m128i acc1 = _mm_loadu_si128((const __m128i*)(data + 4));
+        for (i = 8; i + 8 <= count; i += 8) {
+            acc0 = vec_min(acc0, _mm_loadu_si128((const __m128i*)(data + i)));
+            acc1 = vec_min(acc1, _mm_loadu_si128((const __m128i*)(data + i + 4)));
+        }
+        acc0 = vec_min(acc0, acc1);
+        VEC_REDUCE(acc0, vec_min);
+        result = _mm_cvtsi128_si32(acc0);
+    }
+#endif
+    for (; i < count; i++) {
+        if (data[i] < result) result = data[i];
+    }
+    return result;
+}
+
+int array_max(const int *data, int count) {
+    int i = 0;
+    int result = data[0];
+#if defined(__SSE2__)
+    if (count >= 8) {
+        __m128i acc0 = _mm_loadu_si128((const __m128i*)data);
+        __m128i acc1 = _mm_loadu_si128((const __m128i*)(data + 4));
+        for (i = 8; i + 8 <= count; i += 8) {
+            acc0 = vec_max(acc0, _mm_loadu_si128((const __m128i*)(data + i)));
+            acc1 = vec_max(acc1, _mm_loadu_si128((const __m128i*)(data + i + 4)));
+        }
+        acc0 = vec_max(acc0, acc1);
+        VEC_REDUCE(acc0, vec_max);
+        result = _mm_cvtsi128_si32(acc0);
+    }
+#endif
+    for (; i < count; i++) {
+        if (data[i] > result) result = data[i];
+    }
+    return result;
+}
+
+void array_add(int *dst, const int *src, int count) {
+    int i = 0;
+#if defined(__SSE2__)
+    for (; i + 8 <= count; i += 8) {
+        __m128i a0 = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(dst + i + 4));
+        __m128i b0 = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i b1 = _mm_loadu_si128((const __m128i*)(src + i + 4));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_add_epi32(a0, b0));
+        _mm_storeu_si128((__m128i*)(dst + i + 4), _mm_add_epi32(a1, b1));
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = (int)((unsigned int)dst[i] + (unsigned int)src[i]);
+    }
+}
+
+void array_scale(int *data, int factor, int count) {
+    int i = 0;
+#if defined(__SSE2__)
+    __m128i k = _mm_set1_epi32(factor);
+    for (; i + 8 <= count; i += 8) {
+        __m128i a0 = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(data + i + 4));
+        _mm_storeu_si128((__m128i*)(data + i), vec_mullo(a0, k));
+        _mm_storeu_si128((__m128i*)(data + i + 4), vec_mullo(a1, k));
+    }
+#endif
+    for (; i < count; i++) {
+        data[i] = (int)((unsigned int)data[i] * (unsigned int)factor);
+    }
+}
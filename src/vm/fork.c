@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "fork.h"
+#include "array.h"
+#include "alloc.h"
+
+// Where image files go, first choice first
+static const char *image_templates[] = {
+    "/dev/shm/oba-image-XXXXXX",
+    "/tmp/oba-image-XXXXXX",
+};
+
+// Creates and unlinks a temporary file. Returns its descriptor, or -1.
+static int create_image_file(void) {
+    for (size_t i = 0; i < sizeof(image_templates) / sizeof(image_templates[0]); i++) {
+        char path[64];
+        snprintf(path, sizeof(path), "%s", image_templates[i]);
+        int fd = mkstemp(path);
+        if (fd >= 0) {
+            unlink(path);
+            return fd;
+        }
+    }
+    return -1;
+}
+
+VMImage* vm_image_create(const VirtualMachine *vm) {
+    VMImage *image = (VMImage*)counted_malloc(sizeof(VMImage));
+    if (!image) return NULL;
+    image->memory_size = vm->memory_size;
+    image->pc = vm->pc;
+    image->fd = -1;
+    if (vm->memory_size == 0) return image; // Nothing to share
+
+    image->fd = create_image_file();
+    if (image->fd < 0) {
+        fprintf(stderr, "Error: Could not create a VM image file.\n");
+        free(image);
+        return NULL;
+    }
+
+    const char *data = (const char*)vm->memory;
+    size_t left = (size_t)vm->memory_size * sizeof(int);
+    while (left > 0) {
+        ssize_t n = write(image->fd, data, left);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            fprintf(stderr, "Error: Could not write a VM image: %s\n", strerror(errno));
+            vm_image_free(image);
+            return NULL;
+        }
+        data += n;
+        left -= (size_t)n;
+    }
+    return image;
+}
+
+void vm_image_free(VMImage *image) {
+    if (!image) return;
+    if (image->fd >= 0) close(image->fd);
+    free(image);
+}
+
+VirtualMachine* vm_fork(const VMImage *image, SymbolTable *st) {
+    if (st->memory_size != image->memory_size) return NULL;
+
+    int *memory;
+    int is_mapped = image->memory_size > 0;
+    if (is_mapped) {
+        // Private mapping: reads share the image's pages, and a write copies just its page
+        void *mapped = mmap(NULL, (size_t)image->memory_size * sizeof(int), PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE, image->fd, 0);
+        if (mapped == MAP_FAILED) return NULL;
+        memory = (int*)mapped;
+    } else {
+        memory = array_alloc(0);
+        if (!memory) return NULL;
+    }
+
+    VirtualMachine *vm = vm_create_on(st, memory, is_mapped);
+    if (!vm) {
+        if (is_mapped) munmap(memory, (size_t)image->memory_size * sizeof(int));
+        else array_free(memory);
+        return NULL;
+    }
+    vm->pc = image->pc;
+    return vm;
+}
@@ -0,0 +1,237 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "input.h"
+#include "alloc.h"
+
+// --- Decimal Parsing ---
+
+static int is_digit(char c) {
+    return (unsigned char)(c - '0') < 10;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define INPUT_SWAR 1
+
+// If the 8 bytes at 's' are all digits, stores their value in *value and returns 1.
+// The bytes are handled as lanes of one 64-bit word (SWAR), so this costs a few
+// arithmetic operations instead of eight compare-and-branch steps.
+static inline int parse_eight_digits(const char *s, uint32_t *value) {
+    uint64_t chunk;
+    memcpy(&chunk, s, sizeof(chunk));
+
+    // A lane is a digit if subtracting '0' leaves 0..9: its top bit stays clear
+    // both then and after adding 0x76. Any non-digit lane sets one of them.
+    uint64_t digits = chunk - 0x3030303030303030ULL;
+    if ((digits | (digits + 0x7676767676767676ULL)) & 0x8080808080808080ULL) return 0;
+
+    // Combine neighbouring digits into pairs, then pairs into quads and halves
+    digits = (digits * 10) + (digits >> 8);
+    digits = (((digits & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+              (((digits >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+    *value = (uint32_t)digits;
+    return 1;
+}
+#endif
+
+// The parser behind input_parse_int, kept static so the read loop can inline it
+static inline const char* parse_decimal(const char *s, const char *end, int *value) {
+    int negative = (s < end && *s == '-');
+    s += negative;
+
+    uint32_t result = 0; // Unsigned so overflow wraps instead of being undefined
+#ifdef INPUT_SWAR
+    // Long digit runs (e.g. zero-padded fields) go eight at a time. Typical
+    // short numbers fail the check at once and take the loop below, whose
+    // one well-predicted branch per digit is faster for them.
+    uint32_t chunk;
+    while (end - s >= 8 && parse_eight_digits(s, &chunk)) {
+        result = result * 100000000u + chunk;
+        s += 8;
+    }
+#endif
+    while (s < end && is_digit(*s)) {
+        result = result * 10 + (uint32_t)(*s - '0');
+        s++;
+    }
+    *value = (int)(negative ? 0u - result : result);
+    return s;
+}
+
+const char* input_parse_int(const char *s, const char *end, int *value) {
+    return parse_decimal(s, end, value);
+}
+
+// Returns the start of the next number in s[0..end): a digit, or a '-' that is
+// followed by one or is the last byte (its digits may be in the next block).
+static const char* skip_separators(const char *s, const char *end) {
+    while (s < end) {
+        if (is_digit(*s)) break;
+        if (*s == '-' && (s + 1 == end || is_digit(s[1]))) break;
+        s++;
+    }
+    return s;
+}
+
+// --- Opening and Closing ---
+
+static InputReader* input_create(int fd, int owns_fd) {
+    InputReader *in = (InputReader*)counted_calloc(1, sizeof(InputReader));
+    if (!in) return NULL;
+    in->fd = fd;
+    in->owns_fd = owns_fd;
+
+    // A regular file is mapped whole, so numbers are parsed straight out of the page cache
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        off_t offset = lseek(fd, 0, SEEK_CUR); // Honour anything already consumed, e.g. on stdin
+        if (offset < 0) offset = 0;
+        if (st.st_size <= offset) {
+            in->at_eof = 1;
+            return in;
+        }
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+            madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+            in->data = (const char*)map;
+            in->pos = (size_t)offset;
+            in->origin = (size_t)offset;
+            in->len = (size_t)st.st_size;
+            in->mapped_size = (size_t)st.st_size;
+            in->at_eof = 1;
+        }
+    }
+    return in;
+}
+
+InputReader* input_open_fd(int fd) {
+    return input_create(fd, 0);
+}
+
+InputReader* input_open_file(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    InputReader *in = input_create(fd, 1);
+    if (!in) close(fd);
+    return in;
+}
+
+InputReader* input_open_memory(const char *data, size_t len) {
+    InputReader *in = input_create(-1, 0);
+    if (!in) return NULL;
+    in->data = data;
+    in->len = len;
+    in->at_eof = 1;
+    return in;
+}
+
+void input_close(InputReader *in) {
+    if (!in) return;
+    if (in->mapped_size) munmap((void*)in->data, in->mapped_size);
+    if (in->owns_fd) close(in->fd);
+    free(in->buffer);
+    free(in);
+}
+
+// --- Reading ---
+
+// Moves the unconsumed tail to the front of the block buffer and reads more after it.
+// Sets at_eof when the source is exhausted (or fails).
+static void input_refill(InputReader *in) {
+    if (in->at_eof) return;
+    if (in->fd < 0) {
+        in->at_eof = 1;
+        return;
+    }
+
+    size_t pending = in->len - in->pos;
+    if (!in->buffer || pending == in->capacity) {
+        // First block, or one number longer than the whole buffer
+        size_t capacity = in->capacity ? in->capacity * 2 : INPUT_BLOCK_SIZE;
+        char *grown = (char*)counted_realloc(in->buffer, capacity);
+        if (!grown) {
+            in->at_eof = 1;
+            return;
+        }
+        in->buffer = grown;
+        in->capacity = capacity;
+        in->data = grown;
+    }
+    if (pending) memmove(in->buffer, in->data + in->pos, pending);
+    in->dropped += in->pos;
+    in->pos = 0;
+    in->len = pending;
+
+    ssize_t n;
+    do {
+        n = read(in->fd, in->buffer + in->len, in->capacity - in->len);
+    } while (n < 0 && errno == EINTR);
+
+    if (n <= 0) {
+        in->at_eof = 1;
+    } else {
+        in->len += (size_t)n;
+    }
+}
+
+int input_read_array(InputReader *in, int *values, int count) {
+    int stored = 0;
+
+    while (stored < count) {
+        if (in->pos == in->len) {
+            if (in->at_eof) break;
+            input_refill(in);
+            continue;
+        }
+        const char *s = in->data + in->pos;
+        const char *end = in->data + in->len;
+
+        // Parse everything that is complete in the current block. A number that
+        // touches the end of the block might continue in the next one.
+        while (stored < count) {
+            s = skip_separators(s, end);
+            if (s == end || (*s == '-' && s + 1 == end)) break;
+
+            const char *after = parse_decimal(s, end, &values[stored]);
+            if (after == end && !in->at_eof) break;
+            s = after;
+            stored++;
+        }
+        in->pos = (size_t)(s - in->data);
+
+        if (stored == count) break;
+        if (in->at_eof) {
+            in->pos = in->len; // At most a lone '-' was left
+            break;
+        }
+        input_refill(in);
+    }
+    return stored;
+}
+
+int input_next(InputReader *in, int *value) {
+    return input_read_array(in, value, 1);
+}
+
+size_t input_consumed(const InputReader *in) {
+    return in->dropped + in->pos - in->origin;
+}
+
+int input_skip(InputReader *in, size_t bytes) {
+    while (bytes > in->len - in->pos) {
+        bytes -= in->len - in->pos;
+        in->pos = in->len;
+        if (in->at_eof) return -1;
+        input_refill(in);
+    }
+    in->pos += bytes;
+    return 0;
+}
@@ -0,0 +1,273 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "parallel.h"
+#include "depgraph.h"
+#include "alloc.h"
+
+// Everything one statement printed, held back until every statement before it has printed
+typedef struct {
+    char *text;       // [TRACE] lines and default print() output
+    size_t text_size;
+    int *values;      // print() values, when the VM has an output callback
+    int value_count;
+    int value_capacity;
+    int done;
+    char error[256];  // Message if the statement failed
+} StatementResult;
+
+typedef struct {
+    VirtualMachine *vm; // The VM the program runs on; workers share its memory
+    ASTNode *program;
+    DepGraph *graph;
+    StatementResult *results;
+
+    // Guarded by 'lock'
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int *waiting;       // Unfinished predecessors per statement
+    int *ready;         // FIFO of statements whose predecessors have all finished
+    int ready_head;
+    int ready_tail;
+    int running;
+    int first_failed;   // Lowest failed statement, or graph->count
+    int flushed;        // Statements whose output has been passed on
+} ParallelRun;
+
+// One executing thread: a worker VM plus the stream that captures its console output
+typedef struct {
+    ParallelRun *run;
+    VirtualMachine *vm;
+    char *buffer;
+    size_t buffer_size;
+    FILE *console;
+} Worker;
+
+// --- Output ---
+
+// A worker's output callback while its parent VM has one
+static void capture_value(void *user_data, int value) {
+    StatementResult *result = (StatementResult*)user_data;
+    if (result->value_count == result->value_capacity) {
+        int capacity = result->value_capacity ? result->value_capacity * 2 : 8;
+        int *grown = (int*)counted_realloc(result->values, capacity * sizeof(int));
+        if (!grown) return; // Drop the value rather than fail the run
+        result->values = grown;
+        result->value_capacity = capacity;
+    }
+    result->values[result->value_count++] = value;
+}
+
+// Passes on the output of every finished statement before 'end' that is next in
+// program order. Needs 'lock' while workers are running.
+static void flush_results(ParallelRun *run, int end) {
+    VirtualMachine *vm = run->vm;
+    while (run->flushed < end && run->results[run->flushed].done) {
+        StatementResult *result = &run->results[run->flushed++];
+        if (result->text_size) fwrite(result->text, 1, result->text_size, vm->console);
+        for (int i = 0; i < result->value_count; i++) {
+            vm->output(vm->output_data, result->values[i]);
+        }
+        free(result->text);
+        free(result->values);
+        result->text = NULL;
+        result->values = NULL;
+    }
+}
+
+// --- Workers ---
+
+// Runs statement 'i' on the worker. Returns 0, or -1 after a runtime error.
+static int run_statement(Worker *w, int i) {
+    ParallelRun *run = w->run;
+    StatementResult *result = &run->results[i];
+    VirtualMachine *vm = w->vm;
+
+    if (run->vm->output) vm->output_data = result;
+    rewind(w->console);
+
+    int status = 0;
+    if (setjmp(vm->error_jump)) {
+        vm->error_jump_set = 0;
+        snprintf(result->error, sizeof(result->error), "%s", vm->error_message);
+        vm_unwind(vm);
+        status = -1;
+    } else {
+        vm->error_jump_set = 1;
+        vm_execute_statement(vm, run->program->statements[run->graph->first + i]);
+        vm->error_jump_set = 0;
+    }
+
+    // Keep a copy of whatever the statement wrote to the console
+    fflush(w->console);
+    long written = ftell(w->console);
+    if (written > 0) {
+        result->text = (char*)counted_malloc((size_t)written);
+        if (result->text) {
+            memcpy(result->text, w->buffer, (size_t)written);
+            result->text_size = (size_t)written;
+        }
+    }
+    return status;
+}
+
+// Runs ready statements until none are left. The calling thread and every pool thread do this.
+static void work(Worker *w) {
+    ParallelRun *run = w->run;
+    DepGraph *graph = run->graph;
+
+    pthread_mutex_lock(&run->lock);
+    for (;;) {
+        // Nothing after a failed statement would have run sequentially
+        while (run->ready_head < run->ready_tail && run->ready[run->ready_head] > run->first_failed) {
+            run->ready_head++;
+        }
+        if (run->ready_head == run->ready_tail) {
+            if (run->running == 0) break;
+            pthread_cond_wait(&run->changed, &run->lock);
+            continue;
+        }
+
+        int i = run->ready[run->ready_head++];
+        run->running++;
+        pthread_mutex_unlock(&run->lock);
+        int status = run_statement(w, i);
+        pthread_mutex_lock(&run->lock);
+        run->running--;
+
+        if (status == 0) {
+            run->results[i].done = 1;
+            for (int e = graph->succ_start[i]; e < graph->succ_start[i + 1]; e++) {
+                int next = graph->succ[e];
+                if (--run->waiting[next] == 0) run->ready[run->ready_tail++] = next;
+            }
+            flush_results(run, graph->count);
+        } else if (i < run->first_failed) {
+            run->first_failed = i;
+        }
+        pthread_cond_broadcast(&run->changed);
+    }
+    pthread_cond_broadcast(&run->changed);
+    pthread_mutex_unlock(&run->lock);
+}
+
+static void* pool_thread(void *arg) {
+    work((Worker*)arg);
+    return NULL;
+}
+
+static int worker_init(Worker *w, ParallelRun *run) {
+    memset(w, 0, sizeof(*w));
+    w->run = run;
+    w->vm = vm_create_worker(run->vm);
+    w->console = open_memstream(&w->buffer, &w->buffer_size);
+    if (!w->vm || !w->console) return -1;
+
+    w->vm->console = w->console;
+    if (run->vm->output) w->vm->output = capture_value;
+    return 0;
+}
+
+static void worker_destroy(Worker *w) {
+    if (w->console) fclose(w->console);
+    free(w->buffer);
+    vm_destroy(w->vm);
+}
+
+// --- Entry Point ---
+
+// Returns 1 if the graph has enough independent work to pay for the threads
+static int worth_parallel(const DepGraph *graph) {
+    if (graph->total_cost < PARALLEL_MIN_WORK) return 0;
+    return graph->total_cost * 100 >= graph->critical_cost * PARALLEL_MIN_SPEEDUP_PERCENT;
+}
+
+void vm_execute_parallel(VirtualMachine *vm, ASTNode *program, int threads, int verbose) {
+    DepGraph *graph = threads > 1 ? depgraph_build(program, vm->symtab, vm->pc) : NULL;
+    int parallel = graph && worth_parallel(graph);
+    if (verbose && graph) {
+        fprintf(vm->console, "[PARALLEL] %d statements, estimated work %lld, longest chain %lld: %s\n",
+                graph->count, graph->total_cost, graph->critical_cost,
+                parallel ? "running in parallel" : "running sequentially");
+    }
+    if (!parallel) {
+        depgraph_free(graph);
+        vm_execute_program(vm, program);
+        return;
+    }
+
+    int n = graph->count;
+    ParallelRun run;
+    memset(&run, 0, sizeof(run));
+    run.vm = vm;
+    run.program = program;
+    run.graph = graph;
+    run.first_failed = n;
+    run.results = (StatementResult*)counted_calloc(n, sizeof(StatementResult));
+    run.waiting = (int*)counted_malloc(n * sizeof(int));
+    run.ready = (int*)counted_malloc(n * sizeof(int));
+    Worker *workers = (Worker*)counted_calloc(threads, sizeof(Worker));
+    if (!run.results || !run.waiting || !run.ready || !workers) {
+        vm_runtime_error(vm, "Out of memory for a parallel run.");
+    }
+    pthread_mutex_init(&run.lock, NULL);
+    pthread_cond_init(&run.changed, NULL);
+
+    for (int i = 0; i < n; i++) {
+        run.waiting[i] = graph->pred_count[i];
+        if (run.waiting[i] == 0) run.ready[run.ready_tail++] = i;
+    }
+
+    // Threads that cannot be set up are simply left out; the calling thread is worker 0
+    pthread_t *pool = (pthread_t*)counted_malloc(threads * sizeof(pthread_t));
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, PARALLEL_THREAD_STACK);
+    int started = 0;
+    if (worker_init(&workers[0], &run) != 0) {
+        vm_runtime_error(vm, "Out of memory for a parallel run.");
+    }
+    for (int t = 1; pool && t < threads; t++) {
+        if (worker_init(&workers[started + 1], &run) != 0 ||
+            pthread_create(&pool[started], &attr, pool_thread, &workers[started + 1]) != 0) {
+            worker_destroy(&workers[started + 1]);
+            break;
+        }
+        started++;
+    }
+    pthread_attr_destroy(&attr);
+
+    work(&workers[0]);
+    for (int t = 0; t < started; t++) {
+        pthread_join(pool[t], NULL);
+    }
+    for (int t = 0; t <= started; t++) {
+        worker_destroy(&workers[t]);
+    }
+
+    // Everything before the failed statement has been passed on. Its own output up
+    // to the error comes next, as it would sequentially; later statements' is dropped.
+    char error[256] = "";
+    if (run.first_failed < n) {
+        snprintf(error, sizeof(error), "%s", run.results[run.first_failed].error);
+        run.results[run.first_failed].done = 1;
+        flush_results(&run, run.first_failed + 1);
+    }
+    vm->pc = graph->first + run.first_failed;
+
+    for (int i = 0; i < n; i++) {
+        free(run.results[i].text);
+        free(run.results[i].values);
+    }
+    free(run.results);
+    free(run.waiting);
+    free(run.ready);
+    free(workers);
+    free(pool);
+    pthread_cond_destroy(&run.changed);
+    pthread_mutex_destroy(&run.lock);
+    depgraph_free(graph);
+
+    if (error[0]) vm_runtime_error(vm, "%s", error);
+}
@@ -0,0 +1,341 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include "parallel.h"
+#include "alloc.h"
+
+// What one grain printed, kept in the console buffer and value list of the
+// worker that ran it until every earlier grain has been passed on
+typedef struct {
+    int worker;
+    long text_start;  // [TRACE] lines and default print() output
+    long text_end;
+    int value_start;  // print() values, when the VM has an output callback
+    int value_end;
+    char error[256];  // Message if an iteration failed
+} GrainResult;
+
+typedef struct LoopRun LoopRun;
+
+// One executing thread: a worker VM, its private frame, its queue of grains,
+// and the streams that capture its output
+typedef struct {
+    LoopRun *run;
+    VirtualMachine *vm;
+    int *frame;
+
+    pthread_mutex_t lock; // Guards head and tail, which thieves move too
+    int head;             // Grains [head, tail) are this worker's to run
+    int tail;
+    unsigned seed;        // Picks where to start looking for work to steal
+
+    char *buffer;
+    size_t buffer_size;
+    FILE *console;
+    int *values;
+    int value_count;
+    int value_capacity;
+} LoopWorker;
+
+struct LoopRun {
+    VirtualMachine *vm; // The VM the loop runs on; workers share its memory
+    ASTNode *loop;
+    int from;
+    int to;
+    int grain_size;     // Iterations per grain (the last may be shorter)
+    int grain_count;
+    GrainResult *grains;
+    LoopWorker *workers;
+    int worker_count;
+
+    pthread_mutex_t lock;
+    int first_failed;   // Lowest failed grain, or grain_count. Guarded by 'lock'.
+};
+
+// --- Iterations ---
+
+// Sets up a frame for the loop with each reduction copy at its identity
+static void start_frame(const ASTNode *loop, int *frame) {
+    for (int r = 0; r < loop->reduction_count; r++) {
+        BuiltinType kind = loop->reductions[r].kind;
+        frame[1 + r] = kind == BUILTIN_MIN ? INT_MAX : kind == BUILTIN_MAX ? INT_MIN : 0;
+    }
+}
+
+// Runs iterations [first, last) in 'frame', which must be vm->frame. Each one
+// starts with the index set and its locals at zero, like a function call.
+static void run_iterations(VirtualMachine *vm, ASTNode *loop, int *frame, int first, int last) {
+    int locals = 1 + loop->reduction_count;
+    size_t locals_size = (size_t)(loop->frame_size - locals) * sizeof(int);
+    for (int i = first; i < last; i++) {
+        frame[0] = i;
+        memset(&frame[locals], 0, locals_size);
+        vm_execute_statement(vm, loop->body);
+    }
+}
+
+// Combines a frame's reduction copies into the globals they stand for
+static void merge_reductions(VirtualMachine *vm, const ASTNode *loop, const int *frame) {
+    for (int r = 0; r < loop->reduction_count; r++) {
+        int *global = &vm->memory[loop->reductions[r].slot];
+        int value = frame[1 + r];
+        switch (loop->reductions[r].kind) {
+            case BUILTIN_SUM: *global = (int)((unsigned)*global + (unsigned)value); break; // Wraps like '+'
+            case BUILTIN_MIN: if (value < *global) *global = value; break;
+            case BUILTIN_MAX: if (value > *global) *global = value; break;
+            default: break;
+        }
+    }
+}
+
+// --- Output ---
+
+// A worker's output callback while the loop's VM has one
+static void capture_value(void *user_data, int value) {
+    LoopWorker *w = (LoopWorker*)user_data;
+    if (w->value_count == w->value_capacity) {
+        int capacity = w->value_capacity ? w->value_capacity * 2 : 64;
+        int *grown = (int*)counted_realloc(w->values, capacity * sizeof(int));
+        if (!grown) return; // Drop the value rather than fail the run
+        w->values = grown;
+        w->value_capacity = capacity;
+    }
+    w->values[w->value_count++] = value;
+}
+
+// Passes on what grains [0, end) printed, in order
+static void flush_grains(LoopRun *run, int end) {
+    VirtualMachine *vm = run->vm;
+    for (int g = 0; g < end; g++) {
+        const GrainResult *result = &run->grains[g];
+        const LoopWorker *w = &run->workers[result->worker];
+        if (result->text_end > result->text_start) {
+            fwrite(w->buffer + result->text_start, 1, (size_t)(result->text_end - result->text_start), vm->console);
+        }
+        for (int i = result->value_start; i < result->value_end; i++) {
+            vm->output(vm->output_data, w->values[i]);
+        }
+    }
+}
+
+// --- Workers ---
+
+// Runs one grain's iterations on the worker, recording what they printed
+static void run_grain(LoopWorker *w, int g) {
+    LoopRun *run = w->run;
+    GrainResult *result = &run->grains[g];
+    VirtualMachine *vm = w->vm;
+    long long start = (long long)run->from + (long long)g * run->grain_size;
+    int first = (int)start;
+    int last = run->to - start > run->grain_size ? (int)(start + run->grain_size) : run->to;
+
+    result->worker = (int)(w - run->workers);
+    result->text_start = ftell(w->console);
+    result->value_start = w->value_count;
+
+    if (setjmp(vm->error_jump)) {
+        vm->error_jump_set = 0;
+        snprintf(result->error, sizeof(result->error), "%s", vm->error_message);
+        vm_unwind(vm);
+        vm->frame = w->frame;
+        pthread_mutex_lock(&run->lock);
+        if (g < run->first_failed) run->first_failed = g;
+        pthread_mutex_unlock(&run->lock);
+    } else {
+        vm->error_jump_set = 1;
+        run_iterations(vm, run->loop, w->frame, first, last);
+        vm->error_jump_set = 0;
+    }
+
+    fflush(w->console);
+    result->text_end = ftell(w->console);
+    result->value_end = w->value_count;
+}
+
+// Takes the next grain from the worker's own queue, or -1 if it is empty
+static int take_grain(LoopWorker *w) {
+    pthread_mutex_lock(&w->lock);
+    int g = w->head < w->tail ? w->head++ : -1;
+    pthread_mutex_unlock(&w->lock);
+    return g;
+}
+
+// Moves the back half of some other worker's grains into this worker's (empty)
+// queue. Returns 0, or -1 if every other queue is empty.
+static int steal_grains(LoopWorker *w) {
+    LoopRun *run = w->run;
+    int n = run->worker_count;
+    w->seed = w->seed * 1103515245u + 12345u;
+    int start = (int)((w->seed >> 16) % (unsigned)n);
+
+    for (int k = 0; k < n; k++) {
+        LoopWorker *victim = &run->workers[(start + k) % n];
+        if (victim == w) continue;
+
+        pthread_mutex_lock(&victim->lock);
+        int left = victim->tail - victim->head;
+        int taken = (left + 1) / 2;
+        int tail = victim->tail;
+        victim->tail -= taken;
+        pthread_mutex_unlock(&victim->lock);
+
+        if (taken > 0) {
+            pthread_mutex_lock(&w->lock);
+            w->head = tail - taken;
+            w->tail = tail;
+            pthread_mutex_unlock(&w->lock);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Runs grains until no worker has any left. The calling thread and every pool thread do this.
+static void work(LoopWorker *w) {
+    LoopRun *run = w->run;
+    for (;;) {
+        int g = take_grain(w);
+        if (g < 0) {
+            if (steal_grains(w) != 0) return;
+            continue;
+        }
+
+        // Nothing after a failed iteration would have run sequentially
+        pthread_mutex_lock(&run->lock);
+        int skip = g > run->first_failed;
+        pthread_mutex_unlock(&run->lock);
+        if (!skip) run_grain(w, g);
+    }
+}
+
+static void* pool_thread(void *arg) {
+    work((LoopWorker*)arg);
+    return NULL;
+}
+
+// Prepares worker 'index' with grains [head, tail). Returns 0, or -1 if out of memory.
+static int worker_init(LoopWorker *w, LoopRun *run, int index, int head, int tail) {
+    memset(w, 0, sizeof(*w));
+    w->run = run;
+    w->head = head;
+    w->tail = tail;
+    w->seed = (unsigned)index * 2654435761u;
+    pthread_mutex_init(&w->lock, NULL);
+
+    w->vm = vm_create_worker(run->vm);
+    w->frame = (int*)counted_calloc(run->loop->frame_size, sizeof(int));
+    w->console = open_memstream(&w->buffer, &w->buffer_size);
+    if (!w->vm || !w->frame || !w->console) return -1;
+
+    w->vm->console = w->console;
+    w->vm->frame = w->frame;
+    if (run->vm->output) {
+        w->vm->output = capture_value;
+        w->vm->output_data = w;
+    }
+    start_frame(run->loop, w->frame);
+    return 0;
+}
+
+static void worker_destroy(LoopWorker *w) {
+    if (w->console) fclose(w->console);
+    free(w->buffer);
+    free(w->values);
+    free(w->frame);
+    vm_destroy(w->vm);
+    pthread_mutex_destroy(&w->lock);
+}
+
+// --- Entry Point ---
+
+// The loop on the calling VM alone, in order
+static void run_sequential(VirtualMachine *vm, ASTNode *loop, int from, int to) {
+    int frame[loop->frame_size];
+    start_frame(loop, frame);
+
+    int *saved_frame = vm->frame;
+    vm->frame = frame;
+    run_iterations(vm, loop, frame, from, to);
+    vm->frame = saved_frame;
+    merge_reductions(vm, loop, frame);
+}
+
+void vm_execute_parallel_for(VirtualMachine *vm, ASTNode *loop, int from, int to) {
+    if (from >= to) return;
+    long long count = (long long)to - from;
+    int threads = vm->threads;
+    if (threads > count) threads = (int)count;
+    if (threads <= 1 || count * ast_node_count(loop->body) < PARALLEL_FOR_MIN_WORK) {
+        run_sequential(vm, loop, from, to);
+        return;
+    }
+
+    LoopRun run;
+    memset(&run, 0, sizeof(run));
+    run.vm = vm;
+    run.loop = loop;
+    run.from = from;
+    run.to = to;
+    long long grains = (long long)threads * PARALLEL_FOR_GRAINS_PER_THREAD;
+    if (grains > count) grains = count;
+    run.grain_size = (int)((count + grains - 1) / grains);
+    run.grain_count = (int)((count + run.grain_size - 1) / run.grain_size);
+    run.first_failed = run.grain_count;
+    run.grains = (GrainResult*)counted_calloc(run.grain_count, sizeof(GrainResult));
+    run.workers = (LoopWorker*)counted_calloc(threads, sizeof(LoopWorker));
+    pthread_t *pool = (pthread_t*)counted_malloc(threads * sizeof(pthread_t));
+    if (!run.grains || !run.workers || !pool) {
+        vm_runtime_error(vm, "Out of memory for a parallel for.");
+    }
+    pthread_mutex_init(&run.lock, NULL);
+
+    // Each worker starts with an equal run of consecutive grains
+    run.worker_count = threads;
+    int failed = 0;
+    for (int t = 0; t < threads; t++) {
+        int head = (int)((long long)run.grain_count * t / threads);
+        int tail = (int)((long long)run.grain_count * (t + 1) / threads);
+        if (worker_init(&run.workers[t], &run, t, head, tail) != 0) failed = 1;
+    }
+
+    // Threads that cannot be started are left idle: the others steal their grains
+    int started = 0;
+    if (!failed) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setstacksize(&attr, PARALLEL_THREAD_STACK);
+        for (int t = 1; t < threads; t++) {
+            if (pthread_create(&pool[started], &attr, pool_thread, &run.workers[t]) != 0) break;
+            started++;
+        }
+        pthread_attr_destroy(&attr);
+
+        work(&run.workers[0]);
+        for (int t = 0; t < started; t++) {
+            pthread_join(pool[t], NULL);
+        }
+    }
+
+    char error[256] = "";
+    if (!failed) {
+        flush_grains(&run, run.first_failed < run.grain_count ? run.first_failed + 1 : run.grain_count);
+        if (run.first_failed < run.grain_count) {
+            snprintf(error, sizeof(error), "%s", run.grains[run.first_failed].error);
+        } else {
+            for (int t = 0; t < threads; t++) merge_reductions(vm, loop, run.workers[t].frame);
+        }
+    }
+
+    for (int t = 0; t < threads; t++) {
+        worker_destroy(&run.workers[t]);
+    }
+    free(run.grains);
+    free(run.workers);
+    free(pool);
+    pthread_mutex_destroy(&run.lock);
+
+    if (failed) vm_runtime_error(vm, "Out of memory for a parallel for.");
+    if (error[0]) vm_runtime_error(vm, "%s", error);
+}
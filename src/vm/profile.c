@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "profile.h"
+#include "alloc.h"
+
+Profile* profile_create(uint64_t program_hash, int line_count) {
+    Profile *profile = (Profile*)counted_calloc(1, sizeof(Profile));
+    if (!profile) return NULL;
+    if (line_count < 0) line_count = 0;
+    profile->program_hash = program_hash;
+    profile->line_count = line_count;
+    profile->executed = (long long*)counted_calloc(line_count + 1, sizeof(long long));
+    profile->taken = (long long*)counted_calloc(line_count + 1, sizeof(long long));
+    profile->not_taken = (long long*)counted_calloc(line_count + 1, sizeof(long long));
+    if (!profile->executed || !profile->taken || !profile->not_taken) {
+        profile_free(profile);
+        return NULL;
+    }
+    return profile;
+}
+
+void profile_free(Profile *profile) {
+    if (!profile) return;
+    free(profile->executed);
+    free(profile->taken);
+    free(profile->not_taken);
+    free(profile->cases);
+    free(profile);
+}
+
+// --- Counting ---
+
+void profile_statement(Profile *profile, int line) {
+    if (line > 0 && line <= profile->line_count) profile->executed[line]++;
+}
+
+void profile_branch(Profile *profile, int line, int taken) {
+    if (line <= 0 || line > profile->line_count) return;
+    if (taken) profile->taken[line]++;
+    else profile->not_taken[line]++;
+}
+
+static unsigned case_hash(int line, int value) {
+    uint64_t key = ((uint64_t)(unsigned)line << 32) | (unsigned)value;
+    key *= 0x9E3779B97F4A7C15ULL;
+    return (unsigned)(key >> 32);
+}
+
+// The slot for (line, value): where it is, or the empty slot where it belongs.
+// The table must have at least one empty slot.
+static ProfileCase* find_case(ProfileCase *cases, int capacity, int line, int value) {
+    unsigned i = case_hash(line, value) & (unsigned)(capacity - 1);
+    while (cases[i].line != 0 && (cases[i].line != line || cases[i].value != value)) {
+        i = (i + 1) & (unsigned)(capacity - 1);
+    }
+    return &cases[i];
+}
+
+// Doubles the table. Returns 0, or -1 if out of memory.
+static int grow_cases(Profile *profile) {
+    int capacity = profile->case_capacity ? profile->case_capacity * 2 : 64;
+    ProfileCase *cases = (ProfileCase*)counted_calloc(capacity, sizeof(ProfileCase));
+    if (!cases) return -1;
+    for (int i = 0; i < profile->case_capacity; i++) {
+        ProfileCase *old = &profile->cases[i];
+        if (old->line != 0) *find_case(cases, capacity, old->line, old->value) = *old;
+    }
+    free(profile->cases);
+    profile->cases = cases;
+    profile->case_capacity = capacity;
+    return 0;
+}
+
+static void add_case(Profile *profile, int line, int value, long long count) {
+    if (line <= 0 || line > profile->line_count) return;
+    // Keep the table at most half full
+    if (profile->case_count * 2 >= profile->case_capacity && grow_cases(profile) != 0) return;
+    ProfileCase *c = find_case(profile->cases, profile->case_capacity, line, value);
+    if (c->line == 0) {
+        c->line = line;
+        c->value = value;
+        profile->case_count++;
+    }
+    c->count += count;
+}
+
+void profile_switch(Profile *profile, int line, int value) {
+    add_case(profile, line, value, 1);
+}
+
+// --- Files ---
+
+int profile_load(Profile *profile, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+
+    char magic[16];
+    int version;
+    uint64_t hash;
+    if (fscanf(f, "%15s %d %" SCNu64, magic, &version, &hash) != 3 ||
+        strcmp(magic, PROFILE_MAGIC) != 0 || version != PROFILE_VERSION) {
+        fclose(f);
+        return -1;
+    }
+    if (hash != profile->program_hash) {
+        fclose(f);
+        return 0; // Recorded for another program (or another version of this one)
+    }
+
+    char kind[8];
+    int status = 1;
+    while (status == 1 && fscanf(f, "%7s", kind) == 1) {
+        int line, value;
+        long long a, b;
+        if (strcmp(kind, "stmt") == 0 && fscanf(f, "%d %lld", &line, &a) == 2) {
+            if (line > 0 && line <= profile->line_count) profile->executed[line] += a;
+        } else if (strcmp(kind, "if") == 0 && fscanf(f, "%d %lld %lld", &line, &a, &b) == 3) {
+            if (line > 0 && line <= profile->line_count) {
+                profile->taken[line] += a;
+                profile->not_taken[line] += b;
+            }
+        } else if (strcmp(kind, "case") == 0 && fscanf(f, "%d %d %lld", &line, &value, &a) == 3) {
+            add_case(profile, line, value, a);
+        } else {
+            status = -1;
+        }
+    }
+    fclose(f);
+    return status;
+}
+
+int profile_save(const Profile *profile, const char *path) {
+    // Write to a temporary file and rename it, so readers never see a partial profile
+    size_t path_length = strlen(path);
+    char *temp_path = (char*)counted_malloc(path_length + 5);
+    if (!temp_path) return -1;
+    memcpy(temp_path, path, path_length);
+    memcpy(temp_path + path_length, ".tmp", 5);
+
+    FILE *f = fopen(temp_path, "w");
+    if (!f) {
+        fprintf(stderr, "Error: Could not create profile '%s'.\n", temp_path);
+        free(temp_path);
+        return -1;
+    }
+
+    fprintf(f, "%s %d %" PRIu64 "\n", PROFILE_MAGIC, PROFILE_VERSION, profile->program_hash);
+    for (int line = 1; line <= profile->line_count; line++) {
+        if (profile->executed[line]) {
+            fprintf(f, "stmt %d %lld\n", line, profile->executed[line]);
+        }
+        if (profile->taken[line] || profile->not_taken[line]) {
+            fprintf(f, "if %d %lld %lld\n", line, profile->taken[line], profile->not_taken[line]);
+        }
+    }
+    for (int i = 0; i < profile->case_capacity; i++) {
+        const ProfileCase *c = &profile->cases[i];
+        if (c->line != 0) fprintf(f, "case %d %d %lld\n", c->line, c->value, c->count);
+    }
+    int ok = !ferror(f);
+    ok = (fclose(f) == 0) && ok;
+
+    if (!ok || rename(temp_path, path) != 0) {
+        fprintf(stderr, "Error: Could not write profile '%s'.\n", path);
+        remove(temp_path);
+        free(temp_path);
+        return -1;
+    }
+    free(temp_path);
+    return 0;
+}
+
+// --- Queries ---
+
+int profile_if_cold(const Profile *profile, int if_line, int body_line) {
+    if (if_line <= 0 || if_line > profile->line_count) return 0;
+    if (profile->taken[if_line] || profile->not_taken[if_line]) {
+        return profile->taken[if_line] == 0;
+    }
+    if (body_line <= 0 || body_line > profile->line_count) return 0;
+    return profile->executed[body_line] == 0;
+}
+
+int profile_hot_value(const Profile *profile, int line, int *value) {
+    long long total = 0;
+    const ProfileCase *hottest = NULL;
+    for (int i = 0; i < profile->case_capacity; i++) {
+        const ProfileCase *c = &profile->cases[i];
+        if (c->line != line) continue;
+        total += c->count;
+        if (!hottest || c->count > hottest->count) hottest = c;
+    }
+    if (!hottest || hottest->count * 100 < total * PROFILE_HOT_CASE_PERCENT) return 0;
+    *value = hottest->value;
+    return 1;
+}
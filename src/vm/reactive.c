@@ -0,0 +1,355 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "reactive.h"
+#include "depgraph.h"
+#include "alloc.h"
+
+// What a statement left behind on its last run
+typedef struct {
+    int write_count;
+    int *writes;        // Symbols it may write, ascending
+    int *value_offsets; // Where each one's saved value starts in 'values'
+    int *values;        // The saved values, each as long as its variable
+    int *outputs;       // print() values
+    int output_count;
+    int output_capacity;
+} StatementRecord;
+
+// Statement indexes in ascending order
+typedef struct {
+    int *items;
+    int count;
+    int capacity;
+} IndexList;
+
+struct Reactive {
+    VirtualMachine *vm;
+    ASTNode *program;
+    int count;              // Top-level statements
+    DepEffects *effects;    // Per statement
+    StatementRecord *records;
+    StatementRecord *current; // The statement running now, for print()
+    IndexList readers[MAX_SYMBOLS];
+    IndexList writers[MAX_SYMBOLS];
+    int *inputs;            // Every global as it was before the program ran
+
+    // Statements waiting to re-run: a min-heap, so they run in program order
+    int *queue;
+    int queue_count;
+    unsigned char *queued;
+
+    // Concatenated output, rebuilt when a statement's output may have changed
+    int *output;
+    int output_count;
+    int output_capacity;
+    int output_stale;
+};
+
+// --- Records ---
+
+// The VM memory a global occupies
+static void symbol_range(const Reactive *r, int symbol, int *start, int *length) {
+    const Symbol *s = &r->vm->symtab->symbols[symbol];
+    *start = s->size > 0 ? s->offset : s->stack_index;
+    *length = s->size > 0 ? s->size : 1;
+}
+
+static int index_list_push(IndexList *list, int value) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 8;
+        int *grown = (int*)counted_realloc(list->items, capacity * sizeof(int));
+        if (!grown) return -1;
+        list->items = grown;
+        list->capacity = capacity;
+    }
+    list->items[list->count++] = value;
+    return 0;
+}
+
+// Position of the first item greater than 'value'
+static int index_list_after(const IndexList *list, int value) {
+    int low = 0, high = list->count;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (list->items[mid] <= value) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+// Saved value of 'symbol' after statement 'i' (which may write it)
+static int* saved_value(const Reactive *r, int i, int symbol) {
+    const StatementRecord *record = &r->records[i];
+    for (int k = 0; k < record->write_count; k++) {
+        if (record->writes[k] == symbol) return &record->values[record->value_offsets[k]];
+    }
+    return NULL;
+}
+
+// Value of 'symbol' just before statement 'i' runs (i == count for the end of the program)
+static const int* value_before(const Reactive *r, int symbol, int i) {
+    const IndexList *writers = &r->writers[symbol];
+    int k = index_list_after(writers, i - 1) - 1; // Last writer before i
+    if (k >= 0) return saved_value(r, writers->items[k], symbol);
+
+    int start, length;
+    symbol_range(r, symbol, &start, &length);
+    return &r->inputs[start];
+}
+
+// Sets up each statement's list of writable globals and room for their values
+static int init_records(Reactive *r) {
+    for (int i = 0; i < r->count; i++) {
+        StatementRecord *record = &r->records[i];
+        int symbols = r->vm->symtab->count;
+        int value_count = 0;
+
+        record->writes = (int*)counted_malloc((symbols + 1) * sizeof(int));
+        record->value_offsets = (int*)counted_malloc((symbols + 1) * sizeof(int));
+        if (!record->writes || !record->value_offsets) return -1;
+
+        for (int s = 0; s < symbols; s++) {
+            int reads = depgraph_has_resource(r->effects[i].reads, s);
+            int writes = depgraph_has_resource(r->effects[i].writes, s);
+            if (reads && index_list_push(&r->readers[s], i) != 0) return -1;
+            if (!writes) continue;
+            if (index_list_push(&r->writers[s], i) != 0) return -1;
+
+            int start, length;
+            symbol_range(r, s, &start, &length);
+            record->writes[record->write_count] = s;
+            record->value_offsets[record->write_count++] = value_count;
+            value_count += length;
+        }
+        record->values = (int*)counted_calloc(value_count + 1, sizeof(int));
+        if (!record->values) return -1;
+    }
+    return 0;
+}
+
+// --- Creation ---
+
+Reactive* reactive_create(VirtualMachine *vm, ASTNode *program, const char **error) {
+    *error = "Out of memory.";
+    Reactive *r = (Reactive*)counted_calloc(1, sizeof(Reactive));
+    if (!r) return NULL;
+    r->vm = vm;
+    r->program = program;
+    r->count = program->statement_count;
+
+    r->effects = depgraph_effects(program, vm->symtab, 0);
+    r->records = (StatementRecord*)counted_calloc(r->count + 1, sizeof(StatementRecord));
+    r->inputs = (int*)counted_malloc((size_t)vm->memory_size * sizeof(int));
+    r->queue = (int*)counted_malloc((r->count + 1) * sizeof(int));
+    r->queued = (unsigned char*)counted_calloc(r->count + 1, 1);
+    if (!r->effects || !r->records || !r->inputs || !r->queue || !r->queued) {
+        reactive_free(r);
+        return NULL;
+    }
+
+    // Input is consumed as it is read, so it cannot be replayed
+    for (int i = 0; i < r->count; i++) {
+        if (depgraph_has_resource(r->effects[i].reads, DEP_RESOURCE_INPUT)) {
+            *error = "Reactive mode does not support read() or read_all().";
+            reactive_free(r);
+            return NULL;
+        }
+    }
+    if (init_records(r) != 0) {
+        reactive_free(r);
+        return NULL;
+    }
+    *error = NULL;
+    return r;
+}
+
+void reactive_free(Reactive *r) {
+    if (!r) return;
+    for (int i = 0; r->records && i < r->count; i++) {
+        free(r->records[i].writes);
+        free(r->records[i].value_offsets);
+        free(r->records[i].values);
+        free(r->records[i].outputs);
+    }
+    for (int s = 0; s < MAX_SYMBOLS; s++) {
+        free(r->readers[s].items);
+        free(r->writers[s].items);
+    }
+    free(r->records);
+    free(r->effects);
+    free(r->inputs);
+    free(r->queue);
+    free(r->queued);
+    free(r->output);
+    free(r);
+}
+
+// --- Running Statements ---
+
+// The VM's output callback while running reactively
+static void record_output(void *user_data, int value) {
+    StatementRecord *record = ((Reactive*)user_data)->current;
+    if (record->output_count == record->output_capacity) {
+        int capacity = record->output_capacity ? record->output_capacity * 2 : 4;
+        int *grown = (int*)counted_realloc(record->outputs, capacity * sizeof(int));
+        if (!grown) return; // Drop the value rather than fail the run
+        record->outputs = grown;
+        record->output_capacity = capacity;
+    }
+    record->outputs[record->output_count++] = value;
+}
+
+static void run_statement(Reactive *r, int i) {
+    r->current = &r->records[i];
+    r->current->output_count = 0;
+    vm_execute_statement(r->vm, r->program->statements[i]);
+}
+
+static void queue_push(Reactive *r, int i) {
+    if (r->queued[i]) return;
+    r->queued[i] = 1;
+
+    int k = r->queue_count++;
+    while (k > 0 && r->queue[(k - 1) / 2] > i) {
+        r->queue[k] = r->queue[(k - 1) / 2];
+        k = (k - 1) / 2;
+    }
+    r->queue[k] = i;
+}
+
+static int queue_pop(Reactive *r) {
+    int top = r->queue[0];
+    int last = r->queue[--r->queue_count];
+
+    int k = 0;
+    for (;;) {
+        int child = 2 * k + 1;
+        if (child >= r->queue_count) break;
+        if (child + 1 < r->queue_count && r->queue[child + 1] < r->queue[child]) child++;
+        if (r->queue[child] >= last) break;
+        r->queue[k] = r->queue[child];
+        k = child;
+    }
+    if (r->queue_count > 0) r->queue[k] = last;
+    r->queued[top] = 0;
+    return top;
+}
+
+// The value of 'symbol' after statement 'i' (-1 for the inputs) has changed.
+// Queues the statements that read that version, and the next statement that
+// may write the symbol: if it does not write it this time, its saved value is
+// this one passed through.
+static void value_changed(Reactive *r, int symbol, int i) {
+    const IndexList *writers = &r->writers[symbol];
+    const IndexList *readers = &r->readers[symbol];
+
+    int w = index_list_after(writers, i);
+    int next_writer = w < writers->count ? writers->items[w] : r->count;
+    if (next_writer < r->count) queue_push(r, next_writer);
+
+    for (int k = index_list_after(readers, i); k < readers->count && readers->items[k] <= next_writer; k++) {
+        queue_push(r, readers->items[k]);
+    }
+}
+
+// Saves the values statement 'i' left in the globals it may write. With
+// 'propagate', any that differ from last time are passed on.
+static void save_values(Reactive *r, int i, int propagate) {
+    StatementRecord *record = &r->records[i];
+    for (int k = 0; k < record->write_count; k++) {
+        int symbol = record->writes[k];
+        int start, length;
+        symbol_range(r, symbol, &start, &length);
+
+        int *saved = &record->values[record->value_offsets[k]];
+        size_t bytes = (size_t)length * sizeof(int);
+        if (memcmp(saved, &r->vm->memory[start], bytes) == 0) continue;
+        memcpy(saved, &r->vm->memory[start], bytes);
+        if (propagate) value_changed(r, symbol, i);
+    }
+}
+
+// Puts the value 'symbol' had just before statement 'i' back into VM memory
+static void load_value(Reactive *r, int symbol, int i) {
+    int start, length;
+    symbol_range(r, symbol, &start, &length);
+    memcpy(&r->vm->memory[start], value_before(r, symbol, i), (size_t)length * sizeof(int));
+}
+
+// --- Entry Points ---
+
+void reactive_run(Reactive *r) {
+    VirtualMachine *vm = r->vm;
+    memcpy(r->inputs, vm->memory, (size_t)vm->memory_size * sizeof(int));
+    vm->output = record_output;
+    vm->output_data = r;
+
+    for (int i = 0; i < r->count; i++) {
+        run_statement(r, i);
+        save_values(r, i, 0);
+    }
+    r->output_stale = 1;
+}
+
+int reactive_update(Reactive *r, int symbol) {
+    VirtualMachine *vm = r->vm;
+    int symbols = vm->symtab->count;
+    vm->output = record_output;
+    vm->output_data = r;
+
+    int start, length;
+    symbol_range(r, symbol, &start, &length);
+    memcpy(&r->inputs[start], &vm->memory[start], (size_t)length * sizeof(int));
+
+    // Globals whose memory no longer holds their final value
+    uint64_t touched[DEP_WORDS] = {0};
+    touched[symbol / 64] |= 1ULL << (symbol % 64);
+
+    int ran = 0;
+    value_changed(r, symbol, -1);
+    while (r->queue_count > 0) {
+        int i = queue_pop(r);
+        const DepEffects *effects = &r->effects[i];
+
+        // Recreate the state this statement saw in a full run, as far as it can tell
+        for (int s = 0; s < symbols; s++) {
+            if (depgraph_has_resource(effects->reads, s) || depgraph_has_resource(effects->writes, s)) {
+                load_value(r, s, i);
+                touched[s / 64] |= 1ULL << (s % 64);
+            }
+        }
+        run_statement(r, i);
+        save_values(r, i, 1);
+        ran++;
+    }
+
+    for (int s = 0; s < symbols; s++) {
+        if (depgraph_has_resource(touched, s)) load_value(r, s, r->count);
+    }
+    if (ran) r->output_stale = 1;
+    return ran;
+}
+
+const int* reactive_output(Reactive *r, int *count) {
+    if (r->output_stale) {
+        r->output_count = 0;
+        for (int i = 0; i < r->count; i++) {
+            StatementRecord *record = &r->records[i];
+            if (record->output_count == 0) continue;
+            if (r->output_count + record->output_count > r->output_capacity) {
+                int capacity = r->output_capacity ? r->output_capacity : 16;
+                while (capacity < r->output_count + record->output_count) capacity *= 2;
+                int *grown = (int*)counted_realloc(r->output, capacity * sizeof(int));
+                if (!grown) break;
+                r->output = grown;
+                r->output_capacity = capacity;
+            }
+            memcpy(&r->output[r->output_count], record->outputs, record->output_count * sizeof(int));
+            r->output_count += record->output_count;
+        }
+        r->output_stale = 0;
+    }
+    *count = r->output_count;
+    return r->output;
+}
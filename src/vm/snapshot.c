@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "snapshot.h"
+#include "alloc.h"
+
+// On-disk header, followed by 'symbol_count' SnapshotSymbol records (each
+// followed by its name), zero padding, and the memory block at 'memory_offset'.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    int32_t pc;              // Next top-level statement to run
+    uint64_t program_hash;
+    int32_t memory_size;     // In ints
+    int32_t symbol_count;
+    uint64_t memory_offset;  // In bytes, a multiple of the page size
+    uint64_t input_consumed; // Bytes of read() input the prefix used up
+} SnapshotHeader;
+
+typedef struct {
+    int32_t stack_index;
+    int32_t size;
+    int32_t offset;
+    uint32_t name_length;
+} SnapshotSymbol;
+
+uint64_t snapshot_hash_program(const char *source) {
+    uint64_t hash = 14695981039346656037ULL; // FNV offset basis
+    for (const unsigned char *c = (const unsigned char*)source; *c; c++) {
+        hash ^= *c;
+        hash *= 1099511628211ULL; // FNV prime
+    }
+    return hash;
+}
+
+// --- Saving ---
+
+int snapshot_save(const char *path, VirtualMachine *vm, uint64_t program_hash) {
+    SymbolTable *st = vm->symtab;
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (page_size <= 0) page_size = 4096;
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.pc = vm->pc;
+    header.program_hash = program_hash;
+    header.memory_size = vm->memory_size;
+    header.symbol_count = st->count;
+    header.input_consumed = vm->input ? input_consumed(vm->input) : 0;
+
+    uint64_t metadata_size = sizeof(header);
+    for (int i = 0; i < st->count; i++) {
+        metadata_size += sizeof(SnapshotSymbol) + strlen(st->symbols[i].name);
+    }
+    header.memory_offset = (metadata_size + page_size - 1) / page_size * page_size;
+
+    // Write to a temporary file and rename it, so readers never see a partial snapshot
+    size_t path_length = strlen(path);
+    char *temp_path = (char*)counted_malloc(path_length + 5);
+    if (!temp_path) return -1;
+    memcpy(temp_path, path, path_length);
+    memcpy(temp_path + path_length, ".tmp", 5);
+
+    FILE *f = fopen(temp_path, "wb");
+    if (!f) {
+        fprintf(stderr, "Error: Could not create snapshot '%s'.\n", temp_path);
+        free(temp_path);
+        return -1;
+    }
+
+    int ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    for (int i = 0; ok && i < st->count; i++) {
+        Symbol *s = &st->symbols[i];
+        SnapshotSymbol record = { s->stack_index, s->size, s->offset, (uint32_t)strlen(s->name) };
+        ok = fwrite(&record, sizeof(record), 1, f) == 1 &&
+             fwrite(s->name, 1, record.name_length, f) == record.name_length;
+    }
+    for (uint64_t i = metadata_size; ok && i < header.memory_offset; i++) {
+        ok = fputc(0, f) != EOF;
+    }
+    ok = ok && fwrite(vm->memory, sizeof(int), vm->memory_size, f) == (size_t)vm->memory_size;
+    ok = (fclose(f) == 0) && ok;
+
+    if (!ok || rename(temp_path, path) != 0) {
+        fprintf(stderr, "Error: Could not write snapshot '%s'.\n", path);
+        remove(temp_path);
+        free(temp_path);
+        return -1;
+    }
+    free(temp_path);
+    return 0;
+}
+
+// --- Restoring ---
+
+// Checks the snapshot's symbol records against the VM's symbol table
+static int snapshot_check_symbols(int fd, const SnapshotHeader *header, SymbolTable *st) {
+    if (header->symbol_count != st->count) return 0;
+
+    off_t position = sizeof(*header);
+    for (int i = 0; i < st->count; i++) {
+        Symbol *s = &st->symbols[i];
+        SnapshotSymbol record;
+        if (pread(fd, &record, sizeof(record), position) != (ssize_t)sizeof(record)) return 0;
+        position += sizeof(record);
+
+        size_t name_length = strlen(s->name);
+        if (record.stack_index != s->stack_index || record.size != s->size ||
+            record.offset != s->offset || record.name_length != name_length) {
+            return 0;
+        }
+
+        char *name = (char*)counted_malloc(name_length + 1);
+        if (!name) return 0;
+        int same = pread(fd, name, name_length, position) == (ssize_t)name_length &&
+                   memcmp(name, s->name, name_length) == 0;
+        free(name);
+        if (!same) return 0;
+        position += name_length;
+    }
+    return 1;
+}
+
+int snapshot_restore(const char *path, VirtualMachine *vm, uint64_t program_hash, int statement_count) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Could not open snapshot '%s'.\n", path);
+        return -1;
+    }
+
+    SnapshotHeader header;
+    struct stat info;
+    size_t memory_bytes = (size_t)vm->memory_size * sizeof(int);
+    long page_size = sysconf(_SC_PAGESIZE);
+
+    const char *problem = NULL;
+    if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+        problem = "not a snapshot file";
+    } else if (header.version != SNAPSHOT_VERSION) {
+        problem = "unsupported snapshot version";
+    } else if (header.program_hash != program_hash) {
+        problem = "it was taken from a different program";
+    } else if (header.memory_size != vm->memory_size || !snapshot_check_symbols(fd, &header, vm->symtab)) {
+        problem = "the symbol table does not match";
+    } else if (header.pc < 0 || header.pc > statement_count) {
+        problem = "it is corrupt (its resume position is outside the program)";
+    } else if (fstat(fd, &info) != 0 || (uint64_t)info.st_size < header.memory_offset + memory_bytes ||
+               (page_size > 0 && header.memory_offset % page_size != 0)) {
+        problem = "the file is truncated or misaligned";
+    }
+    if (problem) {
+        fprintf(stderr, "Error: Cannot restore snapshot '%s': %s.\n", path, problem);
+        close(fd);
+        return -1;
+    }
+
+    // Private mapping: pages are read lazily and copied only when the program writes them
+    void *memory = mmap(NULL, memory_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, (off_t)header.memory_offset);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        fprintf(stderr, "Error: Could not map snapshot '%s'.\n", path);
+        return -1;
+    }
+
+    // The tail must read on from where the prefix stopped, not from the start
+    if (header.input_consumed > 0 && (!vm->input || input_skip(vm->input, (size_t)header.input_consumed) != 0)) {
+        fprintf(stderr, "Error: Cannot restore snapshot '%s': the input is shorter than the %llu bytes "
+                "its prefix read.\n", path, (unsigned long long)header.input_consumed);
+        munmap(memory, memory_bytes);
+        return -1;
+    }
+
+    vm_adopt_memory(vm, (int*)memory, 1);
+    vm->pc = header.pc;
+    return 0;
+}
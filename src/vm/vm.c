@@ -1,138 +1,604 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
+#include <sys/mman.h>
 #include "vm.h"
 #include "ast.h"
 #include "symtab.h"
+#include "array.h"
+#include "semantic.h"
+#include "parallel.h"
+#include "alloc.h"
+
+// Expressions nested deeper than this are finished by vm_evaluate_deep, so the C
+// stack an evaluation uses stays bounded however deep the tree is
+#define VM_EVAL_MAX_DEPTH 128
+
+// An expression node part-way through evaluation (see vm_evaluate_deep)
+typedef struct VMEvalFrame {
+    ASTNode *node;
+    int state; // How many of its operands or arguments have been scheduled
+    int base;  // EXPR_CALL to a user function: where its frame starts on the VM stack
+} VMEvalFrame;
 
 // --- Private Function Prototypes ---
 static int vm_evaluate_expression(VirtualMachine *vm, ASTNode *expr);
-static void vm_execute_statement(VirtualMachine *vm, ASTNode *stmt);
+static int vm_evaluate(VirtualMachine *vm, ASTNode *expr, int depth);
+static int vm_evaluate_deep(VirtualMachine *vm, ASTNode *expr);
+static int vm_call_builtin(VirtualMachine *vm, ASTNode *call, int scalar_arg);
+static int vm_call_function(VirtualMachine *vm, ASTNode *call, int depth);
+static int vm_enter_function(VirtualMachine *vm, ASTNode *call, int base);
 
 // --- Core VM Management ---
 
 VirtualMachine* vm_create(SymbolTable *st) {
-    VirtualMachine *vm = (VirtualMachine*)calloc(1, sizeof(VirtualMachine));
+    // One zero-initialized block for scalars and arrays (sized by the semantic pass)
+    int *memory = array_alloc(st->memory_size);
+    if (!memory) {
+        fprintf(stderr, "Error: Could not allocate %d ints of VM memory.\n", st->memory_size);
+        return NULL;
+    }
+    VirtualMachine *vm = vm_create_on(st, memory, 0);
+    if (!vm) array_free(memory);
+    return vm;
+}
+
+VirtualMachine* vm_create_on(SymbolTable *st, int *memory, int is_mapped) {
+    VirtualMachine *vm = (VirtualMachine*)counted_calloc(1, sizeof(VirtualMachine));
     if (!vm) return NULL;
     
     vm->symtab = st;
-    
-    // Initialize all memory to zero
-    for (int i = 0; i < MAX_SYMBOLS; i++) {
-        vm->memory[i] = 0;
-    }
+    vm->trace = 1;
+    vm->console = stdout;
+    vm->fuel = VM_FUEL_UNLIMITED;
+    vm->threads = 1;
+    vm->memory_size = st->memory_size;
+    vm->memory = memory;
+    vm->memory_is_mapped = is_mapped;
+    return vm;
+}
+
+VirtualMachine* vm_create_worker(VirtualMachine *parent) {
+    VirtualMachine *vm = (VirtualMachine*)counted_calloc(1, sizeof(VirtualMachine));
+    if (!vm) return NULL;
+
+    vm->symtab = parent->symtab;
+    vm->memory = parent->memory;
+    vm->memory_size = parent->memory_size;
+    vm->memory_is_shared = 1;
+    vm->output = parent->output;
+    vm->output_data = parent->output_data;
+    vm->trace = parent->trace;
+    vm->console = parent->console;
+    vm->input = parent->input;
+    vm->fuel = VM_FUEL_UNLIMITED;
+    vm->threads = 1; // Its threads are already busy
     return vm;
 }
 
 void vm_destroy(VirtualMachine *vm) {
     // Note: The symbol table is managed externally (and should be destroyed externally)
-    free(vm);
+    if (vm) {
+        if (!vm->memory_is_shared) vm_adopt_memory(vm, NULL, 0);
+        free(vm->stack);
+        free(vm->eval_frames);
+        free(vm->eval_values);
+        free(vm);
+    }
+}
+
+void vm_reset(VirtualMachine *vm) {
+    memset(vm->memory, 0, (size_t)vm->memory_size * sizeof(int));
+    vm->pc = 0;
+    vm_unwind(vm);
+}
+
+void vm_unwind(VirtualMachine *vm) {
+    vm->stack_top = 0;
+    vm->frame = NULL;
+    vm->call_depth = 0;
+    vm->eval_count = 0;
+    vm->value_count = 0;
+}
+
+void vm_adopt_memory(VirtualMachine *vm, int *memory, int is_mapped) {
+    if (vm->memory_is_mapped) {
+        munmap(vm->memory, (size_t)vm->memory_size * sizeof(int));
+    } else {
+        array_free(vm->memory);
+    }
+    vm->memory = memory;
+    vm->memory_is_mapped = is_mapped;
+}
+
+// Reports a runtime error to whoever is running the VM (see error_jump in vm.h)
+void vm_runtime_error(VirtualMachine *vm, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    vsnprintf(vm->error_message, sizeof(vm->error_message), format, args);
+    va_end(args);
+
+    if (vm->error_jump_set) {
+        longjmp(vm->error_jump, 1);
+    }
+    fprintf(stderr, "Runtime Error: %s\n", vm->error_message);
+    exit(1);
+}
+
+// --- Variable Access Helpers ---
+// Names were resolved to slots by the semantic pass, so no lookups happen here.
+
+// Returns the address of a scalar variable (global, or in the current call frame)
+static int* vm_variable(VirtualMachine *vm, ASTNode *node) {
+    return node->is_local ? &vm->frame[node->slot] : &vm->memory[node->slot];
+}
+
+// Returns the symbol of a global array
+static Symbol* vm_array(VirtualMachine *vm, ASTNode *node) {
+    return &vm->symtab->symbols[node->slot];
+}
+
+// Returns the address of a[i], exiting with a runtime error if i is out of bounds
+static int* vm_element(VirtualMachine *vm, Symbol *array, int i) {
+    if (i < 0 || i >= array->size) {
+        vm_runtime_error(vm, "Index %d out of bounds for '%s[%d]'.", i, array->name, array->size);
+    }
+    return &vm->memory[array->offset + i];
+}
+
+// --- Function Calls ---
+
+// Bulk operations validate their arrays once, then hand the whole extent to an
+// unchecked kernel in array.c. 'scalar_arg' is the evaluated factor of scale().
+static int vm_call_builtin(VirtualMachine *vm, ASTNode *call, int scalar_arg) {
+    if (call->builtin == BUILTIN_READ) {
+        int value;
+        if (!vm->input || !input_next(vm->input, &value)) {
+            vm_runtime_error(vm, "read() ran out of input.");
+        }
+        return value;
+    }
+
+    Symbol *a = vm_array(vm, call->args[0]);
+    int *data = &vm->memory[a->offset];
+
+    switch (call->builtin) {
+        case BUILTIN_SUM:
+            return array_sum(data, a->size);
+        case BUILTIN_MIN:
+            return array_min(data, a->size);
+        case BUILTIN_MAX:
+            return array_max(data, a->size);
+
+        case BUILTIN_ADD: {
+            // add(a, b): a[i] = a[i] + b[i] for every element
+            Symbol *b = vm_array(vm, call->args[1]);
+            if (a->size != b->size) {
+                vm_runtime_error(vm, "add() needs arrays of equal size ('%s[%d]' vs '%s[%d]').",
+                                 a->name, a->size, b->name, b->size);
+            }
+            array_add(data, &vm->memory[b->offset], a->size);
+            return 0;
+        }
+
+        case BUILTIN_SCALE:
+            // scale(a, k): a[i] = a[i] * k for every element
+            array_scale(data, scalar_arg, a->size);
+            return 0;
+
+        case BUILTIN_READ_ALL:
+            // read_all(a): parses straight into the array's storage
+            return vm->input ? input_read_array(vm->input, data, a->size) : 0;
+
+        default:
+            vm_runtime_error(vm, "Unknown function '%s'.", call->name);
+            return 0;
+    }
+}
+
+// Reserves the callee's frame at 'base' on the VM stack, ready for its arguments
+static void vm_open_frame(VirtualMachine *vm, ASTNode *call, int base) {
+    ASTNode *function = call->callee;
+    if (vm->call_depth >= VM_MAX_CALL_DEPTH || base + function->frame_size > VM_STACK_SIZE) {
+        vm_runtime_error(vm, "Stack overflow calling '%s'.", function->name);
+    }
+    if (!vm->stack) {
+        vm->stack = (int*)counted_malloc(VM_STACK_SIZE * sizeof(int));
+        if (!vm->stack) vm_runtime_error(vm, "Could not allocate the call stack.");
+    }
+}
+
+// Pushes a frame for the callee on the VM stack, runs its body and pops the frame
+static int vm_call_function(VirtualMachine *vm, ASTNode *call, int depth) {
+    int base = vm->stack_top;
+    vm_open_frame(vm, call, base);
+
+    // Arguments go straight into the new frame. Claiming each slot as it is filled
+    // keeps calls nested inside later arguments from overwriting it.
+    for (int i = 0; i < call->arg_count; i++) {
+        int value = vm_evaluate(vm, call->args[i], depth + 1);
+        vm->stack[base + i] = value;
+        vm->stack_top = base + i + 1;
+    }
+    return vm_enter_function(vm, call, base);
+}
+
+// Runs the callee once its arguments fill stack[base..], then pops the frame
+static int vm_enter_function(VirtualMachine *vm, ASTNode *call, int base) {
+    ASTNode *function = call->callee;
+    for (int i = function->param_count; i < function->frame_size; i++) {
+        vm->stack[base + i] = 0; // Locals start at zero, like globals
+    }
+    vm->stack_top = base + function->frame_size;
+
+    int *saved_frame = vm->frame;
+    vm->frame = &vm->stack[base];
+    vm->call_depth++;
+
+    int result = vm_execute_statement(vm, function->body) ? vm->return_value : 0;
+
+    vm->call_depth--;
+    vm->frame = saved_frame;
+    vm->stack_top = base;
+    return result;
 }
 
 // --- Execution Traversal Functions ---
 
+static void vm_push_eval(VirtualMachine *vm, ASTNode *node) {
+    if (vm->eval_count == vm->eval_capacity) {
+        int capacity = vm->eval_capacity ? vm->eval_capacity * 2 : 64;
+        VMEvalFrame *grown = (VMEvalFrame*)counted_realloc(vm->eval_frames, capacity * sizeof(VMEvalFrame));
+        if (!grown) vm_runtime_error(vm, "Could not grow the expression stack.");
+        vm->eval_frames = grown;
+        vm->eval_capacity = capacity;
+    }
+    VMEvalFrame *frame = &vm->eval_frames[vm->eval_count++];
+    frame->node = node;
+    frame->state = 0;
+    frame->base = 0;
+}
+
+static void vm_push_value(VirtualMachine *vm, int value) {
+    if (vm->value_count == vm->value_capacity) {
+        int capacity = vm->value_capacity ? vm->value_capacity * 2 : 64;
+        int *grown = (int*)counted_realloc(vm->eval_values, capacity * sizeof(int));
+        if (!grown) vm_runtime_error(vm, "Could not grow the expression stack.");
+        vm->eval_values = grown;
+        vm->value_capacity = capacity;
+    }
+    vm->eval_values[vm->value_count++] = value;
+}
+
+// Reads a literal or scalar variable directly. Returns 0 for any other node.
+static int vm_leaf_value(VirtualMachine *vm, ASTNode *node, int *value) {
+    if (node->type == EXPR_LITERAL) {
+        *value = node->value;
+        return 1;
+    }
+    if (node->type == EXPR_IDENTIFIER) {
+        *value = *vm_variable(vm, node);
+        return 1;
+    }
+    return 0;
+}
+
+// Queues an operand: a leaf's value goes straight onto the value stack,
+// anything else onto the work stack to be evaluated first.
+static void vm_schedule(VirtualMachine *vm, ASTNode *node) {
+    int value;
+    if (vm_leaf_value(vm, node, &value)) {
+        vm_push_value(vm, value);
+    } else {
+        vm_push_eval(vm, node);
+    }
+}
+
+static int vm_binary(VirtualMachine *vm, ASTNode *expr, int left_val, int right_val) {
+    switch (expr->binary) {
+        // Arithmetic operations, done unsigned so overflow wraps instead of being undefined
+        case BINARY_ADD: return (int)((unsigned)left_val + (unsigned)right_val);
+        case BINARY_SUB: return (int)((unsigned)left_val - (unsigned)right_val);
+        case BINARY_MUL: return (int)((unsigned)left_val * (unsigned)right_val);
+        case BINARY_DIV:
+            if (right_val == 0) {
+                vm_runtime_error(vm, "Division by zero.");
+            }
+            if (right_val == -1) return (int)(0u - (unsigned)left_val); // INT_MIN / -1 wraps to INT_MIN
+            return left_val / right_val;
+
+        // Comparison operations (used in IF statements)
+        case BINARY_EQUAL:   return left_val == right_val;
+        case BINARY_LESS:    return left_val < right_val;
+        case BINARY_GREATER: return left_val > right_val;
+
+        // Strength-reduced forms; the right operand is the constant they were made for
+        case BINARY_SHIFT_LEFT:
+            return (int)((unsigned)left_val << expr->shift); // Wraps exactly as '*' does
+        case BINARY_DIV_POW2: {
+            // Biasing a negative dividend by 2^shift - 1 makes the shift round toward zero
+            int bias = (left_val >> 31) & ((1 << expr->shift) - 1);
+            return (left_val + bias) >> expr->shift;
+        }
+        case BINARY_DIV_MAGIC: {
+            unsigned high = (unsigned)(((long long)expr->magic * left_val) >> 32);
+            if (expr->magic_add > 0) high += (unsigned)left_val;
+            if (expr->magic_add < 0) high -= (unsigned)left_val;
+            int quotient = (int)high >> expr->shift;
+            return quotient + (int)((unsigned)quotient >> 31); // Round negative quotients toward zero
+        }
+
+        default:
+            vm_runtime_error(vm, "Unknown operator '%s'.", expr->op->lexeme);
+            return 0;
+    }
+}
+
 // Walks the expression tree and returns the resulting integer value
 static int vm_evaluate_expression(VirtualMachine *vm, ASTNode *expr) {
+    return vm_evaluate(vm, expr, 0);
+}
+
+// The usual case: recursion, which is the fastest walk for shallow trees.
+// Operands are evaluated left to right.
+static int vm_evaluate(VirtualMachine *vm, ASTNode *expr, int depth) {
     if (!expr) return 0;
+    if (depth >= VM_EVAL_MAX_DEPTH) return vm_evaluate_deep(vm, expr);
 
     switch (expr->type) {
         case EXPR_LITERAL:
             return expr->value;
 
-        case EXPR_IDENTIFIER: {
-            int index = symtab_lookup(vm->symtab, expr->name);
-            if (index == -1) {
-                fprintf(stderr, "Runtime Error: Undefined variable '%s'.\n", expr->name);
-                exit(1);
-            }
-            return vm->memory[index];
-        }
+        case EXPR_IDENTIFIER:
+            return *vm_variable(vm, expr);
+
+        case EXPR_INDEX:
+            return *vm_element(vm, vm_array(vm, expr), vm_evaluate(vm, expr->index, depth + 1));
+
+        case EXPR_CALL:
+            if (expr->callee) return vm_call_function(vm, expr, depth);
+            // Built-ins take array names, apart from the factor of scale()
+            return vm_call_builtin(vm, expr, expr->builtin == BUILTIN_SCALE
+                                             ? vm_evaluate(vm, expr->args[1], depth + 1) : 0);
 
         case EXPR_BINARY: {
-            int left_val = vm_evaluate_expression(vm, expr->left);
-            int right_val = vm_evaluate_expression(vm, expr->right);
-            
-            // Handle arithmetic operations
-            if (strcmp(expr->op->lexeme, "+") == 0) return left_val + right_val;
-            if (strcmp(expr->op->lexeme, "-") == 0) return left_val - right_val;
-            if (strcmp(expr->op->lexeme, "*") == 0) return left_val * right_val;
-            if (strcmp(expr->op->lexeme, "/") == 0) {
-                if (right_val == 0) {
-                    fprintf(stderr, "Runtime Error: Division by zero.\n");
-                    exit(1);
-                }
-                return left_val / right_val;
-            }
-            
-            // Handle comparison operations (used in IF statements)
-            if (strcmp(expr->op->lexeme, "==") == 0) return left_val == right_val;
-            if (strcmp(expr->op->lexeme, "<") == 0) return left_val < right_val;
-            if (strcmp(expr->op->lexeme, ">") == 0) return left_val > right_val;
-            
-            fprintf(stderr, "Runtime Error: Unknown operator '%s'.\n", expr->op->lexeme);
-            return 0;
+            int left_val = vm_evaluate(vm, expr->left, depth + 1);
+            int right_val = vm_evaluate(vm, expr->right, depth + 1);
+            return vm_binary(vm, expr, left_val, right_val);
         }
-        
+
         default:
-            fprintf(stderr, "Runtime Error: Cannot evaluate node type %d in expression.\n", expr->type);
+            vm_runtime_error(vm, "Cannot evaluate node type %d in expression.", expr->type);
             return 0;
     }
 }
 
-// Executes a single statement, modifying the VM state
-static void vm_execute_statement(VirtualMachine *vm, ASTNode *stmt) {
-    if (!stmt) return;
+// Evaluates a deeply nested (sub)tree, e.g. a machine-generated expression,
+// with explicit work and value stacks instead of recursion. Calls made while
+// it runs stack their own work above 'frame_base'.
+static int vm_evaluate_deep(VirtualMachine *vm, ASTNode *expr) {
+    int value;
+    if (vm_leaf_value(vm, expr, &value)) return value;
+
+    int frame_base = vm->eval_count;
+    vm_push_eval(vm, expr);
+
+    while (vm->eval_count > frame_base) {
+        VMEvalFrame *frame = &vm->eval_frames[vm->eval_count - 1];
+        ASTNode *node = frame->node;
+        int left_val, right_val;
+
+        // Each case either schedules one more child and goes round again (a push
+        // may move 'frame'), or pops its frame and pushes the node's value.
+        switch (node->type) {
+            case EXPR_LITERAL:
+            case EXPR_IDENTIFIER:
+                vm_leaf_value(vm, node, &value);
+                break;
+
+            case EXPR_INDEX:
+                if (frame->state++ == 0) {
+                    vm_schedule(vm, node->index);
+                    continue;
+                }
+                value = *vm_element(vm, vm_array(vm, node), vm->eval_values[--vm->value_count]);
+                break;
+
+            case EXPR_BINARY:
+                if (frame->state == 0 && vm_leaf_value(vm, node->left, &left_val) &&
+                    vm_leaf_value(vm, node->right, &right_val)) {
+                    value = vm_binary(vm, node, left_val, right_val);
+                    break;
+                }
+                if (frame->state < 2) {
+                    vm_schedule(vm, frame->state++ == 0 ? node->left : node->right);
+                    continue;
+                }
+                right_val = vm->eval_values[--vm->value_count];
+                left_val = vm->eval_values[--vm->value_count];
+                value = vm_binary(vm, node, left_val, right_val);
+                break;
+
+            case EXPR_CALL:
+                if (!node->callee) {
+                    // Built-ins take array names, apart from the factor of scale()
+                    if (node->builtin == BUILTIN_SCALE && frame->state++ == 0) {
+                        vm_schedule(vm, node->args[1]);
+                        continue;
+                    }
+                    int factor = node->builtin == BUILTIN_SCALE ? vm->eval_values[--vm->value_count] : 0;
+                    value = vm_call_builtin(vm, node, factor);
+                    break;
+                }
+
+                // Arguments go straight into the new frame. Claiming each slot as it is
+                // filled keeps calls nested inside later arguments from overwriting it.
+                if (frame->state == 0) {
+                    frame->base = vm->stack_top;
+                    vm_open_frame(vm, node, frame->base);
+                } else {
+                    vm->stack[frame->base + frame->state - 1] = vm->eval_values[--vm->value_count];
+                    vm->stack_top = frame->base + frame->state;
+                }
+                if (frame->state < node->arg_count) {
+                    vm_schedule(vm, node->args[frame->state++]);
+                    continue;
+                }
+                value = vm_enter_function(vm, node, frame->base);
+                break;
+
+            default:
+                vm_runtime_error(vm, "Cannot evaluate node type %d in expression.", node->type);
+                return 0;
+        }
+
+        vm->eval_count--;
+        vm_push_value(vm, value);
+    }
+    return vm->eval_values[--vm->value_count];
+}
+
+// Returns the index of the switch body that handles 'value', or -1 for none.
+// Dense labels index a jump table; sparse ones are binary searched, after the
+// value a profile found most common.
+static int vm_switch_target(const SwitchTable *table, int value) {
+    if (table->jump_table) {
+        // One unsigned compare covers both ends of the range
+        unsigned offset = (unsigned)value - (unsigned)table->jump_min;
+        return offset < (unsigned)table->jump_size ? table->jump_table[offset] : table->default_target;
+    }
+    if (table->has_hot && value == table->hot_value) return table->hot_target;
+
+    int low = 0, high = table->count - 1;
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+        int label = table->cases[mid].value;
+        if (label == value) return table->cases[mid].target;
+        if (label < value) low = mid + 1;
+        else high = mid - 1;
+    }
+    return table->default_target;
+}
+
+// Called once vm->fuel has run out
+static void vm_refuel(VirtualMachine *vm) {
+    if (!vm->out_of_fuel) {
+        vm->fuel = VM_FUEL_UNLIMITED;
+    } else if (vm->out_of_fuel(vm->fuel_data) != 0) {
+        vm_runtime_error(vm, "Out of fuel.");
+    }
+}
+
+// Executes a single statement, modifying the VM state.
+// Returns 1 if a 'return' ran (its value is in vm->return_value), 0 otherwise.
+int vm_execute_statement(VirtualMachine *vm, ASTNode *stmt) {
+    if (!stmt) return 0;
+    if (--vm->fuel < 0) vm_refuel(vm);
+    // A placeholder is counted once it has become the statement it stands for
+    if (vm->profile && stmt->type != STMT_LAZY) profile_statement(vm->profile, stmt->line);
     
     switch (stmt->type) {
         case STMT_VAR_DECL:
-            // Symbol is added during the initial pass (in vm_execute_program)
+        case STMT_FUNC_DECL:
+            // Symbols and frame slots are laid out by the semantic pass
             // No runtime action needed other than reserving memory (which we do implicitly)
             break;
 
         case STMT_ASSIGN: {
-            int index = symtab_lookup(vm->symtab, stmt->name);
-            if (index == -1) {
-                fprintf(stderr, "Runtime Error: Cannot assign to undeclared variable '%s'.\n", stmt->name);
-                exit(1);
+            if (stmt->index) {
+                Symbol *s = vm_array(vm, stmt);
+                int i = vm_evaluate_expression(vm, stmt->index);
+                int result = vm_evaluate_expression(vm, stmt->expression);
+                *vm_element(vm, s, i) = result;
+                if (vm->trace) fprintf(vm->console, "[TRACE] Assigned '%s[%d]' = %d\n", stmt->name, i, result);
+                break;
             }
             int result = vm_evaluate_expression(vm, stmt->expression);
-            vm->memory[index] = result;
-            printf("[TRACE] Assigned '%s' = %d\n", stmt->name, result);
+            *vm_variable(vm, stmt) = result;
+            if (vm->trace && !stmt->untraced) fprintf(vm->console, "[TRACE] Assigned '%s' = %d\n", stmt->name, result);
             break;
         }
 
         case STMT_PRINT: {
             int value = vm_evaluate_expression(vm, stmt->print_expr);
-            // Assumes print_expr is an identifier, but we evaluate the expression result
-            printf("Oba-C Output: %d\n", value);
+            if (vm->output) {
+                vm->output(vm->output_data, value);
+            } else {
+                fprintf(vm->console, "Oba-C Output: %d\n", value);
+            }
             break;
         }
 
         case STMT_IF: {
             int condition_result = vm_evaluate_expression(vm, stmt->condition);
+            if (vm->profile) profile_branch(vm->profile, stmt->line, condition_result != 0);
             if (condition_result) {
                 // If condition is true (non-zero), execute the body statement
-                vm_execute_statement(vm, stmt->body);
+                return vm_execute_statement(vm, stmt->body);
             }
             break;
         }
+
+        case STMT_SWITCH: {
+            int value = vm_evaluate_expression(vm, stmt->condition);
+            if (vm->profile) profile_switch(vm->profile, stmt->line, value);
+            int target = vm_switch_target(stmt->switch_table, value);
+            if (target >= 0) {
+                return vm_execute_statement(vm, stmt->statements[target]);
+            }
+            break;
+        }
+
+        case STMT_EXPR:
+            vm_evaluate_expression(vm, stmt->expression);
+            break;
+
+        case STMT_BLOCK:
+            for (int i = 0; i < stmt->statement_count; i++) {
+                if (vm_execute_statement(vm, stmt->statements[i])) return 1;
+            }
+            break;
+
+        case STMT_RETURN:
+            vm->return_value = vm_evaluate_expression(vm, stmt->expression);
+            return 1;
+
+        case STMT_PARALLEL_FOR: {
+            int from = vm_evaluate_expression(vm, stmt->left);
+            int to = vm_evaluate_expression(vm, stmt->right);
+            vm_execute_parallel_for(vm, stmt, from, to);
+            break;
+        }
+
+        case STMT_LAZY: {
+            // First run of a body the parser skipped: build it in place, then run it
+            int line = stmt->lazy_tokens[0]->line;
+            if (semantic_expand_lazy(stmt, vm->symtab) != 0) {
+                vm_runtime_error(vm, "Could not compile the statement on line %d.", line);
+            }
+            return vm_execute_statement(vm, stmt);
+        }
         
         default:
-            fprintf(stderr, "Runtime Error: Unknown statement type %d.\n", stmt->type);
+            vm_runtime_error(vm, "Unknown statement type %d.", stmt->type);
             break;
     }
+    return 0;
 }
 
 // Main execution loop: Traverses the program's statements
-void vm_execute_program(VirtualMachine *vm, ASTNode *program) {
+void vm_execute_until(VirtualMachine *vm, ASTNode *program, int end) {
     if (!program || program->type != NODE_PROGRAM) return;
+    if (end > program->statement_count) end = program->statement_count;
 
-    // --- EXECUTION PHASE ---
-    printf("\n--- Running Oba-C Virtual Machine ---\n");
-    
-    for (int i = 0; i < program->statement_count; i++) {
-        vm_execute_statement(vm, program->statements[i]);
+    while (vm->pc < end) {
+        vm_execute_statement(vm, program->statements[vm->pc]);
+        vm->pc++;
     }
-    
-    printf("--- Execution Complete ---\n");
-}
\ No newline at end of file
+}
+
+void vm_execute_program(VirtualMachine *vm, ASTNode *program) {
+    if (!program) return;
+    vm_execute_until(vm, program, program->statement_count);
+}